@@ -0,0 +1,505 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * pt-pcm-file
+ * Direct access to uncompressed audio files.
+ *
+ * Reads local WAV (including BWF and RF64) and AIFF/AIFC files with integer
+ * samples of 8, 16, 24 or 32 bit or 32 bit float samples, any number of
+ * channels and sample rates up to 768 kHz. The file is memory mapped, only the
+ * header is parsed, there is no decoding. Reading from a mapped file that was
+ * truncated meanwhile raises SIGBUS, files that are still written to must be
+ * checked with pt_pcm_file_check_length() before reading.
+ *
+ * pt_pcm_file_read() returns frames mixed down to mono, 16 bit signed, at the
+ * file’s sample rate. Other formats, compressed AIFC and remote files are not
+ * supported, pt_pcm_file_new() returns NULL for them.
+ */
+
+#include "config.h"
+
+#include "pt-pcm-file.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+/* Highest sample rate, others are not plausible. Callers allocate one
+ * second of frames. */
+#define MAX_RATE 768000
+
+typedef enum
+{
+  SAMPLE_U8,
+  SAMPLE_S8,
+  SAMPLE_S16LE,
+  SAMPLE_S16BE,
+  SAMPLE_S24LE,
+  SAMPLE_S24BE,
+  SAMPLE_S32LE,
+  SAMPLE_S32BE,
+  SAMPLE_F32LE,
+  SAMPLE_F32BE
+} SampleFormat;
+
+struct _PtPcmFile
+{
+  GMappedFile  *mapped;
+  gchar        *path;
+  const guint8 *data; /* first frame */
+  guint64       n_frames;
+  guint         rate;
+  guint         channels;
+  guint         width; /* bytes per sample */
+  SampleFormat  format;
+};
+
+static inline guint16
+read_le16 (const guint8 *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static inline guint32
+read_le32 (const guint8 *p)
+{
+  return (guint32) read_le16 (p) | ((guint32) read_le16 (p + 2) << 16);
+}
+
+static inline guint64
+read_le64 (const guint8 *p)
+{
+  return (guint64) read_le32 (p) | ((guint64) read_le32 (p + 4) << 32);
+}
+
+static inline guint16
+read_be16 (const guint8 *p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+static inline guint32
+read_be32 (const guint8 *p)
+{
+  return ((guint32) read_be16 (p) << 16) | read_be16 (p + 2);
+}
+
+static inline guint64
+read_be64 (const guint8 *p)
+{
+  return ((guint64) read_be32 (p) << 32) | read_be32 (p + 4);
+}
+
+static guint
+read_extended_rate (const guint8 *p)
+{
+  /* AIFF stores the rate as 80 bit IEEE 754 extended precision, only
+   * positive integers are supported */
+
+  gint    exponent = read_be16 (p) - 16383;
+  guint64 mantissa = read_be64 (p + 2);
+
+  if (exponent < 0 || exponent > 31)
+    return 0;
+
+  return mantissa >> (63 - exponent);
+}
+
+static gboolean
+set_format (PtPcmFile *self,
+            gboolean   is_float,
+            guint      bits,
+            gboolean   big_endian,
+            gboolean   is_unsigned)
+{
+  self->width = bits / 8;
+
+  if (is_float)
+    {
+      if (bits != 32)
+        return FALSE;
+      self->format = big_endian ? SAMPLE_F32BE : SAMPLE_F32LE;
+      return TRUE;
+    }
+
+  switch (bits)
+    {
+    case 8:
+      self->format = is_unsigned ? SAMPLE_U8 : SAMPLE_S8;
+      return TRUE;
+    case 16:
+      self->format = big_endian ? SAMPLE_S16BE : SAMPLE_S16LE;
+      return TRUE;
+    case 24:
+      self->format = big_endian ? SAMPLE_S24BE : SAMPLE_S24LE;
+      return TRUE;
+    case 32:
+      self->format = big_endian ? SAMPLE_S32BE : SAMPLE_S32LE;
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+static gboolean
+parse_wav (PtPcmFile    *self,
+           const guint8 *contents,
+           guint64       length)
+{
+  gboolean rf64;
+  gboolean have_fmt = FALSE;
+  guint64  pos = 12;
+  guint64  size;
+  guint64  ds64_data_size = 0;
+  guint64  n_bytes;
+  guint    format = 0;
+  guint    bits = 0;
+  guint    block_align = 0;
+
+  if (length < 12 || memcmp (contents + 8, "WAVE", 4) != 0)
+    return FALSE;
+
+  rf64 = (memcmp (contents, "RF64", 4) == 0);
+  if (!rf64 && memcmp (contents, "RIFF", 4) != 0)
+    return FALSE;
+
+  while (pos + 8 <= length)
+    {
+      const guint8 *id = contents + pos;
+      const guint8 *body = id + 8;
+
+      size = read_le32 (id + 4);
+
+      if (memcmp (id, "ds64", 4) == 0 && size >= 16 && pos + 8 + 16 <= length)
+        {
+          ds64_data_size = read_le64 (body + 8);
+        }
+      else if (memcmp (id, "fmt ", 4) == 0 && size >= 16 && pos + 8 + 16 <= length)
+        {
+          format = read_le16 (body);
+          self->channels = read_le16 (body + 2);
+          self->rate = read_le32 (body + 4);
+          block_align = read_le16 (body + 12);
+          bits = read_le16 (body + 14);
+          /* WAVE_FORMAT_EXTENSIBLE: the format is in the sub format GUID */
+          if (format == 0xFFFE && size >= 40 && pos + 8 + 26 <= length)
+            format = read_le16 (body + 24);
+          have_fmt = TRUE;
+        }
+      else if (memcmp (id, "data", 4) == 0)
+        {
+          if (rf64 && size == G_MAXUINT32)
+            size = ds64_data_size;
+          /* Recorders might have stopped before writing the final size.
+           * While they are still writing, it can be a placeholder. */
+          n_bytes = length - pos - 8;
+          if (size != 0 && size != G_MAXUINT32)
+            n_bytes = MIN (size, n_bytes);
+
+          if (!have_fmt || (format != 1 && format != 3) ||
+              self->channels == 0 || self->rate == 0 ||
+              !set_format (self, format == 3, bits, FALSE, bits == 8) ||
+              block_align != self->channels * self->width)
+            return FALSE;
+
+          self->data = body;
+          self->n_frames = n_bytes / block_align;
+          return TRUE;
+        }
+
+      /* Chunks are padded to an even size */
+      pos += 8 + size + (size & 1);
+    }
+
+  return FALSE;
+}
+
+static gboolean
+parse_aiff (PtPcmFile    *self,
+            const guint8 *contents,
+            guint64       length)
+{
+  gboolean      aifc;
+  gboolean      have_comm = FALSE;
+  gboolean      big_endian = TRUE;
+  gboolean      is_float = FALSE;
+  guint64       pos = 12;
+  guint64       size;
+  guint64       offset;
+  guint64       n_bytes;
+  guint64       n_frames = 0;
+  guint         bits = 0;
+  const guint8 *compression;
+
+  if (length < 12 || memcmp (contents, "FORM", 4) != 0)
+    return FALSE;
+
+  aifc = (memcmp (contents + 8, "AIFC", 4) == 0);
+  if (!aifc && memcmp (contents + 8, "AIFF", 4) != 0)
+    return FALSE;
+
+  while (pos + 8 <= length)
+    {
+      const guint8 *id = contents + pos;
+      const guint8 *body = id + 8;
+
+      size = read_be32 (id + 4);
+
+      if (memcmp (id, "COMM", 4) == 0 && size >= 18 && pos + 8 + 18 <= length)
+        {
+          self->channels = read_be16 (body);
+          n_frames = read_be32 (body + 2);
+          bits = read_be16 (body + 6);
+          self->rate = read_extended_rate (body + 8);
+          if (aifc)
+            {
+              if (size < 22 || pos + 8 + 22 > length)
+                return FALSE;
+              compression = body + 18;
+              if (memcmp (compression, "sowt", 4) == 0)
+                big_endian = FALSE;
+              else if (memcmp (compression, "fl32", 4) == 0 ||
+                       memcmp (compression, "FL32", 4) == 0)
+                is_float = TRUE;
+              else if (memcmp (compression, "NONE", 4) != 0 &&
+                       memcmp (compression, "twos", 4) != 0)
+                return FALSE;
+            }
+          have_comm = TRUE;
+        }
+      else if (memcmp (id, "SSND", 4) == 0 && size >= 8 && pos + 8 + 8 <= length)
+        {
+          offset = read_be32 (body);
+          if (!have_comm || self->channels == 0 || self->rate == 0 ||
+              !set_format (self, is_float, bits, big_endian, FALSE) ||
+              pos + 16 + offset > length)
+            return FALSE;
+
+          n_bytes = MIN (size - 8, length - pos - 16);
+          n_bytes = (n_bytes > offset) ? n_bytes - offset : 0;
+          self->data = body + 8 + offset;
+          self->n_frames = MIN (n_frames, n_bytes / (self->channels * self->width));
+          return TRUE;
+        }
+
+      pos += 8 + size + (size & 1);
+    }
+
+  return FALSE;
+}
+
+static inline gint
+read_sample (const guint8 *p,
+             SampleFormat  format)
+{
+  /* Returns a sample in the range of gint16 */
+
+  union
+  {
+    guint32 i;
+    gfloat  f;
+  } value;
+  gfloat f;
+
+  switch (format)
+    {
+    case SAMPLE_U8:
+      return ((gint) p[0] - 128) << 8;
+    case SAMPLE_S8:
+      return (gint8) p[0] << 8;
+    case SAMPLE_S16LE:
+      return (gint16) read_le16 (p);
+    case SAMPLE_S16BE:
+      return (gint16) read_be16 (p);
+    case SAMPLE_S24LE:
+      return (gint16) read_le16 (p + 1);
+    case SAMPLE_S24BE:
+      return (gint16) read_be16 (p);
+    case SAMPLE_S32LE:
+      return (gint16) read_le16 (p + 2);
+    case SAMPLE_S32BE:
+      return (gint16) read_be16 (p);
+    case SAMPLE_F32LE:
+    case SAMPLE_F32BE:
+      value.i = (format == SAMPLE_F32LE) ? read_le32 (p) : read_be32 (p);
+      f = value.f * 32768.0f;
+      if (f >= 32767.0f)
+        return 32767;
+      if (f <= -32768.0f)
+        return -32768;
+      return (gint) f;
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+/**
+ * pt_pcm_file_read:
+ * @self: the file
+ * @frame: index of the first frame
+ * @n_frames: number of frames to read
+ * @out: (out caller-allocates): memory for @n_frames samples
+ *
+ * Reads frames and mixes them down to mono, i.e. the mean of all channels.
+ * The frames must be within the file.
+ */
+void
+pt_pcm_file_read (PtPcmFile *self,
+                  guint64    frame,
+                  guint      n_frames,
+                  gint16    *out)
+{
+  const guint8 *p;
+  guint         frame_size = self->channels * self->width;
+  gint          sum;
+  guint         i, c;
+
+  g_return_if_fail (frame + n_frames <= self->n_frames);
+
+  p = self->data + frame * frame_size;
+
+  /* The most common formats first, in simple loops the compiler can
+   * vectorize */
+  if (self->format == SAMPLE_S16LE && G_BYTE_ORDER == G_LITTLE_ENDIAN)
+    {
+      if (self->channels == 1)
+        {
+          memcpy (out, p, n_frames * sizeof (gint16));
+          return;
+        }
+      if (self->channels == 2)
+        {
+          gint16 s[2];
+          for (i = 0; i < n_frames; i++)
+            {
+              memcpy (s, p + i * 4, 4);
+              out[i] = (s[0] + s[1]) / 2;
+            }
+          return;
+        }
+    }
+
+  for (i = 0; i < n_frames; i++)
+    {
+      sum = 0;
+      for (c = 0; c < self->channels; c++)
+        {
+          sum += read_sample (p, self->format);
+          p += self->width;
+        }
+      out[i] = sum / (gint) self->channels;
+    }
+}
+
+guint
+pt_pcm_file_get_rate (PtPcmFile *self)
+{
+  return self->rate;
+}
+
+guint
+pt_pcm_file_get_channels (PtPcmFile *self)
+{
+  return self->channels;
+}
+
+guint64
+pt_pcm_file_get_n_frames (PtPcmFile *self)
+{
+  return self->n_frames;
+}
+
+/**
+ * pt_pcm_file_check_length:
+ * @self: the file
+ *
+ * Checks whether the file on disk is still as long as the mapped file. If it
+ * was truncated, reading would raise SIGBUS.
+ *
+ * Return value: TRUE if all frames can be read
+ */
+gboolean
+pt_pcm_file_check_length (PtPcmFile *self)
+{
+  GStatBuf buf;
+
+  if (g_stat (self->path, &buf) != 0)
+    return FALSE;
+
+  return (guint64) buf.st_size >= g_mapped_file_get_length (self->mapped);
+}
+
+void
+pt_pcm_file_free (PtPcmFile *self)
+{
+  g_mapped_file_unref (self->mapped);
+  g_free (self->path);
+  g_free (self);
+}
+
+/**
+ * pt_pcm_file_new:
+ * @uri: URI of the audio file
+ *
+ * Opens a local WAV or AIFF file.
+ *
+ * Return value: the file or NULL if the file is not supported, e.g. its
+ * sample rate is 0 or higher than 768 kHz
+ */
+PtPcmFile *
+pt_pcm_file_new (const gchar *uri)
+{
+  PtPcmFile    *self;
+  GMappedFile  *mapped;
+  GFile        *file;
+  gchar        *path;
+  const guint8 *contents;
+  guint64       length;
+
+  file = g_file_new_for_uri (uri);
+  path = g_file_get_path (file);
+  g_object_unref (file);
+  if (!path)
+    return NULL;
+
+  mapped = g_mapped_file_new (path, FALSE, NULL);
+  if (!mapped)
+    {
+      g_free (path);
+      return NULL;
+    }
+
+  self = g_new0 (PtPcmFile, 1);
+  self->mapped = mapped;
+  self->path = path;
+  contents = (const guint8 *) g_mapped_file_get_contents (mapped);
+  length = g_mapped_file_get_length (mapped);
+
+  if (!contents ||
+      !(parse_wav (self, contents, length) || parse_aiff (self, contents, length)) ||
+      self->n_frames == 0 || self->rate > MAX_RATE)
+    {
+      pt_pcm_file_free (self);
+      return NULL;
+    }
+
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "MESSAGE",
+                    "PCM file: %u channels, %u Hz, %u bytes per sample, %" G_GUINT64_FORMAT " frames",
+                    self->channels, self->rate, self->width, self->n_frames);
+
+  return self;
+}
@@ -0,0 +1,32 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+typedef struct _PtPcmFile PtPcmFile;
+
+PtPcmFile *pt_pcm_file_new          (const gchar *uri);
+void       pt_pcm_file_free         (PtPcmFile   *self);
+guint      pt_pcm_file_get_rate     (PtPcmFile   *self);
+guint      pt_pcm_file_get_channels (PtPcmFile   *self);
+guint64    pt_pcm_file_get_n_frames (PtPcmFile   *self);
+gboolean   pt_pcm_file_check_length (PtPcmFile   *self);
+void       pt_pcm_file_read         (PtPcmFile   *self,
+                                     guint64      frame,
+                                     guint        n_frames,
+                                     gint16      *out);
@@ -0,0 +1,614 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * pt-peak-cache
+ * Saves and loads decoded waveform data for a file.
+ *
+ * Decoding a long file takes a lot of time, the result is saved in the user’s
+ * cache directory (e.g. ~/.cache/parlatype/peaks). There is one cache file per
+ * URI, its name is a checksum of the URI.
+ *
+ * A cache file consists of a fixed size header, the URI and the raw sample
+ * data (8000 samples per second, signed 16 bit, native byte order). The header
+ * identifies the audio file by its size and modification time. If they don’t
+ * match, the cache file is considered stale and ignored. The decoder is not
+ * part of the key, a GStreamer or plugin update doesn’t invalidate peaks.
+ *
+ * Cache files are memory mapped for loading, but a hit copies all samples.
+ * It saves decoding, the caller still has to build everything else from the
+ * samples, i.e. a hit takes time in proportion to the length of the file.
+ * Loading a cache file updates its modification time, eviction removes the
+ * least recently used files first.
+ *
+ * Saving a long file takes a while, it’s done in a thread that keeps a
+ * reference on the samples. Loading a file that is being saved waits until
+ * it’s done, i.e. loading should be done in a thread, too.
+ */
+
+#include "config.h"
+
+#include "pt-peak-cache.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define CACHE_MAGIC "PTPEAKS"
+#define CACHE_FORMAT_VERSION 2
+#define CACHE_SUFFIX ".peaks"
+#define CACHE_RATE 8000
+
+/* All fields are naturally aligned, the size is a multiple of 8 */
+typedef struct
+{
+  gchar   magic[8];   /* CACHE_MAGIC, NUL terminated */
+  guint32 version;    /* CACHE_FORMAT_VERSION */
+  guint32 byte_order; /* G_BYTE_ORDER of the machine that wrote it */
+  guint32 rate;       /* samples per second */
+  guint32 uri_len;    /* length of URI following the header */
+  guint64 file_size;  /* size of the audio file */
+  gint64  file_mtime; /* modification time of the audio file in µs */
+  gint64  duration;   /* in nanoseconds */
+  guint64 n_samples;  /* number of gint16 samples following the URI */
+} CacheHeader;
+
+struct _PtPeakCache
+{
+  GObject parent;
+
+  gchar *dir;
+};
+
+typedef struct
+{
+  gchar      *uri;
+  PtPeakData *data;
+  gint64      duration;
+  guint64     max_size;
+} SaveJob;
+
+G_DEFINE_TYPE (PtPeakCache, pt_peak_cache, G_TYPE_OBJECT)
+
+/* Evictions of different threads would delete the same files */
+G_LOCK_DEFINE_STATIC (evict);
+
+/* Cache files that are being saved, path → number of saves */
+static GMutex      saving_lock;
+static GCond       saving_cond;
+static GHashTable *saving;
+
+static void
+saving_begin (const gchar *path)
+{
+  guint n;
+
+  g_mutex_lock (&saving_lock);
+  if (!saving)
+    saving = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  n = GPOINTER_TO_UINT (g_hash_table_lookup (saving, path));
+  g_hash_table_insert (saving, g_strdup (path), GUINT_TO_POINTER (n + 1));
+  g_mutex_unlock (&saving_lock);
+}
+
+static void
+saving_end (const gchar *path)
+{
+  guint n;
+
+  g_mutex_lock (&saving_lock);
+  n = GPOINTER_TO_UINT (g_hash_table_lookup (saving, path));
+  if (n > 1)
+    g_hash_table_insert (saving, g_strdup (path), GUINT_TO_POINTER (n - 1));
+  else
+    g_hash_table_remove (saving, path);
+  g_cond_broadcast (&saving_cond);
+  g_mutex_unlock (&saving_lock);
+}
+
+static void
+saving_wait (const gchar *path)
+{
+  g_mutex_lock (&saving_lock);
+  while (saving && g_hash_table_contains (saving, path))
+    g_cond_wait (&saving_cond, &saving_lock);
+  g_mutex_unlock (&saving_lock);
+}
+
+static void
+saving_wait_all (void)
+{
+  g_mutex_lock (&saving_lock);
+  while (saving && g_hash_table_size (saving) > 0)
+    g_cond_wait (&saving_cond, &saving_lock);
+  g_mutex_unlock (&saving_lock);
+}
+
+static gsize
+padded_uri_len (gsize uri_len)
+{
+  /* Keep samples 8 byte aligned */
+  return (uri_len + 7) & ~((gsize) 7);
+}
+
+static gchar *
+get_cache_path (PtPeakCache *self,
+                const gchar *uri)
+{
+  gchar *checksum;
+  gchar *name;
+  gchar *path;
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, uri, -1);
+  name = g_strconcat (checksum, CACHE_SUFFIX, NULL);
+  path = g_build_filename (self->dir, name, NULL);
+
+  g_free (checksum);
+  g_free (name);
+
+  return path;
+}
+
+static gboolean
+get_file_identity (const gchar *uri,
+                   guint64     *size,
+                   gint64      *mtime)
+{
+  GError    *error = NULL;
+  GFile     *file;
+  GFileInfo *info;
+
+  file = g_file_new_for_uri (uri);
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE, NULL, &error);
+  g_object_unref (file);
+
+  if (error)
+    {
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "MESSAGE",
+                        "Peak cache: file not identified: %s", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  *size = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_STANDARD_SIZE);
+  *mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC + g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+  g_object_unref (info);
+  return TRUE;
+}
+
+static void
+init_header (CacheHeader *header,
+             const gchar *uri,
+             guint64      file_size,
+             gint64       file_mtime)
+{
+  memset (header, 0, sizeof (CacheHeader));
+  memcpy (header->magic, CACHE_MAGIC, sizeof (CACHE_MAGIC));
+  header->version = CACHE_FORMAT_VERSION;
+  header->byte_order = G_BYTE_ORDER;
+  header->rate = CACHE_RATE;
+  header->uri_len = strlen (uri);
+  header->file_size = file_size;
+  header->file_mtime = file_mtime;
+}
+
+/**
+ * pt_peak_cache_load:
+ * @self: a #PtPeakCache
+ * @uri: URI of the audio file
+ * @samples: a #PtSampleStore to append the samples to
+ * @duration: (out): return location for the duration in nanoseconds
+ *
+ * Looks for a valid cache file for @uri and appends its samples to @samples.
+ * Stale or corrupt cache files are removed. If the cache file is being saved,
+ * this blocks until it’s done.
+ *
+ * Return value: TRUE on a cache hit, otherwise FALSE and @samples is unchanged
+ */
+gboolean
+pt_peak_cache_load (PtPeakCache   *self,
+                    const gchar   *uri,
+                    PtSampleStore *samples,
+                    gint64        *duration)
+{
+  GError      *error = NULL;
+  GMappedFile *mapped;
+  CacheHeader  expected;
+  CacheHeader  header;
+  const gchar *contents;
+  gsize        length;
+  gsize        offset;
+  guint64      file_size;
+  gint64       file_mtime;
+  gchar       *path;
+  gboolean     valid;
+
+  if (!uri || !get_file_identity (uri, &file_size, &file_mtime))
+    return FALSE;
+
+  path = get_cache_path (self, uri);
+  saving_wait (path);
+  mapped = g_mapped_file_new (path, FALSE, &error);
+  if (error)
+    {
+      /* No cache file is the common case, don’t log it */
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "MESSAGE",
+                          "Peak cache not loaded: %s", error->message);
+      g_error_free (error);
+      g_free (path);
+      return FALSE;
+    }
+
+  contents = g_mapped_file_get_contents (mapped);
+  length = g_mapped_file_get_length (mapped);
+
+  init_header (&expected, uri, file_size, file_mtime);
+  valid = (length >= sizeof (CacheHeader));
+  if (valid)
+    {
+      memcpy (&header, contents, sizeof (CacheHeader));
+      offset = sizeof (CacheHeader) + padded_uri_len (header.uri_len);
+      valid = (memcmp (header.magic, expected.magic, sizeof (header.magic)) == 0 &&
+               header.version == expected.version &&
+               header.byte_order == expected.byte_order &&
+               header.rate == expected.rate &&
+               header.uri_len == expected.uri_len &&
+               header.file_size == expected.file_size &&
+               header.file_mtime == expected.file_mtime &&
+               header.n_samples <= G_MAXUINT &&
+               length == offset + header.n_samples * sizeof (gint16) &&
+               memcmp (contents + sizeof (CacheHeader), uri, header.uri_len) == 0);
+    }
+
+  if (valid)
+    {
+      pt_sample_store_append (samples, (const gint16 *) (contents + offset), header.n_samples);
+      *duration = header.duration;
+      /* Mark as recently used */
+      g_utime (path, NULL);
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "MESSAGE",
+                        "Peak cache hit: %" G_GUINT64_FORMAT " samples", header.n_samples);
+    }
+  else
+    {
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "MESSAGE",
+                        "Peak cache stale, removing %s", path);
+      g_remove (path);
+    }
+
+  g_mapped_file_unref (mapped);
+  g_free (path);
+
+  return valid;
+}
+
+static gboolean
+write_samples (GOutputStream *out,
+               PtSampleStore *samples,
+               GError       **error)
+{
+  const gint16 *block;
+  guint         length = pt_sample_store_get_length (samples);
+  guint         position = 0;
+  guint         n;
+
+  while (position < length)
+    {
+      block = pt_sample_store_get_block (samples, position, &n);
+      if (!block)
+        {
+          g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                               _ ("Samples not available."));
+          return FALSE;
+        }
+      if (!g_output_stream_write_all (out, block, n * sizeof (gint16), NULL, NULL, error))
+        return FALSE;
+      position += n;
+    }
+
+  return TRUE;
+}
+
+static void
+save (PtPeakCache   *self,
+      const gchar   *uri,
+      PtSampleStore *samples,
+      gint64         duration)
+{
+  /* Tries to save the decoded samples for @uri. Failure is logged at info
+   * level. */
+
+  GError            *error = NULL;
+  GFile             *file;
+  GFileOutputStream *stream;
+  CacheHeader        header;
+  guint64            file_size;
+  gint64             file_mtime;
+  gchar             *path;
+  gchar              padding[8] = { 0 };
+
+  if (!uri || !get_file_identity (uri, &file_size, &file_mtime))
+    return;
+
+  if (g_mkdir_with_parents (self->dir, 0700) != 0)
+    {
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "MESSAGE",
+                        "Peak cache directory not created: %s", g_strerror (errno));
+      return;
+    }
+
+  init_header (&header, uri, file_size, file_mtime);
+  header.duration = duration;
+  header.n_samples = pt_sample_store_get_length (samples);
+
+  path = get_cache_path (self, uri);
+  file = g_file_new_for_path (path);
+
+  /* Written to a temporary file, replaces the old one only on success */
+  stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_PRIVATE | G_FILE_CREATE_REPLACE_DESTINATION,
+                           NULL, &error);
+  if (stream)
+    {
+      GOutputStream *out = G_OUTPUT_STREAM (stream);
+      if (g_output_stream_write_all (out, &header, sizeof (header), NULL, NULL, &error) &&
+          g_output_stream_write_all (out, uri, header.uri_len, NULL, NULL, &error) &&
+          g_output_stream_write_all (out, padding, padded_uri_len (header.uri_len) - header.uri_len, NULL, NULL, &error) &&
+          write_samples (out, samples, &error))
+        {
+          g_output_stream_close (out, NULL, &error);
+        }
+      else
+        {
+          /* Closing with a cancelled cancellable discards the temporary
+           * file, an old cache file is not replaced. */
+          GCancellable *cancel = g_cancellable_new ();
+          g_cancellable_cancel (cancel);
+          g_output_stream_close (out, cancel, NULL);
+          g_object_unref (cancel);
+        }
+      g_object_unref (stream);
+    }
+
+  if (error)
+    {
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "MESSAGE",
+                        "Peak cache not saved: %s", error->message);
+      g_error_free (error);
+    }
+  else
+    {
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "MESSAGE",
+                        "Peak cache saved: %s", path);
+    }
+
+  g_object_unref (file);
+  g_free (path);
+}
+
+static gint
+compare_mtime (gconstpointer a,
+               gconstpointer b)
+{
+  guint64 mtime_a, mtime_b;
+
+  mtime_a = g_file_info_get_attribute_uint64 ((GFileInfo *) a, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  mtime_b = g_file_info_get_attribute_uint64 ((GFileInfo *) b, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+  return (mtime_a > mtime_b) - (mtime_a < mtime_b);
+}
+
+/**
+ * pt_peak_cache_evict:
+ * @self: a #PtPeakCache
+ * @max_size: maximum size of all cache files in bytes
+ *
+ * Removes least recently used cache files until the total size of all cache
+ * files is not bigger than @max_size. Only one eviction runs at a time.
+ */
+void
+pt_peak_cache_evict (PtPeakCache *self,
+                     guint64      max_size)
+{
+  GError          *error = NULL;
+  GFile           *dir;
+  GFileEnumerator *enumerator;
+  GFileInfo       *info;
+  GList           *files = NULL;
+  GList           *l;
+  guint64          total = 0;
+
+  G_LOCK (evict);
+
+  dir = g_file_new_for_path (self->dir);
+  enumerator = g_file_enumerate_children (dir,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, &error);
+  if (error)
+    {
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "MESSAGE",
+                        "Peak cache not evicted: %s", error->message);
+      g_error_free (error);
+      g_object_unref (dir);
+      G_UNLOCK (evict);
+      return;
+    }
+
+  while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+    {
+      if (!g_str_has_suffix (g_file_info_get_name (info), CACHE_SUFFIX))
+        {
+          g_object_unref (info);
+          continue;
+        }
+      total += g_file_info_get_size (info);
+      files = g_list_prepend (files, info);
+    }
+
+  files = g_list_sort (files, compare_mtime);
+
+  for (l = files; l && total > max_size; l = l->next)
+    {
+      info = l->data;
+      GFile *child = g_file_get_child (dir, g_file_info_get_name (info));
+      if (g_file_delete (child, NULL, NULL))
+        total -= g_file_info_get_size (info);
+      g_object_unref (child);
+    }
+
+  g_list_free_full (files, g_object_unref);
+  g_object_unref (enumerator);
+  g_object_unref (dir);
+
+  G_UNLOCK (evict);
+}
+
+static void
+save_job_free (SaveJob *job)
+{
+  g_free (job->uri);
+  pt_peak_data_unref (job->data);
+  g_free (job);
+}
+
+static void
+save_real (GTask        *task,
+           gpointer      source_object,
+           gpointer      task_data,
+           GCancellable *cancellable)
+{
+  PtPeakCache   *self = source_object;
+  SaveJob       *job = task_data;
+  PtSampleStore *samples = pt_peak_data_get_samples (job->data);
+  guint64        size;
+  gchar         *path;
+
+  path = get_cache_path (self, job->uri);
+
+  /* A file that is bigger than the whole cache would be evicted at once */
+  size = sizeof (CacheHeader) + padded_uri_len (strlen (job->uri)) +
+         (guint64) pt_sample_store_get_length (samples) * sizeof (gint16);
+  if (job->max_size > 0 && size > job->max_size)
+    {
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "MESSAGE",
+                        "Peak cache not saved: %" G_GUINT64_FORMAT " bytes exceed the cache size",
+                        size);
+    }
+  else
+    {
+      save (self, job->uri, samples, job->duration);
+      if (job->max_size > 0)
+        pt_peak_cache_evict (self, job->max_size);
+    }
+
+  saving_end (path);
+  g_free (path);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * pt_peak_cache_save_in_background:
+ * @self: a #PtPeakCache
+ * @uri: URI of the audio file
+ * @data: the decoded data
+ * @duration: duration in nanoseconds
+ * @max_size: maximum size of all cache files in bytes, 0 for no limit
+ *
+ * Saves the samples of @data for @uri in a thread and evicts old cache files
+ * afterwards, see pt_peak_cache_evict(). Files bigger than @max_size are not
+ * saved. With a @max_size of 0 nothing is evicted. A reference on @data is
+ * kept until it’s done, its samples must not be changed any more. Failure is
+ * logged at info level.
+ */
+void
+pt_peak_cache_save_in_background (PtPeakCache *self,
+                                  const gchar *uri,
+                                  PtPeakData  *data,
+                                  gint64       duration,
+                                  guint64      max_size)
+{
+  GTask   *task;
+  SaveJob *job;
+  gchar   *path;
+
+  if (!uri)
+    return;
+
+  job = g_new0 (SaveJob, 1);
+  job->uri = g_strdup (uri);
+  job->data = pt_peak_data_ref (data);
+  job->duration = duration;
+  job->max_size = max_size;
+
+  /* Mark it before the thread starts, a load right after this must wait */
+  path = get_cache_path (self, uri);
+  saving_begin (path);
+  g_free (path);
+
+  task = g_task_new (self, NULL, NULL, NULL);
+  g_task_set_task_data (task, job, (GDestroyNotify) save_job_free);
+  g_task_run_in_thread (task, save_real);
+  g_object_unref (task);
+}
+
+/**
+ * pt_peak_cache_flush:
+ * @self: a #PtPeakCache
+ *
+ * Blocks until all saves started with pt_peak_cache_save_in_background() by
+ * any #PtPeakCache are finished, e.g. before evicting or exiting.
+ */
+void
+pt_peak_cache_flush (PtPeakCache *self)
+{
+  saving_wait_all ();
+}
+
+/* --------------------- Init and GObject management ------------------------ */
+
+static void
+pt_peak_cache_finalize (GObject *object)
+{
+  PtPeakCache *self = PT_PEAK_CACHE (object);
+
+  g_free (self->dir);
+
+  G_OBJECT_CLASS (pt_peak_cache_parent_class)->finalize (object);
+}
+
+static void
+pt_peak_cache_init (PtPeakCache *self)
+{
+  self->dir = g_build_filename (g_get_user_cache_dir (), "parlatype", "peaks", NULL);
+}
+
+static void
+pt_peak_cache_class_init (PtPeakCacheClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = pt_peak_cache_finalize;
+}
+
+PtPeakCache *
+pt_peak_cache_new (void)
+{
+  return g_object_new (PT_TYPE_PEAK_CACHE, NULL);
+}
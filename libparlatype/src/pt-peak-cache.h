@@ -0,0 +1,38 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "pt-peak-store.h"
+#include "pt-sample-store.h"
+#include <gio/gio.h>
+
+#define PT_TYPE_PEAK_CACHE (pt_peak_cache_get_type ())
+G_DECLARE_FINAL_TYPE (PtPeakCache, pt_peak_cache, PT, PEAK_CACHE, GObject)
+
+gboolean     pt_peak_cache_load               (PtPeakCache   *self,
+                                               const gchar   *uri,
+                                               PtSampleStore *samples,
+                                               gint64        *duration);
+void         pt_peak_cache_save_in_background (PtPeakCache   *self,
+                                               const gchar   *uri,
+                                               PtPeakData    *data,
+                                               gint64         duration,
+                                               guint64        max_size);
+void         pt_peak_cache_evict              (PtPeakCache   *self,
+                                               guint64        max_size);
+void         pt_peak_cache_flush              (PtPeakCache   *self);
+PtPeakCache *pt_peak_cache_new                (void);
@@ -0,0 +1,170 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * pt-peak-kernel
+ * Minimum and maximum of a block of samples.
+ *
+ * All kernels combine the given @min and @max with the minimum and maximum of
+ * @n_samples @samples. Results are exactly the same for all kernels, they
+ * differ only in speed.
+ *
+ * On x86 there are SSE2 and AVX2 versions, compiled with function attributes
+ * and chosen at runtime, depending on what the CPU supports. Everywhere else
+ * the portable scalar version is used.
+ */
+
+#include "config.h"
+
+#include "pt-peak-kernel.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+static void
+min_max_scalar (const gint16 *samples,
+                guint         n_samples,
+                gint16       *min,
+                gint16       *max)
+{
+  gint16 lo = *min;
+  gint16 hi = *max;
+
+  for (guint i = 0; i < n_samples; i++)
+    {
+      if (samples[i] < lo)
+        lo = samples[i];
+      if (samples[i] > hi)
+        hi = samples[i];
+    }
+
+  *min = lo;
+  *max = hi;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+__attribute__ ((target ("sse2"))) static void
+min_max_sse2 (const gint16 *samples,
+              guint         n_samples,
+              gint16       *min,
+              gint16       *max)
+{
+  __m128i vmin = _mm_set1_epi16 (*min);
+  __m128i vmax = _mm_set1_epi16 (*max);
+  __m128i v;
+  gint16  lanes_min[8];
+  gint16  lanes_max[8];
+  guint   i;
+
+  for (i = 0; i + 8 <= n_samples; i += 8)
+    {
+      v = _mm_loadu_si128 ((const __m128i *) (samples + i));
+      vmin = _mm_min_epi16 (vmin, v);
+      vmax = _mm_max_epi16 (vmax, v);
+    }
+
+  _mm_storeu_si128 ((__m128i *) lanes_min, vmin);
+  _mm_storeu_si128 ((__m128i *) lanes_max, vmax);
+  min_max_scalar (lanes_min, 8, min, max);
+  min_max_scalar (lanes_max, 8, min, max);
+
+  /* Remaining samples */
+  min_max_scalar (samples + i, n_samples - i, min, max);
+}
+
+__attribute__ ((target ("avx2"))) static void
+min_max_avx2 (const gint16 *samples,
+              guint         n_samples,
+              gint16       *min,
+              gint16       *max)
+{
+  __m256i vmin = _mm256_set1_epi16 (*min);
+  __m256i vmax = _mm256_set1_epi16 (*max);
+  __m256i v;
+  gint16  lanes_min[16];
+  gint16  lanes_max[16];
+  guint   i;
+
+  for (i = 0; i + 16 <= n_samples; i += 16)
+    {
+      v = _mm256_loadu_si256 ((const __m256i *) (samples + i));
+      vmin = _mm256_min_epi16 (vmin, v);
+      vmax = _mm256_max_epi16 (vmax, v);
+    }
+
+  _mm256_storeu_si256 ((__m256i *) lanes_min, vmin);
+  _mm256_storeu_si256 ((__m256i *) lanes_max, vmax);
+  min_max_scalar (lanes_min, 16, min, max);
+  min_max_scalar (lanes_max, 16, min, max);
+
+  /* Remaining samples */
+  min_max_scalar (samples + i, n_samples - i, min, max);
+}
+
+#endif
+
+/**
+ * pt_peak_kernel_get:
+ * @kernel: the requested kernel
+ *
+ * Returns a specific kernel, e.g. for testing.
+ *
+ * Return value: the kernel or NULL if it is not supported on this CPU
+ */
+PtPeakKernelFunc
+pt_peak_kernel_get (PtPeakKernel kernel)
+{
+  switch (kernel)
+    {
+    case PT_PEAK_KERNEL_SCALAR:
+      return min_max_scalar;
+#ifdef HAVE_X86_KERNELS
+    case PT_PEAK_KERNEL_SSE2:
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("sse2") ? min_max_sse2 : NULL;
+    case PT_PEAK_KERNEL_AVX2:
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("avx2") ? min_max_avx2 : NULL;
+#endif
+    default:
+      return NULL;
+    }
+}
+
+/**
+ * pt_peak_kernel_get_best:
+ *
+ * Returns the fastest kernel this CPU supports.
+ *
+ * Return value: the kernel
+ */
+PtPeakKernelFunc
+pt_peak_kernel_get_best (void)
+{
+  PtPeakKernelFunc func;
+
+  for (gint kernel = PT_PEAK_KERNEL_N_KERNELS - 1; kernel > PT_PEAK_KERNEL_SCALAR; kernel--)
+    {
+      func = pt_peak_kernel_get (kernel);
+      if (func)
+        return func;
+    }
+
+  return min_max_scalar;
+}
@@ -0,0 +1,35 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+typedef enum
+{
+  PT_PEAK_KERNEL_SCALAR,
+  PT_PEAK_KERNEL_SSE2,
+  PT_PEAK_KERNEL_AVX2,
+  PT_PEAK_KERNEL_N_KERNELS
+} PtPeakKernel;
+
+typedef void (*PtPeakKernelFunc) (const gint16 *samples,
+                                  guint         n_samples,
+                                  gint16       *min,
+                                  gint16       *max);
+
+PtPeakKernelFunc pt_peak_kernel_get      (PtPeakKernel kernel);
+PtPeakKernelFunc pt_peak_kernel_get_best (void);
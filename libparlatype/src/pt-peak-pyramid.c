@@ -0,0 +1,374 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * pt-peak-pyramid
+ * Min/max index over the raw samples of PtWaveloader.
+ *
+ * The pyramid has several levels of min/max pairs. Level 0 has one pair for
+ * every block of 8 samples, each following level has one pair for two pairs
+ * of the level below, i.e. block sizes are 8, 16, 32 … samples. This needs
+ * half the memory of the raw samples.
+ *
+ * pt_peak_pyramid_get_range() returns the minimum and maximum of any range of
+ * samples. Only the unaligned ends are read from the raw samples, the rest is
+ * combined from at most two pairs per level. The cost depends on the logarithm
+ * of the range’s length, not on its length. The result is exactly the same as
+ * scanning all samples.
+ *
+ * pt_peak_pyramid_update() is called whenever there are new samples, only
+ * complete blocks are added. Samples can be dropped from the store once they
+ * are added, i.e. before pt_peak_pyramid_get_end(). Block sizes divide
+ * PT_SAMPLE_STORE_BLOCK_SIZE, so a block never spans two blocks of the store.
+ *
+ * A compact pyramid doesn’t need the raw samples any more. It starts with
+ * blocks of 32 samples (250 per second), which needs 1/8 of the memory of
+ * the raw samples. Ranges are extended to whole blocks, so the result is
+ * not exact, but it’s never smaller than the real range. Compact pyramids
+ * can also be quantized to 8 bit per value, which halves the memory again.
+ * After the last samples pt_peak_pyramid_finish() adds an incomplete
+ * last block.
+ */
+
+#include "config.h"
+
+#include "pt-peak-pyramid.h"
+
+#define BASE_SHIFT         3
+#define COMPACT_BASE_SHIFT 5
+#define N_LEVELS           16
+
+typedef struct
+{
+  gint16 min;
+  gint16 max;
+} PeakPair;
+
+typedef struct
+{
+  gint8 min;
+  gint8 max;
+} QuantizedPair;
+
+struct _PtPeakPyramid
+{
+  GArray  *levels[N_LEVELS];
+  guint    base_shift;
+  gboolean compact;
+  gboolean quantize;
+};
+
+static inline void
+scan_samples (PtSampleStore *store,
+              guint          start,
+              guint          end,
+              gint16        *min,
+              gint16        *max)
+{
+  const gint16 *samples;
+  guint         n_samples;
+  guint         i;
+
+  while (start < end)
+    {
+      samples = pt_sample_store_get_block (store, start, &n_samples);
+      g_return_if_fail (samples != NULL);
+
+      n_samples = MIN (n_samples, end - start);
+      for (i = 0; i < n_samples; i++)
+        {
+          if (samples[i] < *min)
+            *min = samples[i];
+          if (samples[i] > *max)
+            *max = samples[i];
+        }
+      start += n_samples;
+    }
+}
+
+static inline void
+add_pair (PtPeakPyramid *self,
+          guint          level,
+          guint          index,
+          gint16        *min,
+          gint16        *max)
+{
+  gint16 pair_min, pair_max;
+
+  if (self->quantize)
+    {
+      /* Expand to the outer bounds of the quantized range */
+      QuantizedPair *pair = &g_array_index (self->levels[level], QuantizedPair, index);
+      pair_min = pair->min * 256;
+      pair_max = pair->max * 256 + 255;
+    }
+  else
+    {
+      PeakPair *pair = &g_array_index (self->levels[level], PeakPair, index);
+      pair_min = pair->min;
+      pair_max = pair->max;
+    }
+
+  if (pair_min < *min)
+    *min = pair_min;
+  if (pair_max > *max)
+    *max = pair_max;
+}
+
+static inline void
+append_pair (PtPeakPyramid *self,
+             guint          level,
+             gint16         min,
+             gint16         max)
+{
+  if (self->quantize)
+    {
+      QuantizedPair pair = { min >> 8, max >> 8 };
+      g_array_append_val (self->levels[level], pair);
+    }
+  else
+    {
+      PeakPair pair = { min, max };
+      g_array_append_val (self->levels[level], pair);
+    }
+}
+
+static void
+add_block (PtPeakPyramid *self,
+           PtSampleStore *store,
+           guint          start,
+           guint          end)
+{
+  gint16 min = G_MAXINT16;
+  gint16 max = G_MININT16;
+
+  scan_samples (store, start, end, &min, &max);
+  append_pair (self, 0, min, max);
+}
+
+static void
+update_levels (PtPeakPyramid *self)
+{
+  GArray *level, *below;
+  gint16  min, max;
+  guint   i, k;
+
+  for (k = 1; k < N_LEVELS; k++)
+    {
+      below = self->levels[k - 1];
+      level = self->levels[k];
+      for (i = level->len; i < below->len / 2; i++)
+        {
+          min = G_MAXINT16;
+          max = G_MININT16;
+          add_pair (self, k - 1, 2 * i, &min, &max);
+          add_pair (self, k - 1, 2 * i + 1, &min, &max);
+          append_pair (self, k, min, max);
+        }
+    }
+}
+
+/**
+ * pt_peak_pyramid_update:
+ * @self: the pyramid
+ * @store: raw samples
+ * @end: index after the last sample to add
+ *
+ * Adds all complete blocks up to @end. Samples from pt_peak_pyramid_get_end()
+ * to @end must not be dropped from @store.
+ */
+void
+pt_peak_pyramid_update (PtPeakPyramid *self,
+                        PtSampleStore *store,
+                        guint          end)
+{
+  guint block_size = 1 << self->base_shift;
+  guint i;
+
+  for (i = self->levels[0]->len; (i + 1) * block_size <= end; i++)
+    add_block (self, store, i * block_size, (i + 1) * block_size);
+
+  update_levels (self);
+}
+
+/**
+ * pt_peak_pyramid_finish:
+ * @self: the pyramid
+ * @store: raw samples
+ * @end: index after the last sample to add
+ *
+ * Like pt_peak_pyramid_update(), but adds an incomplete last block, too.
+ * Only needed for compact pyramids, there must be no updates afterwards.
+ */
+void
+pt_peak_pyramid_finish (PtPeakPyramid *self,
+                        PtSampleStore *store,
+                        guint          end)
+{
+  guint block_start;
+
+  pt_peak_pyramid_update (self, store, end);
+
+  block_start = pt_peak_pyramid_get_end (self);
+  if (block_start < end)
+    {
+      add_block (self, store, block_start, end);
+      update_levels (self);
+    }
+}
+
+/**
+ * pt_peak_pyramid_get_end:
+ * @self: the pyramid
+ *
+ * Returns the index after the last sample in the pyramid. Samples before
+ * this index are not needed for updates any more.
+ *
+ * Return value: index of the first sample that is not in the pyramid yet
+ */
+guint
+pt_peak_pyramid_get_end (PtPeakPyramid *self)
+{
+  return self->levels[0]->len << self->base_shift;
+}
+
+/**
+ * pt_peak_pyramid_get_range:
+ * @self: the pyramid
+ * @store: (nullable): the raw samples the pyramid was updated with, NULL
+ * for compact pyramids
+ * @start: index of first sample
+ * @end: index after the last sample
+ * @min: (inout): minimum, only changed if the range has a lower value
+ * @max: (inout): maximum, only changed if the range has a higher value
+ *
+ * Combines @min and @max with the minimum and maximum of samples in the range
+ * from @start to @end. All samples up to @end must have been added with
+ * pt_peak_pyramid_update() or pt_peak_pyramid_finish() before.
+ */
+void
+pt_peak_pyramid_get_range (PtPeakPyramid *self,
+                           PtSampleStore *store,
+                           guint          start,
+                           guint          end,
+                           gint16        *min,
+                           gint16        *max)
+{
+  guint block_size = 1 << self->base_shift;
+  guint lo, hi;
+  guint k;
+
+  if (self->compact)
+    {
+      /* Whole blocks that overlap the range */
+      lo = start >> self->base_shift;
+      hi = MIN ((end + block_size - 1) >> self->base_shift, self->levels[0]->len);
+    }
+  else
+    {
+      /* Short ranges and unaligned ends from raw samples */
+      lo = MIN (end, (start + block_size - 1) & ~(block_size - 1));
+      scan_samples (store, start, lo, min, max);
+      hi = MAX (lo, end & ~(block_size - 1));
+      scan_samples (store, hi, end, min, max);
+
+      /* Block indices at level 0 */
+      lo >>= self->base_shift;
+      hi >>= self->base_shift;
+    }
+
+  for (k = 0; lo < hi; k++)
+    {
+      if (k == N_LEVELS - 1)
+        {
+          for (; lo < hi; lo++)
+            add_pair (self, k, lo, min, max);
+          break;
+        }
+
+      /* Odd blocks at the ends have no parent within the range */
+      if (lo & 1)
+        add_pair (self, k, lo++, min, max);
+      if (hi & 1)
+        add_pair (self, k, --hi, min, max);
+
+      lo >>= 1;
+      hi >>= 1;
+    }
+}
+
+/**
+ * pt_peak_pyramid_get_size:
+ * @self: the pyramid
+ *
+ * Return value: memory used by the pyramid’s data in bytes
+ */
+gsize
+pt_peak_pyramid_get_size (PtPeakPyramid *self)
+{
+  gsize size = sizeof (PtPeakPyramid);
+
+  for (gint k = 0; k < N_LEVELS; k++)
+    size += (gsize) self->levels[k]->len * g_array_get_element_size (self->levels[k]);
+
+  return size;
+}
+
+/**
+ * pt_peak_pyramid_reset:
+ * @self: the pyramid
+ * @compact: whether the pyramid is compact
+ * @quantize: whether values are quantized to 8 bit, only for compact pyramids
+ *
+ * Removes all data and sets the pyramid’s type.
+ */
+void
+pt_peak_pyramid_reset (PtPeakPyramid *self,
+                       gboolean       compact,
+                       gboolean       quantize)
+{
+  gsize element_size;
+
+  self->compact = compact;
+  self->quantize = compact && quantize;
+  self->base_shift = compact ? COMPACT_BASE_SHIFT : BASE_SHIFT;
+  element_size = self->quantize ? sizeof (QuantizedPair) : sizeof (PeakPair);
+
+  for (gint k = 0; k < N_LEVELS; k++)
+    {
+      g_clear_pointer (&self->levels[k], g_array_unref);
+      self->levels[k] = g_array_new (FALSE, FALSE, element_size);
+    }
+}
+
+void
+pt_peak_pyramid_free (PtPeakPyramid *self)
+{
+  for (gint k = 0; k < N_LEVELS; k++)
+    g_array_unref (self->levels[k]);
+
+  g_free (self);
+}
+
+PtPeakPyramid *
+pt_peak_pyramid_new (void)
+{
+  PtPeakPyramid *self = g_new0 (PtPeakPyramid, 1);
+
+  pt_peak_pyramid_reset (self, FALSE, FALSE);
+
+  return self;
+}
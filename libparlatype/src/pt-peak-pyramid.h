@@ -0,0 +1,42 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "pt-sample-store.h"
+#include <glib.h>
+
+typedef struct _PtPeakPyramid PtPeakPyramid;
+
+PtPeakPyramid *pt_peak_pyramid_new       (void);
+void           pt_peak_pyramid_free      (PtPeakPyramid *self);
+void           pt_peak_pyramid_reset     (PtPeakPyramid *self,
+                                          gboolean       compact,
+                                          gboolean       quantize);
+void           pt_peak_pyramid_update    (PtPeakPyramid *self,
+                                          PtSampleStore *store,
+                                          guint          end);
+void           pt_peak_pyramid_finish    (PtPeakPyramid *self,
+                                          PtSampleStore *store,
+                                          guint          end);
+guint          pt_peak_pyramid_get_end   (PtPeakPyramid *self);
+void           pt_peak_pyramid_get_range (PtPeakPyramid *self,
+                                          PtSampleStore *store,
+                                          guint          start,
+                                          guint          end,
+                                          gint16        *min,
+                                          gint16        *max);
+gsize          pt_peak_pyramid_get_size  (PtPeakPyramid *self);
@@ -0,0 +1,351 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * pt-peak-store
+ * Decoded samples and their peak index, shared by all loaders of a process.
+ *
+ * A PtPeakData holds the samples and the pyramid of one file. It is
+ * reference counted, PtWaveloaders with #PtWaveloader:shared attach to it
+ * instead of decoding the file again. The store keeps a weak table of all
+ * data by URI: the first loader that attaches to a URI becomes the owner
+ * and decodes the file, all others wait until the data is complete. The
+ * data is freed when the last loader detaches.
+ *
+ * Entries are identified by URI, file size and modification time. If the
+ * file changed, a new entry replaces the old one in the table, users of the
+ * old entry keep it until they detach.
+ *
+ * The table and the state of all data are protected by a lock, loaders of
+ * different threads can share data. Samples and pyramid are written by the
+ * owner only, others must not read them before the state is
+ * PT_PEAK_DATA_COMPLETE. After that they are read-only.
+ */
+
+#include "config.h"
+
+#include "pt-peak-store.h"
+
+#include <gio/gio.h>
+
+struct _PtPeakData
+{
+  gint ref_count; /* protected by lock */
+
+  PtSampleStore *samples;
+  PtPeakPyramid *pyramid;
+  gint64         duration;
+
+  /* Protected by lock */
+  PtPeakDataState state;
+  GError         *error;
+  gchar          *uri; /* NULL if not in the table */
+  guint64         file_size;
+  gint64          file_mtime;
+};
+
+G_LOCK_DEFINE_STATIC (store);
+static GHashTable *store; /* URI → PtPeakData, not referenced */
+
+static void
+get_file_identity (const gchar *uri,
+                   guint64     *size,
+                   gint64      *mtime)
+{
+  GFile     *file;
+  GFileInfo *info;
+
+  *size = 0;
+  *mtime = 0;
+
+  file = g_file_new_for_uri (uri);
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  g_object_unref (file);
+
+  /* Not fatal, remote files are identified by URI only */
+  if (!info)
+    return;
+
+  *size = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_STANDARD_SIZE);
+  *mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC + g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+  g_object_unref (info);
+}
+
+static void
+unregister_locked (PtPeakData *data)
+{
+  if (!data->uri)
+    return;
+
+  /* A newer entry with the same URI may have replaced it already */
+  if (g_hash_table_lookup (store, data->uri) == data)
+    g_hash_table_remove (store, data->uri);
+
+  g_clear_pointer (&data->uri, g_free);
+}
+
+/**
+ * pt_peak_data_new:
+ *
+ * Creates empty data that is not in the store. Its state is
+ * PT_PEAK_DATA_LOADING.
+ *
+ * Return value: (transfer full): new data, free with pt_peak_data_unref()
+ */
+PtPeakData *
+pt_peak_data_new (void)
+{
+  PtPeakData *data;
+
+  data = g_new0 (PtPeakData, 1);
+  data->ref_count = 1;
+  data->samples = pt_sample_store_new ();
+  data->pyramid = pt_peak_pyramid_new ();
+  data->state = PT_PEAK_DATA_LOADING;
+
+  return data;
+}
+
+/**
+ * pt_peak_data_ref:
+ * @data: the data
+ *
+ * Return value: (transfer full): @data
+ */
+PtPeakData *
+pt_peak_data_ref (PtPeakData *data)
+{
+  G_LOCK (store);
+  data->ref_count++;
+  G_UNLOCK (store);
+
+  return data;
+}
+
+/**
+ * pt_peak_data_unref:
+ * @data: (nullable): the data
+ *
+ * Drops a reference. The last one removes @data from the store and frees it.
+ */
+void
+pt_peak_data_unref (PtPeakData *data)
+{
+  gboolean last;
+
+  if (!data)
+    return;
+
+  /* Lookups in the store take a reference under the same lock, nobody can
+   * find the data once it’s removed */
+  G_LOCK (store);
+  last = --data->ref_count == 0;
+  if (last)
+    unregister_locked (data);
+  G_UNLOCK (store);
+
+  if (!last)
+    return;
+
+  pt_sample_store_free (data->samples);
+  pt_peak_pyramid_free (data->pyramid);
+  g_clear_error (&data->error);
+  g_free (data);
+}
+
+/**
+ * pt_peak_data_is_shared:
+ * @data: the data
+ *
+ * Return value: TRUE if @data is in the store or has more than one user,
+ * i.e. it must not be changed by one of its users
+ */
+gboolean
+pt_peak_data_is_shared (PtPeakData *data)
+{
+  gboolean result;
+
+  G_LOCK (store);
+  result = data->uri != NULL || data->ref_count > 1;
+  G_UNLOCK (store);
+
+  return result;
+}
+
+PtSampleStore *
+pt_peak_data_get_samples (PtPeakData *data)
+{
+  return data->samples;
+}
+
+PtPeakPyramid *
+pt_peak_data_get_pyramid (PtPeakData *data)
+{
+  return data->pyramid;
+}
+
+/**
+ * pt_peak_data_get_duration:
+ * @data: the data
+ *
+ * Return value: duration of the file in nanoseconds, valid if the state is
+ * PT_PEAK_DATA_COMPLETE
+ */
+gint64
+pt_peak_data_get_duration (PtPeakData *data)
+{
+  return data->duration;
+}
+
+/**
+ * pt_peak_data_get_state:
+ * @data: the data
+ * @error: (nullable): return location for the owner’s error
+ *
+ * If the state is PT_PEAK_DATA_FAILED, @error is set to a copy of the
+ * owner’s error. It’s not set if the owner was cancelled, another user can
+ * try to load the file then.
+ *
+ * Return value: the state
+ */
+PtPeakDataState
+pt_peak_data_get_state (PtPeakData *data,
+                        GError    **error)
+{
+  PtPeakDataState state;
+
+  G_LOCK (store);
+  state = data->state;
+  if (state == PT_PEAK_DATA_FAILED && data->error)
+    g_propagate_error (error, g_error_copy (data->error));
+  G_UNLOCK (store);
+
+  return state;
+}
+
+/**
+ * pt_peak_data_complete:
+ * @data: the data
+ * @duration: duration of the file in nanoseconds
+ *
+ * Called by the owner after it has written all samples. From now on samples
+ * and pyramid are read-only.
+ */
+void
+pt_peak_data_complete (PtPeakData *data,
+                       gint64      duration)
+{
+  data->duration = duration;
+
+  G_LOCK (store);
+  data->state = PT_PEAK_DATA_COMPLETE;
+  G_UNLOCK (store);
+}
+
+/**
+ * pt_peak_data_fail:
+ * @data: the data
+ * @error: (nullable): the owner’s error, NULL if it was cancelled
+ *
+ * Called by the owner if loading failed. @data is removed from the store,
+ * the next user who attaches to the URI becomes a new owner.
+ */
+void
+pt_peak_data_fail (PtPeakData   *data,
+                   const GError *error)
+{
+  G_LOCK (store);
+  data->state = PT_PEAK_DATA_FAILED;
+  g_clear_error (&data->error);
+  if (error)
+    data->error = g_error_copy (error);
+  unregister_locked (data);
+  G_UNLOCK (store);
+}
+
+/**
+ * pt_peak_store_attach:
+ * @uri: URI of the file
+ * @owner: (out): return location for ownership
+ *
+ * Looks up the data of @uri or adds new, empty data to the store. In the
+ * latter case @owner is set to TRUE and the caller has to load the file and
+ * call pt_peak_data_complete() or pt_peak_data_fail() when done.
+ *
+ * Return value: (transfer full): the data, free with pt_peak_data_unref()
+ */
+PtPeakData *
+pt_peak_store_attach (const gchar *uri,
+                      gboolean    *owner)
+{
+  PtPeakData *data;
+  guint64     file_size;
+  gint64      file_mtime;
+
+  get_file_identity (uri, &file_size, &file_mtime);
+
+  G_LOCK (store);
+
+  if (!store)
+    store = g_hash_table_new (g_str_hash, g_str_equal);
+
+  data = g_hash_table_lookup (store, uri);
+  if (data && (data->file_size != file_size || data->file_mtime != file_mtime))
+    {
+      /* Outdated, its users keep it */
+      unregister_locked (data);
+      data = NULL;
+    }
+
+  if (data)
+    {
+      data->ref_count++;
+      *owner = FALSE;
+    }
+  else
+    {
+      data = pt_peak_data_new ();
+      data->uri = g_strdup (uri);
+      data->file_size = file_size;
+      data->file_mtime = file_mtime;
+      g_hash_table_insert (store, data->uri, data);
+      *owner = TRUE;
+    }
+
+  G_UNLOCK (store);
+
+  return data;
+}
+
+/**
+ * pt_peak_store_get_size:
+ *
+ * Return value: number of files in the store
+ */
+guint
+pt_peak_store_get_size (void)
+{
+  guint size;
+
+  G_LOCK (store);
+  size = store ? g_hash_table_size (store) : 0;
+  G_UNLOCK (store);
+
+  return size;
+}
@@ -0,0 +1,48 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "pt-peak-pyramid.h"
+#include "pt-sample-store.h"
+#include <glib.h>
+
+typedef enum
+{
+  PT_PEAK_DATA_LOADING,
+  PT_PEAK_DATA_COMPLETE,
+  PT_PEAK_DATA_FAILED
+} PtPeakDataState;
+
+typedef struct _PtPeakData PtPeakData;
+
+PtPeakData     *pt_peak_data_new          (void);
+PtPeakData     *pt_peak_data_ref          (PtPeakData   *data);
+void            pt_peak_data_unref        (PtPeakData   *data);
+gboolean        pt_peak_data_is_shared    (PtPeakData   *data);
+PtSampleStore  *pt_peak_data_get_samples  (PtPeakData   *data);
+PtPeakPyramid  *pt_peak_data_get_pyramid  (PtPeakData   *data);
+gint64          pt_peak_data_get_duration (PtPeakData   *data);
+PtPeakDataState pt_peak_data_get_state    (PtPeakData   *data,
+                                           GError      **error);
+void            pt_peak_data_complete     (PtPeakData   *data,
+                                           gint64        duration);
+void            pt_peak_data_fail         (PtPeakData   *data,
+                                           const GError *error);
+
+PtPeakData     *pt_peak_store_attach      (const gchar  *uri,
+                                           gboolean     *owner);
+guint           pt_peak_store_get_size    (void);
@@ -33,6 +33,7 @@
 #include "config.h"
 
 #include "pt-player.h"
+#include "pt-player-private.h"
 
 #include "gst/gst-helpers.h"
 #include "gst/gstptaudiobin.h"
@@ -80,6 +81,15 @@ struct _PtPlayerPrivate
   GSource     *seek_source;
   GstClockTime seek_position;
 
+  /* Position tracker: an anchor position that is extrapolated with the
+   * pipeline clock while playing. Written in the main context only. */
+  gint         pos_seq; /* odd while the anchor is written */
+  gboolean     pos_valid;
+  gint64       pos_anchor;
+  GstClockTime pos_clock_time; /* GST_CLOCK_TIME_NONE if not running */
+  gdouble      pos_rate;
+  GstClock    *pos_clock;
+
   gint64   dur;
   gdouble  speed;
   gdouble  volume;
@@ -92,6 +102,14 @@ struct _PtPlayerPrivate
 
   gint64       segstart;
   GstClockTime segend;
+  gboolean     grown; /* followed file has new data */
+
+  GTask *open_task; /* pending pt_player_open_uri_async() */
+  guint  open_cancel_id;
+  gulong open_probe_id; /* holds back the first buffer, see open_prepare() */
+  gint64 open_position; /* initial seek in ms, -1 if sent; guarded by lock */
+  guint  n_seeks;       /* since the file was opened, guarded by lock */
+  guint  n_prerolls;    /* since the file was opened */
 
   GCancellable *c;
   guint         vol_changed_id;
@@ -129,21 +147,147 @@ enum
 
 static GParamSpec *obj_properties[N_PROPERTIES];
 
+typedef struct
+{
+  gchar *uri;
+  gint64 position; /* saved position in milliseconds */
+} OpenData;
+
 #define ONE_HOUR 3600000
 #define TEN_MINUTES 600000
 
 static gboolean bus_call (GstBus *bus, GstMessage *msg, gpointer data);
+static void     finish_open (PtPlayer *self, GError *error);
+static void     clear_open_probe (PtPlayer *self);
 
 G_DEFINE_TYPE_WITH_PRIVATE (PtPlayer, pt_player, G_TYPE_OBJECT)
 
 /* -------------------------- static helpers -------------------------------- */
 
+static void
+anchor_position (PtPlayer    *self,
+                 gboolean     valid,
+                 gint64       position,
+                 GstClock    *clock,
+                 GstClockTime clock_time,
+                 gdouble      rate)
+{
+  /* Sets a new anchor. Readers retry if the sequence number changed or is
+   * odd, they don’t take a lock. */
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+
+  g_atomic_int_inc (&priv->pos_seq);
+  priv->pos_valid = valid;
+  priv->pos_anchor = position;
+  priv->pos_clock_time = clock_time;
+  priv->pos_rate = rate;
+  /* The clock is kept until the next running anchor or disposal, a reader
+   * never uses a freed clock */
+  if (clock)
+    gst_object_replace ((GstObject **) &priv->pos_clock, GST_OBJECT (clock));
+  g_atomic_int_inc (&priv->pos_seq);
+}
+
+static void
+anchor_paused (PtPlayer *self,
+               gint64    position)
+{
+  anchor_position (self, TRUE, position, NULL, GST_CLOCK_TIME_NONE, 1.0);
+}
+
+static void
+anchor_from_pipeline (PtPlayer *self,
+                      gboolean  running)
+{
+  /* Anchors on the pipeline’s position. If it’s running, the clock time and
+   * the segment’s rate are taken, too. */
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  GstClock        *clock = NULL;
+  GstClockTime     clock_time = GST_CLOCK_TIME_NONE;
+  GstQuery        *query;
+  gdouble          rate = priv->speed;
+  gint64           pos;
+
+  if (running)
+    clock = gst_element_get_clock (priv->play);
+
+  if (!gst_element_query_position (priv->play, GST_FORMAT_TIME, &pos))
+    {
+      anchor_position (self, FALSE, 0, NULL, GST_CLOCK_TIME_NONE, 1.0);
+      g_clear_pointer (&clock, gst_object_unref);
+      return;
+    }
+
+  if (clock)
+    {
+      clock_time = gst_clock_get_time (clock);
+      query = gst_query_new_segment (GST_FORMAT_TIME);
+      if (gst_element_query (priv->play, query))
+        gst_query_parse_segment (query, &rate, NULL, NULL, NULL);
+      gst_query_unref (query);
+    }
+
+  anchor_position (self, TRUE, pos, clock, clock_time, rate);
+  g_clear_pointer (&clock, gst_object_unref);
+}
+
+static gboolean
+get_tracked_position (PtPlayer *self,
+                      gint64   *position)
+{
+  /* Returns the anchor position, extrapolated with the clock if running.
+   * Falls back to a query if there is no anchor yet. */
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  gint             seq;
+  gboolean         valid;
+  gint64           pos;
+  GstClockTime     clock_time;
+  gdouble          rate;
+  GstClock        *clock;
+  GstClockTime     now;
+  gint64           stop;
+
+  do
+    {
+      seq = g_atomic_int_get (&priv->pos_seq);
+      valid = priv->pos_valid;
+      pos = priv->pos_anchor;
+      clock_time = priv->pos_clock_time;
+      rate = priv->pos_rate;
+      clock = priv->pos_clock;
+    }
+  while ((seq & 1) || g_atomic_int_get (&priv->pos_seq) != seq);
+
+  if (!valid)
+    return gst_element_query_position (priv->play, GST_FORMAT_TIME, position);
+
+  if (GST_CLOCK_TIME_IS_VALID (clock_time) && clock)
+    {
+      now = gst_clock_get_time (clock);
+      if (GST_CLOCK_TIME_IS_VALID (now) && now > clock_time)
+        pos += (gint64) ((now - clock_time) * rate);
+
+      /* Playback stops at the end of the segment */
+      stop = GST_CLOCK_TIME_IS_VALID (priv->segend) ? (gint64) priv->segend : priv->dur;
+      if (stop > 0 && pos > stop)
+        pos = stop;
+    }
+
+  *position = pos;
+  return TRUE;
+}
+
 static void
 pt_player_clear (PtPlayer *self)
 {
   PtPlayerPrivate *priv = pt_player_get_instance_private (self);
 
   g_clear_handle_id (&priv->bus_watch_id, g_source_remove);
+  clear_open_probe (self);
+  anchor_position (self, FALSE, 0, NULL, GST_CLOCK_TIME_NONE, 1.0);
   priv->target_state = GST_STATE_NULL;
   priv->current_state = GST_STATE_NULL;
   gst_element_set_state (priv->play, GST_STATE_NULL);
@@ -199,6 +343,9 @@ pt_player_seek_internal_locked (PtPlayer *self)
   stop = priv->segend;
   g_mutex_unlock (&priv->lock);
 
+  /* Until the seek is done, the position is its target */
+  anchor_paused (self, position);
+
   g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
                     "MESSAGE", "Seek to position %" GST_TIME_FORMAT ", stop at %" GST_TIME_FORMAT,
                     GST_TIME_ARGS (position), GST_TIME_ARGS (stop));
@@ -221,6 +368,8 @@ pt_player_seek_internal_locked (PtPlayer *self)
     }
 
   g_mutex_lock (&priv->lock);
+  if (ret)
+    priv->n_seeks++;
 }
 
 static gboolean
@@ -293,7 +442,8 @@ pt_player_get_file (PtPlayer *self)
 }
 
 static void
-metadata_save_position (PtPlayer *self)
+metadata_save_position (PtPlayer *self,
+                        gboolean  async)
 {
   PtPlayerPrivate *priv = pt_player_get_instance_private (self);
   GFile           *file = NULL;
@@ -308,24 +458,11 @@ metadata_save_position (PtPlayer *self)
 
   pos = pos / GST_MSECOND;
 
-  pt_position_manager_save (priv->pos_mgr, file, pos);
-  g_object_unref (file);
-}
-
-static void
-metadata_goto_position (PtPlayer *self)
-{
-  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
-  GFile           *file = NULL;
-  gint64           pos;
-
-  file = pt_player_get_file (self);
-  if (!file)
-    return;
-
-  pos = pt_position_manager_load (priv->pos_mgr, file);
-
-  pt_player_jump_to_position (self, pos);
+  /* Writing metadata can block, e.g. on network mounts */
+  if (async)
+    pt_position_manager_save_async (priv->pos_mgr, file, pos);
+  else
+    pt_position_manager_save (priv->pos_mgr, file, pos);
   g_object_unref (file);
 }
 
@@ -411,6 +548,32 @@ update_stream_collection (PtPlayer            *self,
                                              self);
 }
 
+static void
+reopen_grown_file (PtPlayer *self,
+                   gboolean  play)
+{
+  /* GStreamer knows only the old size of a followed file. Open it again at
+   * the same position, the new part can be played then. */
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  gint64           pos = 0;
+
+  priv->grown = FALSE;
+  gst_element_query_position (priv->play, GST_FORMAT_TIME, &pos);
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "MESSAGE",
+                    "Reopening grown file at %" GST_TIME_FORMAT, GST_TIME_ARGS (pos));
+
+  if (play)
+    priv->target_state = GST_STATE_PLAYING;
+  gst_element_set_state (priv->play, GST_STATE_READY);
+
+  /* Seek is done when PAUSED is reached */
+  g_mutex_lock (&priv->lock);
+  priv->seek_position = pos;
+  g_mutex_unlock (&priv->lock);
+  gst_element_set_state (priv->play, GST_STATE_PAUSED);
+}
+
 static gboolean
 bus_call (GstBus     *bus,
           GstMessage *msg,
@@ -424,6 +587,11 @@ bus_call (GstBus     *bus,
     {
     case GST_MESSAGE_EOS:
       g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "MESSAGE", "EOS");
+      if (priv->grown && !GST_CLOCK_TIME_IS_VALID (priv->segend))
+        {
+          reopen_grown_file (self, TRUE);
+          break;
+        }
       /* Sometimes the current position is not exactly at the end which looks like
        * a premature EOS or makes the cursor disappear.*/
       gst_element_query_position (priv->play, GST_FORMAT_TIME, &pos);
@@ -471,6 +639,8 @@ bus_call (GstBus     *bus,
 
         if (new_state == GST_STATE_PAUSED && pending_state == GST_STATE_VOID_PENDING)
           {
+            priv->n_prerolls++;
+            anchor_from_pipeline (self, FALSE);
             g_mutex_lock (&priv->lock);
             if (priv->seek_pending)
               {
@@ -517,16 +687,22 @@ bus_call (GstBus     *bus,
               {
                 g_mutex_unlock (&priv->lock);
               }
+
+            /* A pending async open is prerolled */
+            if (priv->open_task)
+              finish_open (self, NULL);
           }
 
         if (new_state == GST_STATE_PLAYING && pending_state == GST_STATE_VOID_PENDING)
           {
+            anchor_from_pipeline (self, TRUE);
             if (!priv->seek_pending)
               change_app_state (self, PT_STATE_PLAYING);
           }
         if (new_state == GST_STATE_READY &&
             old_state > GST_STATE_READY)
           {
+            anchor_position (self, FALSE, 0, NULL, GST_CLOCK_TIME_NONE, 1.0);
             change_app_state (self, PT_STATE_STOPPED);
           }
         break;
@@ -547,12 +723,32 @@ bus_call (GstBus     *bus,
                           "MESSAGE", "Debugging info: %s", (debug) ? debug : "none");
         g_free (debug);
 
+        /* An async open returns the error instead */
+        if (priv->open_task)
+          {
+            finish_open (self, error);
+            break;
+          }
+
         g_signal_emit_by_name (self, "error", error);
         g_error_free (error);
         pt_player_clear (self);
         break;
       }
 
+    case GST_MESSAGE_BUFFERING:
+      {
+        gint percent;
+
+        if (!priv->open_task)
+          break;
+
+        gst_message_parse_buffering (msg, &percent);
+        if (percent < 100)
+          g_signal_emit_by_name (self, "open-progress", percent / 100.0);
+        break;
+      }
+
     case GST_MESSAGE_ELEMENT:
       if (g_strcmp0 (GST_MESSAGE_SRC_NAME (msg), "parlasphinx") == 0)
         {
@@ -622,6 +818,334 @@ bus_call (GstBus     *bus,
 
 /* -------------------------- opening files --------------------------------- */
 
+static void
+open_data_free (OpenData *data)
+{
+  g_free (data->uri);
+  g_free (data);
+}
+
+static void
+clear_open_probe (PtPlayer *self)
+{
+  /* Releases the first buffer if the initial seek was not sent */
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  GstPad          *pad;
+  gulong           id;
+
+  g_mutex_lock (&priv->lock);
+  id = priv->open_probe_id;
+  priv->open_probe_id = 0;
+  priv->open_position = -1;
+  g_mutex_unlock (&priv->lock);
+
+  if (id == 0)
+    return;
+
+  pad = gst_element_get_static_pad (priv->scaletempo, "sink");
+  gst_pad_remove_probe (pad, id);
+  gst_object_unref (pad);
+}
+
+static void
+open_seek (GstElement *play,
+           gpointer    user_data)
+{
+  /* Runs in a GStreamer thread, the streaming thread is blocked and can’t
+   * seek itself. The flush drops the held back buffer. */
+
+  PtPlayer        *self = PT_PLAYER (user_data);
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  gint64           position;
+  gdouble          speed;
+
+  g_mutex_lock (&priv->lock);
+  position = priv->open_position;
+  priv->open_position = -1;
+  speed = priv->speed;
+  g_mutex_unlock (&priv->lock);
+
+  if (position < 0)
+    return;
+
+  if (gst_element_seek (play,
+                        speed,
+                        GST_FORMAT_TIME,
+                        GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE,
+                        GST_SEEK_TYPE_SET,
+                        position * GST_MSECOND,
+                        GST_SEEK_TYPE_NONE,
+                        GST_CLOCK_TIME_NONE))
+    {
+      g_mutex_lock (&priv->lock);
+      priv->n_seeks++;
+      g_mutex_unlock (&priv->lock);
+      return;
+    }
+
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "MESSAGE",
+                    "Initial seek failed");
+  clear_open_probe (self);
+}
+
+static GstPadProbeReturn
+open_probe_cb (GstPad          *pad,
+               GstPadProbeInfo *info,
+               gpointer         user_data)
+{
+  /* The first buffer waits for the initial seek, the first one after it
+   * passes and removes the probe */
+
+  PtPlayer         *self = PT_PLAYER (user_data);
+  PtPlayerPrivate  *priv = pt_player_get_instance_private (self);
+  GstPadProbeReturn ret;
+
+  g_mutex_lock (&priv->lock);
+  if (priv->open_position < 0)
+    {
+      /* Unless clear_open_probe() removes it already */
+      ret = priv->open_probe_id ? GST_PAD_PROBE_REMOVE : GST_PAD_PROBE_PASS;
+      priv->open_probe_id = 0;
+      g_mutex_unlock (&priv->lock);
+      return ret;
+    }
+  g_mutex_unlock (&priv->lock);
+
+  gst_element_call_async (priv->play, open_seek,
+                          g_object_ref (self), g_object_unref);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+close_current (PtPlayer *self)
+{
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+
+  /* If we had an open file before, remember its position */
+  metadata_save_position (self, TRUE);
+
+  /* Reset any open streams */
+  pt_player_clear (self);
+  priv->dur = -1;
+  g_mutex_lock (&priv->lock);
+  priv->n_seeks = 0;
+  g_mutex_unlock (&priv->lock);
+  priv->n_prerolls = 0;
+}
+
+static void
+open_prepare (PtPlayer *self,
+              gchar    *uri,
+              gint64    position)
+{
+  /* Starts prerolling @uri at @position. playbin3 has no sinks in the
+   * READY state and can’t seek there. Instead the first audio buffer is
+   * held back until a flushing seek to @position is sent, so that the file
+   * is prerolled only once. Without audio or if that seek fails,
+   * apply_position() seeks after prerolling. */
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  GstBus          *bus;
+  GstPad          *pad;
+
+  g_object_set (G_OBJECT (priv->play), "uri", uri, NULL);
+
+  /* setup message handler */
+  bus = gst_pipeline_get_bus (GST_PIPELINE (priv->play));
+  priv->bus_watch_id = gst_bus_add_watch (bus, bus_call, self);
+  gst_object_unref (bus);
+
+  if (position > 0)
+    {
+      pad = gst_element_get_static_pad (priv->scaletempo, "sink");
+      g_mutex_lock (&priv->lock);
+      priv->open_position = position;
+      priv->open_probe_id = gst_pad_add_probe (pad,
+                                               GST_PAD_PROBE_TYPE_BLOCK |
+                                                   GST_PAD_PROBE_TYPE_BUFFER,
+                                               open_probe_cb, self, NULL);
+      g_mutex_unlock (&priv->lock);
+      gst_object_unref (pad);
+    }
+
+  pt_player_pause (self);
+}
+
+static void
+open_complete (PtPlayer *self)
+{
+  /* Called after prerolling */
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  gint64           dur = 0;
+
+  /* No audio stream, the probe was never reached */
+  clear_open_probe (self);
+
+  gst_element_query_duration (priv->play, GST_FORMAT_TIME, &dur);
+  priv->dur = dur;
+  priv->segstart = 0;
+  priv->segend = GST_CLOCK_TIME_NONE;
+  priv->grown = FALSE;
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "MESSAGE",
+                    "Initial duration: %" GST_TIME_FORMAT, GST_TIME_ARGS (dur));
+}
+
+static void
+apply_position (PtPlayer *self,
+                gint64    position)
+{
+  /* Seeks to @position in milliseconds if the initial seek was not applied */
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  gint64           pos = 0;
+
+  gst_element_query_position (priv->play, GST_FORMAT_TIME, &pos);
+  if (ABS (pos - position * GST_MSECOND) < GST_MSECOND)
+    return;
+
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "MESSAGE",
+                    "Prerolled at %" GST_TIME_FORMAT ", seeking to saved position",
+                    GST_TIME_ARGS (pos));
+  pt_player_jump_to_position (self, position);
+}
+
+static void
+finish_open (PtPlayer *self,
+             GError   *error)
+{
+  /* Returns the pending async open, takes ownership of @error */
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  GTask           *task;
+  OpenData        *data;
+
+  task = g_steal_pointer (&priv->open_task);
+  g_clear_handle_id (&priv->open_cancel_id, g_source_remove);
+
+  if (error)
+    {
+      pt_player_clear (self);
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  data = g_task_get_task_data (task);
+  open_complete (self);
+  apply_position (self, data->position);
+  g_signal_emit_by_name (self, "open-progress", 1.0);
+  g_task_return_boolean (task, TRUE);
+  g_object_unref (task);
+}
+
+static void
+cancel_open (PtPlayer *self)
+{
+  /* A new file supersedes a pending async open */
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+
+  if (!priv->open_task)
+    return;
+
+  finish_open (self, g_error_new (G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                  _ ("Superseded by another file.")));
+}
+
+static GError *
+pop_open_error (PtPlayer *self)
+{
+  /* The state change failed, the reason is an error message that might
+   * not have been dispatched yet */
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  GstBus          *bus;
+  GstMessage      *msg;
+  GError          *error = NULL;
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (priv->play));
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ERROR);
+  gst_object_unref (bus);
+
+  if (msg)
+    {
+      gst_message_parse_error (msg, &error, NULL);
+      gst_message_unref (msg);
+      return error;
+    }
+
+  return g_error_new (GST_CORE_ERROR, GST_CORE_ERROR_STATE_CHANGE,
+                      _ ("Failed to open file."));
+}
+
+static gboolean
+open_cancelled_cb (GCancellable *cancellable,
+                   PtPlayer     *self)
+{
+  /* The pending async open was cancelled while prerolling */
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  GError          *error = NULL;
+
+  priv->open_cancel_id = 0;
+  g_cancellable_set_error_if_cancelled (cancellable, &error);
+  finish_open (self, error);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+position_loaded_cb (PtPositionManager *pos_mgr,
+                    GAsyncResult      *res,
+                    GTask             *task)
+{
+  /* The saved position is known, start prerolling there */
+
+  PtPlayer        *self = g_task_get_source_object (task);
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  OpenData        *data = g_task_get_task_data (task);
+  GError          *error = NULL;
+
+  data->position = pt_position_manager_load_finish (pos_mgr, res, &error);
+
+  /* Superseded by another file */
+  if (priv->open_task != task)
+    {
+      g_clear_error (&error);
+      g_object_unref (task);
+      return;
+    }
+
+  if (error)
+    {
+      finish_open (self, error);
+      g_object_unref (task);
+      return;
+    }
+
+  /* The task is finished in bus_call() when the pipeline is prerolled or
+   * fails with an error message */
+  open_prepare (self, data->uri, data->position);
+  if (gst_element_get_state (priv->play, NULL, NULL, 0) == GST_STATE_CHANGE_FAILURE)
+    {
+      finish_open (self, pop_open_error (self));
+      g_object_unref (task);
+      return;
+    }
+
+  if (g_task_get_cancellable (task))
+    {
+      GSource *source = g_cancellable_source_new (g_task_get_cancellable (task));
+      g_source_set_callback (source, G_SOURCE_FUNC (open_cancelled_cb), self, NULL);
+      priv->open_cancel_id = g_source_attach (source, NULL);
+      g_source_unref (source);
+    }
+  g_object_unref (task);
+}
+
 /**
  * pt_player_open_uri:
  * @self: a #PtPlayer
@@ -633,13 +1157,14 @@ bus_call (GstBus     *bus,
  *
  * When closing a file or on object destruction PtPlayer tries to write the
  * last position into the file’s metadata. On opening a file it reads the
- * metadata and jumps to the last known position if found.
+ * metadata first and starts at the last known position if found.
  *
  * The player is set to the paused state and ready for playback. To start
  * playback use @pt_player_play().
  *
  * This operation blocks until it is finished. It returns TRUE on success or
  * FALSE on error. Errors are emitted async via #PtPlayer::error signal.
+ * See pt_player_open_uri_async() for a variant that doesn’t block.
  *
  * Return value: TRUE if successful, otherwise FALSE
  *
@@ -653,23 +1178,17 @@ pt_player_open_uri (PtPlayer *self,
   g_return_val_if_fail (uri != NULL, FALSE);
 
   PtPlayerPrivate *priv = pt_player_get_instance_private (self);
-  GstBus          *bus;
-
-  /* If we had an open file before, remember its position */
-  metadata_save_position (self);
-
-  /* Reset any open streams */
-  pt_player_clear (self);
-  priv->dur = -1;
+  GFile           *file;
+  gint64           position;
 
-  g_object_set (G_OBJECT (priv->play), "uri", uri, NULL);
+  cancel_open (self);
+  close_current (self);
 
-  /* setup message handler */
-  bus = gst_pipeline_get_bus (GST_PIPELINE (priv->play));
-  priv->bus_watch_id = gst_bus_add_watch (bus, bus_call, self);
-  gst_object_unref (bus);
+  file = g_file_new_for_uri (uri);
+  position = pt_position_manager_load (priv->pos_mgr, file);
+  g_object_unref (file);
 
-  pt_player_pause (self);
+  open_prepare (self, uri, position);
 
   /* Block until state changed, return on failure */
   if (gst_element_get_state (priv->play,
@@ -677,18 +1196,106 @@ pt_player_open_uri (PtPlayer *self,
                              GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_FAILURE)
     return FALSE;
 
-  gint64 dur = 0;
-  gst_element_query_duration (priv->play, GST_FORMAT_TIME, &dur);
-  priv->dur = dur;
-  priv->segstart = 0;
-  priv->segend = GST_CLOCK_TIME_NONE;
-  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "MESSAGE",
-                    "Initial duration: %" GST_TIME_FORMAT, GST_TIME_ARGS (dur));
-
-  metadata_goto_position (self);
+  open_complete (self);
+  apply_position (self, position);
   return TRUE;
 }
 
+/**
+ * pt_player_open_uri_async:
+ * @self: a #PtPlayer
+ * @uri: the URI of the file
+ * @cancellable: (nullable): a #GCancellable or NULL
+ * @callback: (scope async) (closure user_data): a #GAsyncReadyCallback to call when the operation is complete
+ * @user_data: user data for @callback
+ *
+ * Opens a file like pt_player_open_uri() without blocking. The last known
+ * position is looked up first, then the file is prerolled at that position.
+ * While prerolling, #PtPlayer::open-progress may be emitted.
+ *
+ * Opening another file, synchronously or asynchronously, cancels a pending
+ * operation. Errors are not emitted via #PtPlayer::error, they are returned
+ * in pt_player_open_uri_finish().
+ *
+ * Since: 4.3
+ */
+void
+pt_player_open_uri_async (PtPlayer           *self,
+                          gchar              *uri,
+                          GCancellable       *cancellable,
+                          GAsyncReadyCallback callback,
+                          gpointer            user_data)
+{
+  g_return_if_fail (PT_IS_PLAYER (self));
+  g_return_if_fail (uri != NULL);
+
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+  GTask           *task;
+  OpenData        *data;
+  GFile           *file;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, pt_player_open_uri_async);
+  data = g_new0 (OpenData, 1);
+  data->uri = g_strdup (uri);
+  g_task_set_task_data (task, data, (GDestroyNotify) open_data_free);
+
+  cancel_open (self);
+  close_current (self);
+  priv->open_task = task;
+
+  file = g_file_new_for_uri (uri);
+  pt_position_manager_load_async (priv->pos_mgr, file, cancellable,
+                                  (GAsyncReadyCallback) position_loaded_cb,
+                                  g_object_ref (task));
+  g_object_unref (file);
+}
+
+/**
+ * pt_player_open_uri_finish:
+ * @self: a #PtPlayer
+ * @result: the #GAsyncResult passed to your #GAsyncReadyCallback
+ * @error: (nullable): a pointer to a NULL #GError, or NULL
+ *
+ * Gives the result of the async open operation. A cancelled operation
+ * results in an error, too.
+ *
+ * Return value: TRUE if successful, or FALSE with error set
+ *
+ * Since: 4.3
+ */
+gboolean
+pt_player_open_uri_finish (PtPlayer     *self,
+                           GAsyncResult *result,
+                           GError      **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * _pt_player_get_open_stats:
+ * @self: a #PtPlayer
+ * @seeks: (out): return location for the number of seeks
+ * @prerolls: (out): return location for the number of prerolls
+ *
+ * Counts successful seeks and completed prerolls since the current file was
+ * opened, for tests.
+ */
+void
+_pt_player_get_open_stats (PtPlayer *self,
+                           guint    *seeks,
+                           guint    *prerolls)
+{
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+
+  g_mutex_lock (&priv->lock);
+  *seeks = priv->n_seeks;
+  g_mutex_unlock (&priv->lock);
+  *prerolls = priv->n_prerolls;
+}
+
 /* ------------------------- Basic controls --------------------------------- */
 
 /**
@@ -1317,6 +1924,11 @@ pt_player_set_mute (PtPlayer *self,
  *
  * Returns the current position in stream.
  *
+ * The pipeline is not queried. The position is taken on every seek and
+ * state change and extrapolated with the pipeline’s clock and the playback
+ * rate, which is the same computation the audio sink does. It’s cheap
+ * enough to be called on every frame.
+ *
  * Return value: position in milliseconds or -1 on failure
  *
  * Since: 1.5
@@ -1326,10 +1938,9 @@ pt_player_get_position (PtPlayer *self)
 {
   g_return_val_if_fail (PT_IS_PLAYER (self), -1);
 
-  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
-  gint64           time;
+  gint64 time;
 
-  if (!gst_element_query_position (priv->play, GST_FORMAT_TIME, &time))
+  if (!get_tracked_position (self, &time))
     return -1;
 
   return GST_TIME_AS_MSECONDS (time);
@@ -1407,13 +2018,32 @@ wv_play_toggled_cb (GtkWidget *widget,
   pt_player_play_pause (self);
 }
 
+static void
+wv_duration_changed_cb (PtWaveviewer *wv,
+                        gint64        duration,
+                        PtPlayer     *self)
+{
+  /* The followed file grew. While playing it is reopened at the end of the
+   * stream, otherwise at once. */
+  PtPlayerPrivate *priv = pt_player_get_instance_private (self);
+
+  if (duration * GST_MSECOND <= priv->dur)
+    return;
+
+  priv->dur = duration * GST_MSECOND;
+  priv->grown = TRUE;
+  if (priv->target_state < GST_STATE_PLAYING)
+    reopen_grown_file (self, FALSE);
+}
+
 /**
  * pt_player_connect_waveviewer:
  * @self: a #PtPlayer
  * @wv: a #PtWaveviewer
  *
  * Connect a #PtWaveviewer. The #PtPlayer will monitor selections made in the
- * #PtWaveviewer and act accordingly.
+ * #PtWaveviewer and act accordingly. If the #PtWaveviewer follows a growing
+ * file, the new part can be played and seeked to.
  *
  * Since: 1.6
  */
@@ -1443,6 +2073,11 @@ pt_player_connect_waveviewer (PtPlayer     *self,
                     "play-toggled",
                     G_CALLBACK (wv_play_toggled_cb),
                     self);
+
+  g_signal_connect (priv->wv,
+                    "duration-changed",
+                    G_CALLBACK (wv_duration_changed_cb),
+                    self);
 }
 
 /* --------------------- File utilities ------------------------------------- */
@@ -1683,7 +2318,7 @@ pt_player_get_current_time_string (PtPlayer       *self,
   PtPlayerPrivate *priv = pt_player_get_instance_private (self);
   gint64           time;
 
-  if (!gst_element_query_position (priv->play, GST_FORMAT_TIME, &time))
+  if (!get_tracked_position (self, &time))
     return NULL;
 
   return pt_player_get_time_string (
@@ -1856,7 +2491,7 @@ pt_player_get_timestamp (PtPlayer *self)
   gint64           time;
   gint             duration;
 
-  if (!gst_element_query_position (priv->play, GST_FORMAT_TIME, &time))
+  if (!get_tracked_position (self, &time))
     return NULL;
 
   duration = GST_TIME_AS_MSECONDS (priv->dur);
@@ -2316,6 +2951,7 @@ pt_player_dispose (GObject *object)
   PtPlayerPrivate *priv = pt_player_get_instance_private (self);
 
   remove_seek_source (self);
+  cancel_open (self);
   g_clear_signal_handler (&priv->stream_notify_id, priv->collection);
   g_clear_handle_id (&priv->vol_changed_id, g_source_remove);
   g_clear_handle_id (&priv->mute_changed_id, g_source_remove);
@@ -2325,10 +2961,11 @@ pt_player_dispose (GObject *object)
 
   if (priv->play)
     {
-      /* remember position */
-      metadata_save_position (self);
+      /* remember position, the main loop might not run again */
+      metadata_save_position (self, FALSE);
       g_clear_object (&priv->pos_mgr);
 
+      clear_open_probe (self);
       gst_element_set_state (priv->play, GST_STATE_NULL);
 
       gst_object_unref (GST_OBJECT (priv->play));
@@ -2348,6 +2985,7 @@ pt_player_finalize (GObject *object)
 
   g_mutex_clear (&priv->lock);
   g_free (priv->stream_id);
+  g_clear_pointer (&priv->pos_clock, gst_object_unref);
 
   G_OBJECT_CLASS (pt_player_parent_class)->finalize (object);
 }
@@ -2510,6 +3148,18 @@ pt_player_init (PtPlayer *self)
   priv->seek_position = GST_CLOCK_TIME_NONE;
   priv->last_seek_time = GST_CLOCK_TIME_NONE;
 
+  priv->pos_seq = 0;
+  priv->pos_valid = FALSE;
+  priv->pos_clock_time = GST_CLOCK_TIME_NONE;
+  priv->pos_rate = 1.0;
+  priv->pos_clock = NULL;
+  priv->open_task = NULL;
+  priv->open_cancel_id = 0;
+  priv->open_probe_id = 0;
+  priv->open_position = -1;
+  priv->n_seeks = 0;
+  priv->n_prerolls = 0;
+
   gst_init (NULL, NULL);
 
   /* Check if elements are already statically registered, otherwise
@@ -2585,6 +3235,26 @@ pt_player_class_init (PtPlayerClass *klass)
                 G_TYPE_NONE,
                 1, G_TYPE_ERROR);
 
+  /**
+   * PtPlayer::open-progress:
+   * @self: the player emitting the signal
+   * @progress: the progress, ranging from 0.0 to 1.0
+   *
+   * Indicates progress of pt_player_open_uri_async(), e.g. buffering of a
+   * file on a slow mount. The last signal on success is 1.0.
+   *
+   * Since: 4.3
+   */
+  g_signal_new ("open-progress",
+                PT_TYPE_PLAYER,
+                G_SIGNAL_RUN_FIRST,
+                0,
+                NULL,
+                NULL,
+                g_cclosure_marshal_VOID__DOUBLE,
+                G_TYPE_NONE,
+                1, G_TYPE_DOUBLE);
+
   /**
    * PtPlayer::play-toggled:
    * @self: the player emitting the signal
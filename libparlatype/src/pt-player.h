@@ -105,6 +105,16 @@ gboolean   pt_player_has_selection            (PtPlayer       *self);
 gboolean   pt_player_open_uri                 (PtPlayer       *self,
                                                gchar          *uri);
 
+void       pt_player_open_uri_async           (PtPlayer           *self,
+                                               gchar              *uri,
+                                               GCancellable       *cancellable,
+                                               GAsyncReadyCallback callback,
+                                               gpointer            user_data);
+
+gboolean   pt_player_open_uri_finish          (PtPlayer       *self,
+                                               GAsyncResult   *result,
+                                               GError        **error);
+
 void       pt_player_jump_relative            (PtPlayer       *self,
                                                gint            milliseconds);
 
@@ -22,9 +22,9 @@
  * to my knowledge works only with GVFS. The GVFS daemon saves custom
  * attributes in ~/.local/share/gvfs-metadata in binary format.
  *
- * The manager is a class/object although that is not necessary at the moment.
- * It doesn't have public or private attributes but this could change if other
- * backends would be supported (e.g. SQlite based).
+ * The manager is a class/object, it keeps track of positions that are still
+ * being saved with pt_position_manager_save_async(). Loading them returns
+ * the position that is being saved, not the old one.
  */
 
 #include "config.h"
@@ -38,10 +38,38 @@
 struct _PtPositionManager
 {
   GObject parent;
+
+  GHashTable *saving; /* URI → Saving */
 };
 
+/* Saves of one file in flight */
+typedef struct
+{
+  gint64 pos;
+  guint  count;
+} Saving;
+
 G_DEFINE_TYPE (PtPositionManager, pt_position_manager, G_TYPE_OBJECT)
 
+static void
+log_save_result (GError *error)
+{
+  if (error)
+    {
+      /* There are valid cases were setting attributes is not
+       * possible, e.g. in sandboxed environments, containers etc.
+       * Use G_LOG_LEVEL_INFO because other log levels go to stderr
+       * and might result in failed tests. */
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "MESSAGE",
+                        "Position not saved: %s", error->message);
+    }
+  else
+    {
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO,
+                        "MESSAGE", "Position saved");
+    }
+}
+
 /**
  * pt_position_manager_save:
  * @self: a #PtPositionManager
@@ -75,23 +103,143 @@ pt_position_manager_save (PtPositionManager *self,
       NULL,
       &error);
 
-  if (error)
+  log_save_result (error);
+  g_clear_error (&error);
+  g_object_unref (info);
+}
+
+static void
+set_attributes_cb (GFile        *file,
+                   GAsyncResult *res,
+                   GTask        *task)
+{
+  PtPositionManager *self = g_task_get_source_object (task);
+  const gchar       *uri = g_task_get_task_data (task);
+  GError            *error = NULL;
+  Saving            *saving;
+
+  g_file_set_attributes_finish (file, res, NULL, &error);
+  log_save_result (error);
+  g_clear_error (&error);
+
+  saving = g_hash_table_lookup (self->saving, uri);
+  if (--saving->count == 0)
+    g_hash_table_remove (self->saving, uri);
+
+  g_task_return_boolean (task, TRUE);
+  g_object_unref (task);
+}
+
+/**
+ * pt_position_manager_save_async:
+ * @self: a #PtPositionManager
+ * @file: #GFile holding the file
+ * @pos: position to save in milliseconds
+ *
+ * Same as pt_position_manager_save() without blocking. There is no callback,
+ * the result is logged. Until it’s saved, loading the position of @file
+ * returns @pos.
+ */
+void
+pt_position_manager_save_async (PtPositionManager *self,
+                                GFile             *file,
+                                gint64             pos)
+{
+  GFileInfo *info;
+  GTask     *task;
+  Saving    *saving;
+  gchar     *uri;
+  gchar      value[64];
+
+  if (!file)
+    return;
+
+  info = g_file_info_new ();
+  g_snprintf (value, sizeof (value), "%" G_GINT64_FORMAT, pos);
+  g_file_info_set_attribute_string (info, METADATA_POSITION, value);
+
+  uri = g_file_get_uri (file);
+  saving = g_hash_table_lookup (self->saving, uri);
+  if (!saving)
     {
-      /* There are valid cases were setting attributes is not
-       * possible, e.g. in sandboxed environments, containers etc.
-       * Use G_LOG_LEVEL_INFO because other log levels go to stderr
-       * and might result in failed tests. */
-      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "MESSAGE",
-                        "Position not saved: %s", error->message);
-      g_error_free (error);
+      saving = g_new0 (Saving, 1);
+      g_hash_table_insert (self->saving, g_strdup (uri), saving);
     }
-  else
+  saving->pos = pos;
+  saving->count++;
+
+  /* The task keeps the manager alive until the file is written */
+  task = g_task_new (self, NULL, NULL, NULL);
+  g_task_set_task_data (task, uri, g_free);
+
+  g_file_set_attributes_async (file, info,
+                               G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT,
+                               NULL,
+                               (GAsyncReadyCallback) set_attributes_cb,
+                               task);
+  g_object_unref (info);
+}
+
+static gboolean
+lookup_saving (PtPositionManager *self,
+               GFile             *file,
+               gint64            *pos)
+{
+  /* A position that is still being saved is newer than the file’s */
+
+  Saving *saving;
+  gchar  *uri;
+
+  if (g_hash_table_size (self->saving) == 0)
+    return FALSE;
+
+  uri = g_file_get_uri (file);
+  saving = g_hash_table_lookup (self->saving, uri);
+  g_free (uri);
+
+  if (!saving)
+    return FALSE;
+
+  *pos = saving->pos;
+  return TRUE;
+}
+
+static void
+log_load_error (GError *error)
+{
+  /* A missing file or a backend without metadata support is a "soft"
+   * failure, like a missing position */
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND) ||
+      g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+    return;
+
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "MESSAGE",
+                    "Metadata not retrieved: %s", error->message);
+}
+
+static gint64
+parse_position (GFileInfo *info)
+{
+  gchar *value = NULL;
+  gint64 pos = 0;
+
+  value = g_file_info_get_attribute_as_string (info, METADATA_POSITION);
+  if (value)
     {
-      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO,
-                        "MESSAGE", "Position saved");
+      pos = g_ascii_strtoull (value, NULL, 0);
+      g_free (value);
+
+      if (pos > 0)
+        {
+          g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO,
+                            "MESSAGE", "Metadata: last known "
+                                       "position %" G_GINT64_FORMAT " ms",
+                            pos);
+        }
     }
 
-  g_object_unref (info);
+  return pos;
 }
 
 /**
@@ -100,8 +248,9 @@ pt_position_manager_save (PtPositionManager *self,
  * @file: #GFile holding the file
  *
  * Tries to get the position where the given file ended the last time.
- * Success is logged at info level, "soft" failure (no position saved) is
- * not logged and other "hard" failures are logged at warning level.
+ * Success is logged at info level, "soft" failure (no position saved, file
+ * not found or no metadata support) is not logged and other "hard" failures
+ * are logged at warning level.
  *
  * Return value: Position in milliseconds or zero on failure.
  * */
@@ -111,39 +260,122 @@ pt_position_manager_load (PtPositionManager *self,
 {
   GError    *error = NULL;
   GFileInfo *info;
-  gchar     *value = NULL;
-  gint64     pos = 0;
+  gint64     pos;
 
   if (!file)
     return 0;
 
+  if (lookup_saving (self, file, &pos))
+    return pos;
+
   info = g_file_query_info (file, METADATA_POSITION,
                             G_FILE_QUERY_INFO_NONE, NULL, &error);
   if (error)
     {
-      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "MESSAGE",
-                        "Metadata not retrieved: %s", error->message);
+      log_load_error (error);
       g_error_free (error);
       return 0;
     }
 
-  value = g_file_info_get_attribute_as_string (info, METADATA_POSITION);
-  if (value)
-    {
-      pos = g_ascii_strtoull (value, NULL, 0);
-      g_free (value);
+  pos = parse_position (info);
 
-      if (pos > 0)
+  g_object_unref (info);
+  return pos;
+}
+
+static void
+query_info_cb (GFile        *file,
+               GAsyncResult *res,
+               GTask        *task)
+{
+  GError    *error = NULL;
+  GFileInfo *info;
+
+  info = g_file_query_info_finish (file, res, &error);
+  if (error)
+    {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         {
-          g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO,
-                            "MESSAGE", "Metadata: last known "
-                                       "position %" G_GINT64_FORMAT " ms",
-                            pos);
+          g_task_return_error (task, error);
+          g_object_unref (task);
+          return;
         }
+
+      log_load_error (error);
+      g_error_free (error);
+      g_task_return_int (task, 0);
+      g_object_unref (task);
+      return;
     }
 
+  g_task_return_int (task, parse_position (info));
   g_object_unref (info);
-  return pos;
+  g_object_unref (task);
+}
+
+/**
+ * pt_position_manager_load_async:
+ * @self: a #PtPositionManager
+ * @file: #GFile holding the file
+ * @cancellable: (nullable): a #GCancellable or NULL
+ * @callback: (scope async): a #GAsyncReadyCallback to call when the operation is complete
+ * @user_data: user data for @callback
+ *
+ * Same as pt_position_manager_load() without blocking, e.g. on network
+ * mounts. Get the result with pt_position_manager_load_finish().
+ */
+void
+pt_position_manager_load_async (PtPositionManager  *self,
+                                GFile              *file,
+                                GCancellable       *cancellable,
+                                GAsyncReadyCallback callback,
+                                gpointer            user_data)
+{
+  GTask *task;
+  gint64 pos;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+
+  if (!file)
+    {
+      g_task_return_int (task, 0);
+      g_object_unref (task);
+      return;
+    }
+
+  if (lookup_saving (self, file, &pos))
+    {
+      g_task_return_int (task, pos);
+      g_object_unref (task);
+      return;
+    }
+
+  g_file_query_info_async (file, METADATA_POSITION,
+                           G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT,
+                           cancellable,
+                           (GAsyncReadyCallback) query_info_cb,
+                           task);
+}
+
+/**
+ * pt_position_manager_load_finish:
+ * @self: a #PtPositionManager
+ * @result: the #GAsyncResult passed to your #GAsyncReadyCallback
+ * @error: (nullable): a pointer to a NULL #GError, or NULL
+ *
+ * Failures are logged like in pt_position_manager_load(), only
+ * cancellation is returned as an error.
+ *
+ * Return value: Position in milliseconds or zero on failure.
+ */
+gint64
+pt_position_manager_load_finish (PtPositionManager *self,
+                                 GAsyncResult      *result,
+                                 GError           **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), 0);
+
+  return g_task_propagate_int (G_TASK (result), error);
 }
 
 /* --------------------- Init and GObject management ------------------------ */
@@ -151,11 +383,23 @@ pt_position_manager_load (PtPositionManager *self,
 static void
 pt_position_manager_init (PtPositionManager *self)
 {
+  self->saving = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void
+pt_position_manager_finalize (GObject *object)
+{
+  PtPositionManager *self = PT_POSITION_MANAGER (object);
+
+  g_hash_table_destroy (self->saving);
+
+  G_OBJECT_CLASS (pt_position_manager_parent_class)->finalize (object);
 }
 
 static void
 pt_position_manager_class_init (PtPositionManagerClass *klass)
 {
+  G_OBJECT_CLASS (klass)->finalize = pt_position_manager_finalize;
 }
 
 PtPositionManager *
@@ -21,9 +21,20 @@
 #define PT_TYPE_POSITION_MANAGER (pt_position_manager_get_type ())
 G_DECLARE_FINAL_TYPE (PtPositionManager, pt_position_manager, PT, POSITION_MANAGER, GObject)
 
-void               pt_position_manager_save (PtPositionManager *self,
-                                             GFile             *file,
-                                             gint64             pos);
-gint64             pt_position_manager_load (PtPositionManager *self,
-                                             GFile             *file);
-PtPositionManager *pt_position_manager_new  (void);
+void               pt_position_manager_save        (PtPositionManager  *self,
+                                                    GFile              *file,
+                                                    gint64              pos);
+void               pt_position_manager_save_async  (PtPositionManager  *self,
+                                                    GFile              *file,
+                                                    gint64              pos);
+gint64             pt_position_manager_load        (PtPositionManager  *self,
+                                                    GFile              *file);
+void               pt_position_manager_load_async  (PtPositionManager  *self,
+                                                    GFile              *file,
+                                                    GCancellable       *cancellable,
+                                                    GAsyncReadyCallback callback,
+                                                    gpointer            user_data);
+gint64             pt_position_manager_load_finish (PtPositionManager  *self,
+                                                    GAsyncResult       *result,
+                                                    GError            **error);
+PtPositionManager *pt_position_manager_new         (void);
@@ -0,0 +1,274 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * pt-sample-store
+ * Raw samples of PtWaveloader in blocks of one second.
+ *
+ * Samples are saved in fixed blocks of PT_SAMPLE_STORE_BLOCK_SIZE samples.
+ * Appending never moves existing samples, memory grows by one block at a
+ * time. Readers get a pointer to a sample and the number of samples up to
+ * the end of its block with pt_sample_store_get_block().
+ *
+ * Blocks before a given position can be dropped to save memory, their
+ * samples are not available any more, but the length stays the same.
+ *
+ * The store is not thread-safe, but different threads can write to
+ * different blocks with pt_sample_store_write(), as long as nobody changes
+ * the length at the same time.
+ */
+
+#include "config.h"
+
+#include "pt-sample-store.h"
+
+#include <string.h>
+
+#define BLOCK_SIZE PT_SAMPLE_STORE_BLOCK_SIZE
+
+struct _PtSampleStore
+{
+  GPtrArray *blocks; /* gint16 *, NULL if dropped */
+  guint      length;
+  guint      first_live; /* blocks before are dropped */
+};
+
+/**
+ * pt_sample_store_get_length:
+ * @self: the store
+ *
+ * Return value: number of samples, including dropped ones
+ */
+guint
+pt_sample_store_get_length (PtSampleStore *self)
+{
+  return self->length;
+}
+
+/**
+ * pt_sample_store_set_length:
+ * @self: the store
+ * @length: new number of samples
+ *
+ * Cuts off samples or adds samples with value 0.
+ */
+void
+pt_sample_store_set_length (PtSampleStore *self,
+                            guint          length)
+{
+  guint   n_blocks = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  guint   used;
+  gint16 *block;
+
+  if (length < self->length)
+    {
+      g_ptr_array_set_size (self->blocks, n_blocks);
+      self->first_live = MIN (self->first_live, n_blocks);
+      self->length = length;
+      return;
+    }
+
+  /* Clear the rest of the last block, it might contain old data */
+  used = self->length % BLOCK_SIZE;
+  if (used > 0)
+    {
+      block = g_ptr_array_index (self->blocks, self->blocks->len - 1);
+      if (block)
+        memset (block + used, 0, (BLOCK_SIZE - used) * sizeof (gint16));
+    }
+
+  while (self->blocks->len < n_blocks)
+    g_ptr_array_add (self->blocks, g_new0 (gint16, BLOCK_SIZE));
+
+  self->length = length;
+}
+
+/**
+ * pt_sample_store_append:
+ * @self: the store
+ * @samples: samples to append
+ * @n_samples: number of samples
+ *
+ * Appends samples, filling up the last block first.
+ */
+void
+pt_sample_store_append (PtSampleStore *self,
+                        const gint16  *samples,
+                        guint          n_samples)
+{
+  gint16 *block;
+  guint   used;
+  guint   n;
+
+  while (n_samples > 0)
+    {
+      used = self->length % BLOCK_SIZE;
+      if (used == 0)
+        g_ptr_array_add (self->blocks, g_new (gint16, BLOCK_SIZE));
+
+      /* The incomplete last block might have been dropped */
+      block = g_ptr_array_index (self->blocks, self->blocks->len - 1);
+      if (!block)
+        {
+          block = g_new0 (gint16, BLOCK_SIZE);
+          g_ptr_array_index (self->blocks, self->blocks->len - 1) = block;
+          self->first_live = MIN (self->first_live, self->blocks->len - 1);
+        }
+
+      n = MIN (n_samples, BLOCK_SIZE - used);
+      memcpy (block + used, samples, n * sizeof (gint16));
+
+      self->length += n;
+      samples += n;
+      n_samples -= n;
+    }
+}
+
+/**
+ * pt_sample_store_write:
+ * @self: the store
+ * @position: index of the first sample to overwrite
+ * @samples: new samples
+ * @n_samples: number of samples
+ *
+ * Overwrites existing samples, they must not be dropped.
+ */
+void
+pt_sample_store_write (PtSampleStore *self,
+                       guint          position,
+                       const gint16  *samples,
+                       guint          n_samples)
+{
+  gint16 *block;
+  guint   offset;
+  guint   n;
+
+  g_return_if_fail (position + n_samples <= self->length);
+
+  while (n_samples > 0)
+    {
+      block = g_ptr_array_index (self->blocks, position / BLOCK_SIZE);
+      g_return_if_fail (block != NULL);
+
+      offset = position % BLOCK_SIZE;
+      n = MIN (n_samples, BLOCK_SIZE - offset);
+      memcpy (block + offset, samples, n * sizeof (gint16));
+
+      position += n;
+      samples += n;
+      n_samples -= n;
+    }
+}
+
+/**
+ * pt_sample_store_get_block:
+ * @self: the store
+ * @position: index of a sample
+ * @n_samples: (out): number of samples from @position to the end of its
+ * block or the end of the store
+ *
+ * Return value: pointer to the sample at @position, NULL if it was dropped
+ * or @position is after the last sample
+ */
+const gint16 *
+pt_sample_store_get_block (PtSampleStore *self,
+                           guint          position,
+                           guint         *n_samples)
+{
+  gint16 *block;
+  guint   offset;
+
+  *n_samples = 0;
+  if (position >= self->length)
+    return NULL;
+
+  block = g_ptr_array_index (self->blocks, position / BLOCK_SIZE);
+  if (!block)
+    return NULL;
+
+  offset = position % BLOCK_SIZE;
+  *n_samples = MIN (BLOCK_SIZE - offset, self->length - position);
+  return block + offset;
+}
+
+/**
+ * pt_sample_store_drop:
+ * @self: the store
+ * @end: index after the last sample that is not needed any more
+ *
+ * Frees all blocks that end before @end. Blocks that were dropped before
+ * are skipped, in bounded mode this is called for every second of new data.
+ */
+void
+pt_sample_store_drop (PtSampleStore *self,
+                      guint          end)
+{
+  guint n_blocks = MIN (end, self->length) / BLOCK_SIZE;
+
+  /* The last block can be dropped if it’s incomplete */
+  if (end >= self->length)
+    n_blocks = self->blocks->len;
+
+  for (guint i = self->first_live; i < n_blocks; i++)
+    g_clear_pointer (&self->blocks->pdata[i], g_free);
+
+  self->first_live = MAX (self->first_live, n_blocks);
+}
+
+/**
+ * pt_sample_store_get_size:
+ * @self: the store
+ *
+ * Return value: memory used by the store in bytes
+ */
+gsize
+pt_sample_store_get_size (PtSampleStore *self)
+{
+  gsize size = sizeof (PtSampleStore) + self->blocks->len * sizeof (gpointer);
+
+  for (guint i = self->first_live; i < self->blocks->len; i++)
+    {
+      if (g_ptr_array_index (self->blocks, i))
+        size += BLOCK_SIZE * sizeof (gint16);
+    }
+
+  return size;
+}
+
+void
+pt_sample_store_clear (PtSampleStore *self)
+{
+  g_ptr_array_set_size (self->blocks, 0);
+  self->length = 0;
+  self->first_live = 0;
+}
+
+void
+pt_sample_store_free (PtSampleStore *self)
+{
+  g_ptr_array_unref (self->blocks);
+  g_free (self);
+}
+
+PtSampleStore *
+pt_sample_store_new (void)
+{
+  PtSampleStore *self = g_new0 (PtSampleStore, 1);
+
+  self->blocks = g_ptr_array_new_with_free_func (g_free);
+
+  return self;
+}
@@ -0,0 +1,44 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+/* One second at 8000 samples per second */
+#define PT_SAMPLE_STORE_BLOCK_SIZE 8000
+
+typedef struct _PtSampleStore PtSampleStore;
+
+PtSampleStore *pt_sample_store_new        (void);
+void           pt_sample_store_free       (PtSampleStore *self);
+void           pt_sample_store_clear      (PtSampleStore *self);
+guint          pt_sample_store_get_length (PtSampleStore *self);
+void           pt_sample_store_set_length (PtSampleStore *self,
+                                           guint          length);
+void           pt_sample_store_append     (PtSampleStore *self,
+                                           const gint16  *samples,
+                                           guint          n_samples);
+void           pt_sample_store_write      (PtSampleStore *self,
+                                           guint          position,
+                                           const gint16  *samples,
+                                           guint          n_samples);
+const gint16  *pt_sample_store_get_block  (PtSampleStore *self,
+                                           guint          position,
+                                           guint         *n_samples);
+void           pt_sample_store_drop       (PtSampleStore *self,
+                                           guint          end);
+gsize          pt_sample_store_get_size   (PtSampleStore *self);
@@ -32,8 +32,16 @@
 #include "config.h"
 
 #include "pt-waveloader.h"
+#include "pt-waveloader-private.h"
 
 #include "pt-i18n.h"
+#include "pt-marshalers.h"
+#include "pt-peak-cache.h"
+#include "pt-peak-kernel.h"
+#include "pt-peak-pyramid.h"
+#include "pt-peak-store.h"
+#include "pt-pcm-file.h"
+#include "pt-sample-store.h"
 
 #include <gio/gio.h>
 #include <glib/gi18n-lib.h>
@@ -41,32 +49,118 @@
 #include <gst/audio/audio.h>
 #include <gst/gst.h>
 
+/* Default maximum size of all peak cache files */
+#define CACHE_MAX_SIZE (G_GUINT64_CONSTANT (1) << 30)
+
+/* Maximum number of idle loaders in the pool */
+#define POOL_SIZE 2
+
+/* Minimum length of a segment in parallel mode */
+#define SEGMENT_MIN_SECONDS 10
+
+/* Min/max pairs computed at once in the background of a progressive
+ * resize */
+#define RESIZE_CHUNK_SIZE 4096
+
+typedef struct _ParallelLoad ParallelLoad;
+typedef struct _PcmLoad      PcmLoad;
+typedef struct _ResizeLoad   ResizeLoad;
+
+/* Peaks of one second, handed over from the streaming thread */
+typedef struct
+{
+  uint    index; /* position in lowres */
+  GArray *peaks;
+} PeakChunk;
+
+/* Peaks at 8000 Hz from mono frames at any rate, S16 or F32. Each output
+ * sample takes the minimum or the maximum of the frames it covers: the one
+ * further away from the previous output sample. That way oscillations
+ * faster than 4000 Hz keep both their positive and negative peaks, instead
+ * of being filtered out by resampling. Below 8000 Hz frames are repeated.
+ * Output sample k covers the frames from k × rate / 8000 on. */
+
+typedef struct
+{
+  guint    rate;
+  gboolean is_float;
+  guint64  frame;   /* index of the next input frame */
+  guint64  sample;  /* index of the next output sample */
+  gboolean pending; /* some frames of the next output sample were read */
+  gint16   min;
+  gint16   max;
+  gint16   held;    /* last input frame */
+  gint16   last;    /* last output sample */
+  GArray  *out;
+} Decimator;
+
 typedef struct _PtWaveloaderPrivate PtWaveloaderPrivate;
 struct _PtWaveloaderPrivate
 {
   GstElement *pipeline;
-  GstElement *fmt;
 
-  GArray *hires;
-  uint    hires_index;
-  GArray *lowres;
-  int     pps;
-  uint    lowres_index;
+  PtSampleStore *hires;
+  uint           hires_index;
+  PtPeakPyramid *pyramid;
+  GArray        *lowres;
+  int            pps;
+  uint           lowres_index;
+  GAsyncQueue   *chunks;
+
+  PtPeakData *data; /* owns hires and pyramid */
+  gboolean    data_owner;
+  gboolean    shared;
+
+  gboolean pooled; /* acquired from the pool, may return to it */
 
   gchar   *uri;
   gboolean load_pending;
   gboolean data_pending;
 
+  ResizeLoad *resize;
+  gint        resize_threads; /* including superseded ones */
+  GSource    *resize_timeout;
+
   gint64 duration;
 
-  guint   bus_watch_id;
-  guint   progress_timeout;
-  gdouble progress;
+  gboolean     use_cache;
+  guint64      cache_max_size;
+  PtPeakCache *cache;
+
+  gint          n_segments;
+  ParallelLoad *parallel;
+  PcmLoad      *pcm;
+
+  gboolean bounded;
+  gboolean quantize;
+
+  Decimator decimator;
+  gboolean  resample; /* use audioresample, for comparison */
+
+  gboolean      follow;
+  GFileMonitor *monitor;
+  GThread      *follow_thread;
+  GCancellable *follow_cancel;
+  GMutex        follow_lock;  /* hires and pyramid while the thread runs */
+  gint          follow_done;  /* atomic */
+  gboolean      follow_again; /* the file changed during an update */
+  GSource      *follow_timeout;
+
+  GSource *bus_watch;
+  GSource *progress_timeout;
+  gdouble  progress;
 };
 
 enum
 {
   PROP_URI = 1,
+  PROP_CACHE,
+  PROP_CACHE_MAX_SIZE,
+  PROP_SEGMENTS,
+  PROP_BOUNDED_MEMORY,
+  PROP_QUANTIZE_PEAKS,
+  PROP_FOLLOW,
+  PROP_SHARED,
   N_PROPERTIES
 };
 
@@ -74,14 +168,62 @@ enum
 {
   PROGRESS,
   ARRAY_SIZE_CHANGED,
+  DATA_AVAILABLE,
+  DURATION_CHANGED,
   LAST_SIGNAL
 };
 
 static GParamSpec *obj_properties[N_PROPERTIES];
 static guint       signals[LAST_SIGNAL] = { 0 };
 
+/* Min/max kernel, chosen in class_init() */
+static PtPeakKernelFunc min_max;
+
 G_DEFINE_TYPE_WITH_PRIVATE (PtWaveloader, pt_waveloader, G_TYPE_OBJECT)
 
+static GSource *
+timeout_add (guint       interval,
+             GSourceFunc func,
+             gpointer    data)
+{
+  /* Like g_timeout_add(), but attaches to the thread-default main context
+   * like GTask callbacks, so that progress is reported in threads with their
+   * own context, too. Returns the source, IDs are only unique per context. */
+
+  GSource *source;
+
+  source = g_timeout_source_new (interval);
+  g_source_set_callback (source, func, data, NULL);
+  g_source_attach (source, g_main_context_get_thread_default ());
+
+  return source;
+}
+
+static GSource *
+bus_watch_add (GstBus    *bus,
+               GstBusFunc func,
+               gpointer   data)
+{
+  /* Like gst_bus_add_watch(), but returns the source */
+
+  GSource *source;
+
+  source = gst_bus_create_watch (bus);
+  g_source_set_callback (source, (GSourceFunc) func, data, NULL);
+  g_source_attach (source, g_main_context_get_thread_default ());
+
+  return source;
+}
+
+static void
+source_remove (GSource *source)
+{
+  /* Removes a source added with timeout_add() or bus_watch_add() */
+
+  g_source_destroy (source);
+  g_source_unref (source);
+}
+
 static void
 on_wave_loader_new_pad (GstElement *bin,
                         GstPad     *pad,
@@ -93,6 +235,38 @@ on_wave_loader_new_pad (GstElement *bin,
     }
 }
 
+static void
+drop_samples (PtWaveloader *self)
+{
+  /* In bounded mode, drop samples that are converted and added to the
+   * pyramid */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  if (!priv->bounded)
+    return;
+
+  pt_sample_store_drop (priv->hires,
+                        MIN (priv->hires_index,
+                             pt_peak_pyramid_get_end (priv->pyramid)));
+}
+
+static void
+finish_samples (PtWaveloader *self)
+{
+  /* In bounded mode, add the last incomplete block to the pyramid and drop
+   * all samples */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  if (!priv->bounded)
+    return;
+
+  pt_peak_pyramid_finish (priv->pyramid, priv->hires,
+                          pt_sample_store_get_length (priv->hires));
+  pt_sample_store_drop (priv->hires, pt_sample_store_get_length (priv->hires));
+}
+
 static gint
 calc_lowres_len (gint hires_len,
                  gint pps)
@@ -134,66 +308,340 @@ calc_lowres_len (gint hires_len,
 }
 
 static void
-convert_one_second (GArray *in,
-                    GArray *out,
-                    uint   *index_in,
-                    uint   *index_out,
-                    int     pps)
+convert_one_second (PtSampleStore *in,
+                    GArray        *out,
+                    uint          *index_in,
+                    uint          *index_out,
+                    int            pps)
 {
   g_return_if_fail (in != NULL);
   g_return_if_fail (out != NULL);
 
-  gint   k, m;
-  gint16 d;
-  gfloat vmin, vmax;
-  gint   chunk_size;
-  gint   mod;
+  const gint16 *samples;
+  uint          n_samples;
+  uint          i = 0;
+  gint          k;
+  uint          n;
+  gint16        dmin, dmax;
+  gfloat        vmin, vmax;
+  gint          chunk_size;
+  gint          mod;
 
   chunk_size = 8000 / pps;
   mod = 8000 % pps;
 
   gint correct;
-  if (*index_in >= in->len)
+
+  /* A second starts at a block of the store, all its samples are in that
+   * block */
+  g_return_if_fail (*index_in % PT_SAMPLE_STORE_BLOCK_SIZE == 0);
+  samples = pt_sample_store_get_block (in, *index_in, &n_samples);
+  if (!samples)
     return;
 
   /* Loop data worth 1 second */
   for (k = 0; k < pps; k++)
     {
-      vmin = 0;
-      vmax = 0;
       /* If there is a remainder for in_rate/out_rate, correct
        * it by reading in an additional sample. So the first n min/max
        * pairs will use an additional sample, where n is the remainder. */
       correct = 0;
       if (k < mod)
         correct = 1;
-      for (m = 0; m < (chunk_size + correct); m++)
-        {
-          /* Get highest and lowest value */
-          d = g_array_index (in, gint16, *index_in);
-          if (d < vmin)
-            vmin = d;
-          if (d > vmax)
-            vmax = d;
-          *index_in += 1;
-          if (*index_in == in->len)
-            break;
-        }
-      /* Always include 0, looks better at higher resolutions */
-      if (vmin > 0 && vmax > 0)
-        vmin = 0;
-      else if (vmin < 0 && vmax < 0)
-        vmax = 0;
+      n = MIN ((uint) (chunk_size + correct), n_samples - i);
+
+      /* Get highest and lowest value,
+       * always include 0, looks better at higher resolutions */
+      dmin = 0;
+      dmax = 0;
+      min_max (samples + i, n, &dmin, &dmax);
+      i += n;
+
       /* Save as a float in the range 0 to 1 */
+      vmin = dmin;
+      vmax = dmax;
       vmin = vmin / 32768.0;
       vmax = vmax / 32768.0;
       memcpy (out->data + *index_out * sizeof (float), &vmin, sizeof (float));
       *index_out += 1;
       memcpy (out->data + *index_out * sizeof (float), &vmax, sizeof (float));
       *index_out += 1;
-      if (*index_in == in->len)
+      if (i == n_samples)
         break;
     }
+
+  *index_in += i;
+}
+
+static gboolean
+convert_from_pyramid (PtPeakPyramid *pyramid,
+                      PtSampleStore *samples,
+                      uint           n_samples,
+                      float         *out,
+                      int            pps,
+                      uint           first,
+                      uint           last,
+                      GCancellable  *cancellable)
+{
+  /* Same as convert_one_second() for the min/max pairs @first to @last
+   * (exclusive), but gets the minimum and maximum of each chunk from the
+   * pyramid. The cost depends on the number of pairs, not on the number of
+   * samples. Without @samples the pyramid must be compact. */
+
+  gint   chunk_size = 8000 / pps;
+  gint   mod = 8000 % pps;
+  uint   start;
+  uint   end;
+  uint   index_out = 0;
+  gint16 dmin, dmax;
+  gfloat vmin, vmax;
+  gint   k;
+
+  /* First sample of pair @first, the first @mod pairs of each second have
+   * one more sample */
+  k = first % pps;
+  start = first / pps * 8000 + k * chunk_size + MIN (k, mod);
+
+  for (uint i = first; i < last && start < n_samples; i++)
+    {
+      if (k == 0 && g_cancellable_is_cancelled (cancellable))
+        return FALSE;
+
+      end = MIN (start + chunk_size + (k < mod ? 1 : 0), n_samples);
+
+      /* Always include 0, looks better at higher resolutions */
+      dmin = 0;
+      dmax = 0;
+      pt_peak_pyramid_get_range (pyramid, samples, start, end, &dmin, &dmax);
+
+      /* Save as a float in the range 0 to 1 */
+      vmin = dmin;
+      vmax = dmax;
+      vmin = vmin / 32768.0;
+      vmax = vmax / 32768.0;
+      out[index_out++] = vmin;
+      out[index_out++] = vmax;
+      start = end;
+
+      if (++k == pps)
+        k = 0;
+    }
+
+  return TRUE;
+}
+
+static gint16
+float_to_s16 (gfloat value)
+{
+  value *= 32768.0f;
+  if (value >= 32767.0f)
+    return 32767;
+  if (value <= -32768.0f)
+    return -32768;
+  return (gint) value;
+}
+
+static void
+min_max_float (const gfloat *in,
+               guint         n,
+               gint16       *min,
+               gint16       *max)
+{
+  gfloat fmin = in[0];
+  gfloat fmax = in[0];
+
+  for (guint i = 1; i < n; i++)
+    {
+      fmin = MIN (fmin, in[i]);
+      fmax = MAX (fmax, in[i]);
+    }
+
+  *min = MIN (*min, float_to_s16 (fmin));
+  *max = MAX (*max, float_to_s16 (fmax));
+}
+
+static void
+decimator_start (Decimator *d,
+                 guint      rate,
+                 gboolean   is_float,
+                 guint64    frame)
+{
+  /* Starts at @frame, the first output sample is the first one that
+   * doesn’t cover earlier frames */
+
+  d->rate = rate;
+  d->is_float = is_float;
+  d->frame = frame;
+  d->sample = gst_util_uint64_scale_ceil (frame, 8000, rate);
+  d->pending = FALSE;
+  d->min = G_MAXINT16;
+  d->max = G_MININT16;
+  d->last = 0;
+  if (!d->out)
+    d->out = g_array_new (FALSE, FALSE, sizeof (gint16));
+}
+
+static void
+decimator_clear (Decimator *d)
+{
+  g_clear_pointer (&d->out, g_array_unref);
+}
+
+static void
+decimator_emit (Decimator *d,
+                gint16     min,
+                gint16     max,
+                guint     *n_out)
+{
+  d->last = (max - d->last >= d->last - min) ? max : min;
+  g_array_index (d->out, gint16, (*n_out)++) = d->last;
+  d->sample++;
+  d->pending = FALSE;
+  d->min = G_MAXINT16;
+  d->max = G_MININT16;
+}
+
+static const gint16 *
+decimator_process (Decimator    *d,
+                   gconstpointer frames,
+                   guint         n_frames,
+                   guint        *n_out)
+{
+  /* Returns output samples, valid until the next call */
+
+  const gint16 *s16 = frames;
+  const gfloat *f32 = frames;
+  guint64       a, b;
+  guint         i = 0;
+  guint         n;
+
+  *n_out = 0;
+  g_array_set_size (d->out, gst_util_uint64_scale_ceil (n_frames + 1, 8000, d->rate) + 1);
+
+  while (i < n_frames)
+    {
+      a = gst_util_uint64_scale (d->sample, d->rate, 8000);
+
+      /* Below 8000 Hz: the same frame as before */
+      if (a < d->frame && !d->pending)
+        {
+          decimator_emit (d, d->held, d->held, n_out);
+          continue;
+        }
+
+      /* After a start or a gap: frames before the first output sample */
+      if (a > d->frame)
+        {
+          n = MIN (a - d->frame, n_frames - i);
+          i += n;
+          d->frame += n;
+          continue;
+        }
+
+      b = MAX (gst_util_uint64_scale (d->sample + 1, d->rate, 8000), a + 1);
+      n = MIN (b - d->frame, n_frames - i);
+      if (d->is_float)
+        {
+          min_max_float (f32 + i, n, &d->min, &d->max);
+          d->held = float_to_s16 (f32[i + n - 1]);
+        }
+      else
+        {
+          min_max (s16 + i, n, &d->min, &d->max);
+          d->held = s16[i + n - 1];
+        }
+      d->pending = TRUE;
+      i += n;
+      d->frame += n;
+
+      if (d->frame == b)
+        decimator_emit (d, d->min, d->max, n_out);
+    }
+
+  return (const gint16 *) d->out->data;
+}
+
+static const gint16 *
+decimator_flush (Decimator *d,
+                 guint     *n_out)
+{
+  /* Returns the output samples that cover the last frames */
+
+  *n_out = 0;
+  g_array_set_size (d->out, gst_util_uint64_scale_ceil (1, 8000, d->rate) + 1);
+
+  if (d->pending)
+    decimator_emit (d, d->min, d->max, n_out);
+
+  while (d->frame > 0 && gst_util_uint64_scale (d->sample, d->rate, 8000) < d->frame)
+    decimator_emit (d, d->held, d->held, n_out);
+
+  return (const gint16 *) d->out->data;
+}
+
+static gboolean
+decimator_set_caps (Decimator *d,
+                    GstCaps   *caps)
+{
+  /* Takes the format of the first buffer, a new rate starts at the current
+   * output sample */
+
+  GstAudioInfo info;
+  gboolean     is_float;
+
+  if (!caps || !gst_audio_info_from_caps (&info, caps))
+    return FALSE;
+
+  is_float = GST_AUDIO_INFO_FORMAT (&info) == GST_AUDIO_FORMAT_F32;
+  if (!is_float && GST_AUDIO_INFO_FORMAT (&info) != GST_AUDIO_FORMAT_S16)
+    return FALSE;
+
+  if (d->rate != (guint) GST_AUDIO_INFO_RATE (&info))
+    {
+      guint64 sample = d->sample;
+      decimator_start (d, GST_AUDIO_INFO_RATE (&info), is_float,
+                       gst_util_uint64_scale (sample, GST_AUDIO_INFO_RATE (&info), 8000));
+      d->sample = sample;
+    }
+  d->is_float = is_float;
+
+  return TRUE;
+}
+
+static void
+add_samples (PtWaveloader *self,
+             const gint16 *samples,
+             guint         n_samples)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  pt_sample_store_append (priv->hires, samples, n_samples);
+  pt_peak_pyramid_update (priv->pyramid, priv->hires,
+                          pt_sample_store_get_length (priv->hires));
+
+  /* If hires has more than one second of new data available, convert it
+   * and hand it over to the main thread. This runs in the streaming thread,
+   * lowres belongs to the main thread and is not touched here. The very
+   * last data will be added by convert_remaining(). */
+  gint       pps = priv->pps;
+  PeakChunk *chunk;
+  uint       index_out;
+  while (pt_sample_store_get_length (priv->hires) - priv->hires_index >= 8000)
+    {
+      index_out = 0;
+      chunk = g_new (PeakChunk, 1);
+      chunk->index = priv->lowres_index;
+      chunk->peaks = g_array_sized_new (FALSE, FALSE, sizeof (float), pps * 2);
+      g_array_set_size (chunk->peaks, pps * 2);
+      convert_one_second (priv->hires,
+                          chunk->peaks,
+                          &priv->hires_index,
+                          &index_out,
+                          pps);
+      priv->lowres_index += index_out;
+      g_async_queue_push (priv->chunks, chunk);
+      drop_samples (self);
+    }
 }
 
 static GstFlowReturn
@@ -202,132 +650,469 @@ new_sample_cb (GstAppSink *sink,
 {
   PtWaveloader        *self = PT_WAVELOADER (user_data);
   PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  Decimator           *d = &priv->decimator;
   GstSample           *sample = gst_app_sink_pull_sample (sink);
   GstBuffer           *buffer = gst_sample_get_buffer (sample);
   GstMapInfo           map;
-  if (!gst_buffer_map (buffer, &map, GST_MAP_READ))
+  const gint16        *out;
+  guint                n_out;
+
+  if (!decimator_set_caps (d, gst_sample_get_caps (sample))
+      || !gst_buffer_map (buffer, &map, GST_MAP_READ))
     {
       gst_sample_unref (sample);
       return GST_FLOW_ERROR;
-    };
-  /* One sample is 2 bytes (16 bit signed integer), see caps in
-   * setup_pipeline(). The buffer contains several samples, the number
-   * of elements/samples is map.size / sample size. */
-  g_array_append_vals (priv->hires, map.data, map.size / 2);
+    }
+
+  /* One frame is 2 bytes (S16) or 4 bytes (F32), see caps in
+   * create_pipeline(). The buffer contains several frames, the number
+   * of frames is map.size / frame size. */
+  out = decimator_process (d, map.data, map.size / (d->is_float ? 4 : 2), &n_out);
+  add_samples (self, out, n_out);
   gst_buffer_unmap (buffer, &map);
   gst_sample_unref (sample);
 
-  /* If hires has more than one second of new data available, add it to
-   * lowres. The very last data will be added at the EOS signal. */
-  gint pps = priv->pps;
-  if (priv->hires->len - priv->hires_index >= 8000)
+  return GST_FLOW_OK;
+}
+
+static void
+peak_chunk_free (gpointer data)
+{
+  PeakChunk *chunk = data;
+
+  g_array_unref (chunk->peaks);
+  g_free (chunk);
+}
+
+static void
+publish_chunks (PtWaveloader *self,
+                GAsyncQueue  *chunks)
+{
+  /* Copy all peaks from a worker thread to lowres, in the main thread.
+   * The range of new data is announced with one signal. */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  PeakChunk           *chunk;
+  uint                 start = G_MAXUINT;
+  uint                 end = 0;
+  uint                 chunk_end;
+  gboolean             resized = FALSE;
+
+  while ((chunk = g_async_queue_try_pop (chunks)))
     {
       /* Make sure lowres is big enough */
-      if (priv->lowres_index + pps * 2 + 1 > priv->lowres->len)
+      chunk_end = chunk->index + chunk->peaks->len;
+      if (chunk_end > priv->lowres->len)
         {
-          g_array_set_size (priv->lowres, priv->lowres_index + pps * 2 + 2);
+          g_array_set_size (priv->lowres, chunk_end);
           g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
-                            "MESSAGE", "lowres->len resized in new_sample_cb: %d",
-                            priv->lowres_index + pps * 2 + 2);
+                            "MESSAGE", "lowres->len resized in publish_peaks: %d",
+                            chunk_end);
+          resized = TRUE;
         }
+
+      memcpy (&g_array_index (priv->lowres, float, chunk->index),
+              chunk->peaks->data,
+              chunk->peaks->len * sizeof (float));
+      start = MIN (start, chunk->index);
+      end = MAX (end, chunk_end);
+      peak_chunk_free (chunk);
+    }
+
+  if (resized)
+    g_signal_emit_by_name (self, "array-size-changed");
+  if (start < end)
+    g_signal_emit (self, signals[DATA_AVAILABLE], 0, start, end);
+}
+
+static void
+publish_peaks (PtWaveloader *self)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  publish_chunks (self, priv->chunks);
+}
+
+static void
+convert_remaining (PtWaveloader *self)
+{
+  /* The producer is done, take over its peaks and convert remaining data
+   * from hires to lowres */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  uint                 start;
+
+  publish_peaks (self);
+  start = priv->lowres_index;
+  g_array_set_size (priv->lowres, calc_lowres_len (pt_sample_store_get_length (priv->hires), priv->pps));
+
+  /* while hires has more full seconds than lowres ... */
+  while (pt_sample_store_get_length (priv->hires) > priv->hires_index)
+    {
       convert_one_second (priv->hires,
                           priv->lowres,
                           &priv->hires_index,
                           &priv->lowres_index,
-                          pps);
+                          priv->pps);
     }
 
-  return GST_FLOW_OK;
+  if (start < priv->lowres->len)
+    g_signal_emit (self, signals[DATA_AVAILABLE], 0, start, priv->lowres->len);
 }
 
-static gboolean
-setup_pipeline (PtWaveloader *self)
+static void
+discard_peaks (PtWaveloader *self)
 {
   PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
-  gboolean             result = TRUE;
-  GstElement          *src, *dec, *conv, *resample, *sink;
-  GstCaps             *caps;
+  PeakChunk           *chunk;
+
+  while ((chunk = g_async_queue_try_pop (priv->chunks)))
+    peak_chunk_free (chunk);
+}
+
+static GstElement *
+create_pipeline (const gchar *uri,
+                 gboolean     resample,
+                 GstElement **sink)
+{
+  /* By default the decoder’s rate is kept and its format, if it is F32 or
+   * S16. Channels are mixed down. A Decimator takes the peaks at 8000 Hz,
+   * that’s much cheaper than resampling. With @resample the old pipeline
+   * is used: audioresample converts to S16 at 8000 Hz. */
+
+  GstElement *pipeline;
+  GstElement *src, *dec, *conv, *fmt;
+  GstElement *res = NULL;
+  GstCaps    *caps;
+  gboolean    linked;
 
-  /* create loader pipeline TODO: this is probably leaking on 2nd run */
-  priv->pipeline = gst_pipeline_new ("wave-loader");
+  pipeline = gst_pipeline_new ("wave-loader");
 
   /* TODO gst_element_make_from_uri(): The URI must be gst_uri_is_valid(). */
-  src = gst_element_make_from_uri (GST_URI_SRC, priv->uri, NULL, NULL);
-  dec = gst_element_factory_make ("decodebin", NULL);
+  src = gst_element_make_from_uri (GST_URI_SRC, uri, "src", NULL);
+  dec = gst_element_factory_make ("decodebin", "dec");
   conv = gst_element_factory_make ("audioconvert", NULL);
-  resample = gst_element_factory_make ("audioresample", NULL);
-  priv->fmt = gst_element_factory_make ("capsfilter", NULL);
-  sink = gst_element_factory_make ("appsink", NULL);
+  fmt = gst_element_factory_make ("capsfilter", NULL);
+  *sink = gst_element_factory_make ("appsink", NULL);
 
   /* configure elements */
-  caps = gst_caps_new_simple ("audio/x-raw",
-                              "format", G_TYPE_STRING, GST_AUDIO_NE (S16),
-                              "layout", G_TYPE_STRING, "interleaved",
-                              "channels", G_TYPE_INT, 1,
-                              "rate", G_TYPE_INT, 8000, NULL);
+  if (resample)
+    {
+      res = gst_element_factory_make ("audioresample", NULL);
+      caps = gst_caps_new_simple ("audio/x-raw",
+                                  "format", G_TYPE_STRING, GST_AUDIO_NE (S16),
+                                  "layout", G_TYPE_STRING, "interleaved",
+                                  "channels", G_TYPE_INT, 1,
+                                  "rate", G_TYPE_INT, 8000, NULL);
+    }
+  else
+    {
+      caps = gst_caps_from_string ("audio/x-raw, "
+                                   "format = (string) { " GST_AUDIO_NE (F32) ", " GST_AUDIO_NE (S16) " }, "
+                                   "layout = (string) interleaved, "
+                                   "channels = (int) 1");
+    }
 
-  g_object_set (priv->fmt, "caps", caps, NULL);
+  g_object_set (fmt, "caps", caps, NULL);
   gst_caps_unref (caps);
 
-  g_object_set (sink, "emit-signals", TRUE, "sync", FALSE, NULL);
+  g_object_set (*sink, "sync", FALSE, NULL);
 
   /* add and link */
-  gst_bin_add_many (GST_BIN (priv->pipeline), src, dec, conv, resample, priv->fmt, sink, NULL);
-  result = gst_element_link (src, dec);
-  if (!result)
+  gst_bin_add_many (GST_BIN (pipeline), src, dec, conv, fmt, *sink, NULL);
+  if (!gst_element_link (src, dec))
+    {
+      GST_WARNING_OBJECT (pipeline,
+                          "Can’t link wave loader pipeline (src ! dec ! conv ! fmt ! sink).");
+      gst_object_unref (pipeline);
+      return NULL;
+    }
+
+  if (res)
+    {
+      gst_bin_add (GST_BIN (pipeline), res);
+      linked = gst_element_link_many (conv, res, fmt, *sink, NULL);
+    }
+  else
     {
-      GST_WARNING_OBJECT (priv->pipeline,
-                          "Can’t link wave loader pipeline (src ! dec ! conv ! resample ! fmt ! sink).");
-      return result;
+      linked = gst_element_link_many (conv, fmt, *sink, NULL);
     }
 
-  result = gst_element_link_many (conv, resample, priv->fmt, sink, NULL);
-  if (!result)
+  if (!linked)
     {
-      GST_WARNING_OBJECT (priv->pipeline,
-                          "Can’t link wave loader pipeline (conv ! resample ! fmt ! sink).");
-      return result;
+      GST_WARNING_OBJECT (pipeline,
+                          "Can’t link wave loader pipeline (conv ! fmt ! sink).");
+      gst_object_unref (pipeline);
+      return NULL;
     }
 
   g_signal_connect (dec, "pad-added", G_CALLBACK (on_wave_loader_new_pad),
                     (gpointer) conv);
-  g_signal_connect (sink, "new-sample", G_CALLBACK (new_sample_cb), self);
+
+  return pipeline;
+}
+
+static gboolean
+set_pipeline_uri (GstElement  *pipeline,
+                  const gchar *uri)
+{
+  /* The pipeline must be in READY or NULL state. If the source element
+   * can’t handle the new URI, e.g. because of another protocol, it’s
+   * replaced. */
+
+  GstElement *src;
+  GstElement *dec;
+  gboolean    result;
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  if (src)
+    {
+      if (gst_uri_handler_set_uri (GST_URI_HANDLER (src), uri, NULL))
+        {
+          gst_object_unref (src);
+          return TRUE;
+        }
+
+      gst_element_set_state (src, GST_STATE_NULL);
+      gst_bin_remove (GST_BIN (pipeline), src);
+      gst_object_unref (src);
+    }
+
+  src = gst_element_make_from_uri (GST_URI_SRC, uri, "src", NULL);
+  if (!src)
+    return FALSE;
+
+  gst_bin_add (GST_BIN (pipeline), src);
+  dec = gst_bin_get_by_name (GST_BIN (pipeline), "dec");
+  result = gst_element_link (src, dec);
+  gst_object_unref (dec);
 
   return result;
 }
 
 static gboolean
-check_progress (GTask *task)
+setup_pipeline (PtWaveloader *self)
 {
-  /* This timeout runs parallel to message bus (bus_handler()).
-     If it’s removed, the message bus has to be removed, too, and also
-     the other way round. */
+  /* The pipeline is created on the first load. Later it’s reused: it was
+   * reset to READY at the end of the last load and gets the new URI. */
 
-  PtWaveloader        *self = g_task_get_source_object (task);
   PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  GstElement          *sink;
+  GstBus              *bus;
 
-  gint64  dur;
-  gint64  pos;
-  gdouble temp;
-  uint    new_size;
+  if (priv->pipeline)
+    {
+      gst_element_set_state (priv->pipeline, GST_STATE_READY);
 
-  /* Check if task was cancelled and reset pipeline */
+      /* Drop messages from the last run */
+      bus = gst_pipeline_get_bus (GST_PIPELINE (priv->pipeline));
+      gst_bus_set_flushing (bus, TRUE);
+      gst_bus_set_flushing (bus, FALSE);
+      gst_object_unref (bus);
 
-  if (g_cancellable_is_cancelled (g_task_get_cancellable (task)))
-    {
-      gst_element_set_state (priv->pipeline, GST_STATE_NULL);
-      g_clear_handle_id (&priv->bus_watch_id, g_source_remove);
-      priv->progress_timeout = 0;
-      g_array_set_size (priv->lowres, 0);
-      g_task_return_boolean (task, FALSE);
-      g_object_unref (task);
-      return G_SOURCE_REMOVE;
+      return set_pipeline_uri (priv->pipeline, priv->uri);
     }
 
-  /* Query position and duration and emit progress signal */
+  priv->pipeline = create_pipeline (priv->uri, priv->resample, &sink);
+  if (!priv->pipeline)
+    return FALSE;
 
-  if (!gst_element_query_position (priv->pipeline, GST_FORMAT_TIME, &pos))
-    return G_SOURCE_CONTINUE;
+  g_object_set (sink, "emit-signals", TRUE, NULL);
+  g_signal_connect (sink, "new-sample", G_CALLBACK (new_sample_cb), self);
+
+  return TRUE;
+}
+
+static void
+stop_pipeline (PtWaveloader *self)
+{
+  /* Stop decoding and free the decoder, but keep the pipeline for the next
+   * load */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  gst_element_set_state (priv->pipeline, GST_STATE_READY);
+}
+
+/* ------------------------- Peak cache ------------------------------------- */
+
+/* The cache is looked up in a thread: samples are copied from the cache file,
+ * the index for resizing is built and lowres is converted there. A hit only
+ * saves decoding, this is still linear in the file’s length. On a miss the
+ * file is decoded. Decoded data is saved in a thread, too, see
+ * pt-peak-cache.c. */
+
+typedef struct
+{
+  gchar  *uri;
+  gint    pps;
+  gint64  duration;
+  GArray *lowres;
+} CacheLoad;
+
+static void start_decoding (PtWaveloader *self,
+                            GTask        *task);
+
+static void
+cache_load_free (CacheLoad *load)
+{
+  g_free (load->uri);
+  if (load->lowres)
+    g_array_unref (load->lowres);
+  g_free (load);
+}
+
+static void
+save_to_cache (PtWaveloader *self)
+{
+  /* In bounded mode most samples are dropped already, a followed file is
+   * outdated soon */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  if (!priv->use_cache || priv->bounded || priv->follow)
+    return;
+
+  pt_peak_cache_save_in_background (priv->cache, priv->uri, priv->data,
+                                    priv->duration, priv->cache_max_size);
+}
+
+static void
+load_cache_real (GTask        *task,
+                 gpointer      source_object,
+                 gpointer      task_data,
+                 GCancellable *cancellable)
+{
+  PtWaveloader        *self = source_object;
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  CacheLoad           *load = task_data;
+  uint                 n_samples;
+  uint                 index_in = 0;
+  uint                 index_out = 0;
+
+  if (!pt_peak_cache_load (priv->cache, load->uri, priv->hires, &load->duration))
+    {
+      g_task_return_boolean (task, FALSE);
+      return;
+    }
+
+  n_samples = pt_sample_store_get_length (priv->hires);
+  pt_peak_pyramid_update (priv->pyramid, priv->hires, n_samples);
+
+  load->lowres = g_array_new (FALSE, FALSE, sizeof (float));
+  g_array_set_size (load->lowres, calc_lowres_len (n_samples, load->pps));
+  while (n_samples > index_in)
+    {
+      convert_one_second (priv->hires,
+                          load->lowres,
+                          &index_in,
+                          &index_out,
+                          load->pps);
+    }
+
+  finish_samples (self);
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+load_cache_cb (GObject      *source_object,
+               GAsyncResult *res,
+               gpointer      user_data)
+{
+  PtWaveloader        *self = PT_WAVELOADER (source_object);
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  GTask               *task = user_data;
+  CacheLoad           *load = g_task_get_task_data (G_TASK (res));
+  GError              *error = NULL;
+
+  if (!g_task_propagate_boolean (G_TASK (res), &error))
+    {
+      if (!error)
+        {
+          /* Not in the cache */
+          start_decoding (self, task);
+          return;
+        }
+
+      pt_sample_store_clear (priv->hires);
+      pt_peak_pyramid_reset (priv->pyramid, priv->bounded, priv->quantize);
+      g_array_set_size (priv->lowres, 0);
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  /* lowres belongs to the main thread */
+  priv->duration = load->duration;
+  g_array_set_size (priv->lowres, load->lowres->len);
+  memcpy (priv->lowres->data, load->lowres->data, load->lowres->len * sizeof (float));
+  priv->hires_index = pt_sample_store_get_length (priv->hires);
+  priv->lowres_index = priv->lowres->len;
+
+  g_signal_emit_by_name (self, "array-size-changed");
+  g_signal_emit (self, signals[DATA_AVAILABLE], 0, 0, priv->lowres->len);
+
+  g_task_return_boolean (task, TRUE);
+  g_object_unref (task);
+}
+
+static void
+load_from_cache (PtWaveloader *self,
+                 GTask        *task)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  CacheLoad           *load;
+  GTask               *thread_task;
+
+  load = g_new0 (CacheLoad, 1);
+  load->uri = g_strdup (priv->uri);
+  load->pps = priv->pps;
+
+  thread_task = g_task_new (self, g_task_get_cancellable (task), load_cache_cb, task);
+  g_task_set_task_data (thread_task, load, (GDestroyNotify) cache_load_free);
+  g_task_run_in_thread (thread_task, load_cache_real);
+  g_object_unref (thread_task);
+}
+
+static gboolean
+check_progress (GTask *task)
+{
+  /* This timeout runs parallel to message bus (bus_handler()).
+     If it’s removed, the message bus has to be removed, too, and also
+     the other way round. */
+
+  PtWaveloader        *self = g_task_get_source_object (task);
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  gint64  dur;
+  gint64  pos;
+  gdouble temp;
+  uint    new_size;
+
+  /* Check if task was cancelled and reset pipeline */
+
+  if (g_cancellable_is_cancelled (g_task_get_cancellable (task)))
+    {
+      stop_pipeline (self);
+      g_clear_pointer (&priv->bus_watch, source_remove);
+      g_clear_pointer (&priv->progress_timeout, g_source_unref);
+      discard_peaks (self);
+      g_array_set_size (priv->lowres, 0);
+      g_task_return_boolean (task, FALSE);
+      g_object_unref (task);
+      return G_SOURCE_REMOVE;
+    }
+
+  publish_peaks (self);
+
+  /* Query position and duration and emit progress signal */
+
+  if (!gst_element_query_position (priv->pipeline, GST_FORMAT_TIME, &pos))
+    return G_SOURCE_CONTINUE;
 
   if (!gst_element_query_duration (priv->pipeline, GST_FORMAT_TIME, &dur))
     return G_SOURCE_CONTINUE;
@@ -354,91 +1139,1337 @@ check_progress (GTask *task)
       g_signal_emit_by_name (self, "progress", priv->progress);
     }
 
-  return G_SOURCE_CONTINUE;
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+bus_handler (GstBus     *bus,
+             GstMessage *msg,
+             gpointer    data)
+{
+  GTask               *task = (GTask *) data;
+  PtWaveloader        *self = g_task_get_source_object (task);
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  switch (GST_MESSAGE_TYPE (msg))
+    {
+    case GST_MESSAGE_ERROR:
+      {
+        gchar  *debug;
+        GError *error;
+
+        g_clear_pointer (&priv->progress_timeout, source_remove);
+        gst_message_parse_error (msg, &error, &debug);
+        stop_pipeline (self);
+
+        /* Error is returned. Log the message here at level DEBUG,
+           as higher levels will abort tests. */
+
+        g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                          "MESSAGE", "Error from element %s: %s", GST_OBJECT_NAME (msg->src), error->message);
+        g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                          "MESSAGE", "Debugging info: %s", (debug) ? debug : "none");
+        g_free (debug);
+        g_clear_pointer (&priv->bus_watch, g_source_unref);
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return FALSE;
+      }
+
+    case GST_MESSAGE_EOS:
+      {
+        const gint16 *out;
+        guint         n_out;
+
+        out = decimator_flush (&priv->decimator, &n_out);
+        add_samples (self, out, n_out);
+        convert_remaining (self);
+
+        /* query length and convert to samples */
+        if (!gst_element_query_duration (priv->pipeline, GST_FORMAT_TIME, &priv->duration))
+          {
+            GST_WARNING ("getting sample duration failed");
+          }
+        stop_pipeline (self);
+
+        g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                          "MESSAGE", "Sample decoded: samples=%d, lowres->len=%d, pps=%d, duration=%" GST_TIME_FORMAT,
+                          pt_sample_store_get_length (priv->hires), priv->lowres->len, priv->pps, GST_TIME_ARGS (priv->duration));
+
+        save_to_cache (self);
+        finish_samples (self);
+
+        g_clear_pointer (&priv->progress_timeout, source_remove);
+        g_clear_pointer (&priv->bus_watch, g_source_unref);
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return FALSE;
+      }
+    case GST_MESSAGE_DURATION_CHANGED:
+      {
+        gst_element_query_duration (priv->pipeline, GST_FORMAT_TIME, &priv->duration);
+        gint new_size;
+        new_size = priv->duration / 1000000000 * priv->pps * 2;
+        g_array_set_size (priv->lowres, new_size);
+        g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                          "MESSAGE", "Duration changed signal: %" GST_TIME_FORMAT " lowres resized to len %d",
+                          GST_TIME_ARGS (priv->duration), new_size);
+        g_signal_emit_by_name (self, "array-size-changed");
+        break;
+      }
+    default:
+      break;
+    }
+
+  return TRUE;
+}
+
+/* ------------------------- Parallel loading ------------------------------- */
+
+/* In parallel mode the file is split into segments of whole seconds. Each
+ * segment is decoded by its own pipeline in its own thread, starting with a
+ * seek to the segment's start. Samples are written directly to their place
+ * in the preallocated hires store, so there is no need to stitch them later.
+ * Segments start at whole seconds, i.e. at blocks of the store, threads never
+ * write to the same block.
+ * Seconds that are complete are converted to lowres in the main thread.
+ * Without a known duration the file can't be split, it is decoded by the
+ * single pipeline instead. */
+
+static void load_pipeline (PtWaveloader *self,
+                           GTask        *task);
+
+enum
+{
+  SECOND_PENDING,
+  SECOND_DECODED,
+  SECOND_CONVERTED
+};
+
+struct _ParallelLoad
+{
+  gchar         *uri;
+  gint           n_segments;
+  gboolean       resample;
+  PtSampleStore *hires;
+  PtPeakPyramid *pyramid;
+  gint64         duration;
+
+  /* Set in the loading thread before ready is set */
+  gint  *seconds;  /* atomic, one per second */
+  guint  n_seconds;
+  guint  total;    /* expected number of samples */
+  gint   ready;    /* atomic */
+  gint   done;     /* atomic, number of decoded samples */
+
+  /* Result of the last segment */
+  guint   end;
+  GArray *overflow; /* samples after expected end */
+};
+
+typedef struct
+{
+  ParallelLoad *load;
+  GCancellable *cancellable;
+  guint         start;
+  guint         end;
+  gboolean      last;
+  guint         position;
+  guint         next_second;
+  Decimator     decimator;
+  GError       *error;
+} Segment;
+
+static void
+parallel_load_free (ParallelLoad *load)
+{
+  g_free (load->uri);
+  g_free (load->seconds);
+  g_array_unref (load->overflow);
+  g_free (load);
+}
+
+static gboolean
+pop_bus_error (GstElement *pipeline,
+               GError    **error)
+{
+  GstBus     *bus;
+  GstMessage *msg;
+  GError     *msg_error = NULL;
+
+  /* This also discards all other messages posted so far */
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ERROR);
+  gst_object_unref (bus);
+
+  if (!msg)
+    return FALSE;
+
+  gst_message_parse_error (msg, &msg_error, NULL);
+  g_propagate_error (error, msg_error);
+  gst_message_unref (msg);
+  return TRUE;
+}
+
+static gboolean
+preroll_pipeline (GstElement *pipeline,
+                  GError    **error)
+{
+  if (gst_element_set_state (pipeline, GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE &&
+      gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) != GST_STATE_CHANGE_FAILURE)
+    return TRUE;
+
+  if (!pop_bus_error (pipeline, error))
+    g_set_error_literal (error,
+                         GST_CORE_ERROR,
+                         GST_CORE_ERROR_STATE_CHANGE,
+                         _ ("Failed to setup GStreamer pipeline."));
+  return FALSE;
+}
+
+static void
+segment_add_samples (Segment      *seg,
+                     const gint16 *samples,
+                     guint         n_samples,
+                     guint         pos)
+{
+  ParallelLoad *load = seg->load;
+  guint         skip = 0;
+  guint         copy = 0;
+  guint         end;
+
+  /* Place samples at @pos, drop what belongs to the segment before */
+  if (pos < seg->start)
+    {
+      skip = MIN (n_samples, seg->start - pos);
+      pos += skip;
+    }
+
+  if (pos < seg->end)
+    {
+      copy = MIN (n_samples - skip, seg->end - pos);
+      pt_sample_store_write (load->hires, pos, samples + skip, copy);
+    }
+
+  /* The duration was just an estimate, keep what comes after the end */
+  if (seg->last && skip + copy < n_samples)
+    {
+      g_array_set_size (load->overflow, pos + copy - seg->end);
+      g_array_append_vals (load->overflow, samples + skip + copy, n_samples - skip - copy);
+    }
+
+  seg->position = pos + n_samples - skip;
+  g_atomic_int_add (&load->done, copy);
+
+  end = MIN (seg->position, seg->end);
+  while ((seg->next_second + 1) * 8000 <= end)
+    g_atomic_int_set (&load->seconds[seg->next_second++], SECOND_DECODED);
+}
+
+static gpointer
+decode_segment (gpointer data)
+{
+  Segment      *seg = data;
+  Decimator    *d = &seg->decimator;
+  GstElement   *pipeline;
+  GstElement   *sink;
+  GstSample    *sample;
+  GstBuffer    *buffer;
+  GstMapInfo    map;
+  GstSeekFlags  flags = GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE;
+  const gint16 *out;
+  guint         n_out;
+  guint         pos;
+  guint64       frame;
+
+  pipeline = create_pipeline (seg->load->uri, seg->load->resample, &sink);
+  if (!pipeline)
+    {
+      g_set_error_literal (&seg->error,
+                           GST_CORE_ERROR,
+                           GST_CORE_ERROR_FAILED,
+                           _ ("Failed to setup GStreamer pipeline."));
+      return NULL;
+    }
+
+  decimator_start (d, 8000, FALSE, seg->start);
+  if (!preroll_pipeline (pipeline, &seg->error))
+    goto out;
+
+  if ((seg->start > 0 || !seg->last) &&
+      !gst_element_seek (pipeline, 1.0, GST_FORMAT_TIME, flags,
+                         GST_SEEK_TYPE_SET,
+                         gst_util_uint64_scale (seg->start, GST_SECOND, 8000),
+                         seg->last ? GST_SEEK_TYPE_NONE : GST_SEEK_TYPE_SET,
+                         gst_util_uint64_scale (seg->end, GST_SECOND, 8000)))
+    {
+      g_set_error_literal (&seg->error,
+                           GST_CORE_ERROR,
+                           GST_CORE_ERROR_SEEK,
+                           _ ("Seek failed."));
+      goto out;
+    }
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  while (!g_cancellable_is_cancelled (seg->cancellable))
+    {
+      if (pop_bus_error (pipeline, &seg->error))
+        break;
+
+      sample = gst_app_sink_try_pull_sample (GST_APP_SINK (sink), 100 * GST_MSECOND);
+      if (!sample)
+        {
+          if (gst_app_sink_is_eos (GST_APP_SINK (sink)))
+            break;
+          continue;
+        }
+
+      buffer = gst_sample_get_buffer (sample);
+      if (decimator_set_caps (d, gst_sample_get_caps (sample)) &&
+          gst_buffer_map (buffer, &map, GST_MAP_READ))
+        {
+          /* Place frames according to their timestamp */
+          if (GST_BUFFER_PTS_IS_VALID (buffer))
+            {
+              frame = gst_util_uint64_scale_round (GST_BUFFER_PTS (buffer), d->rate, GST_SECOND);
+              if (frame != d->frame)
+                decimator_start (d, d->rate, d->is_float, frame);
+            }
+          pos = d->sample;
+          out = decimator_process (d, map.data, map.size / (d->is_float ? 4 : 2), &n_out);
+          segment_add_samples (seg, out, n_out, pos);
+          gst_buffer_unmap (buffer, &map);
+        }
+      gst_sample_unref (sample);
+
+      if (!seg->last && seg->position >= seg->end)
+        break;
+    }
+
+  /* The last second may be incomplete */
+  if (seg->last && !seg->error && !g_cancellable_is_cancelled (seg->cancellable))
+    {
+      pos = d->sample;
+      out = decimator_flush (d, &n_out);
+      segment_add_samples (seg, out, n_out, pos);
+    }
+  if (seg->last && seg->next_second < seg->load->n_seconds)
+    g_atomic_int_set (&seg->load->seconds[seg->next_second], SECOND_DECODED);
+
+out:
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  decimator_clear (d);
+  return NULL;
+}
+
+static void
+load_parallel_real (GTask        *task,
+                    gpointer      source_object,
+                    gpointer      task_data,
+                    GCancellable *cancellable)
+{
+  ParallelLoad *load = task_data;
+  GstElement   *pipeline;
+  GstElement   *sink;
+  Segment      *segments;
+  GThread     **threads;
+  GError       *error = NULL;
+  guint         full_seconds;
+  guint         seconds_per_segment;
+  gint          n, i;
+
+  /* Get duration */
+  pipeline = create_pipeline (load->uri, load->resample, &sink);
+  if (!pipeline)
+    {
+      g_task_return_new_error (task,
+                               GST_CORE_ERROR,
+                               GST_CORE_ERROR_FAILED,
+                               _ ("Failed to setup GStreamer pipeline."));
+      return;
+    }
+  if (!preroll_pipeline (pipeline, &error))
+    {
+      gst_element_set_state (pipeline, GST_STATE_NULL);
+      gst_object_unref (pipeline);
+      g_task_return_error (task, error);
+      return;
+    }
+  if (!gst_element_query_duration (pipeline, GST_FORMAT_TIME, &load->duration))
+    load->duration = 0;
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  /* Without duration there would be no progress, the main thread falls
+   * back to the single pipeline */
+  load->total = gst_util_uint64_scale_round (MAX (load->duration, 0), 8000, GST_SECOND);
+  if (load->total == 0)
+    {
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                        "MESSAGE", "Unknown duration, decoding in one pipeline");
+      g_task_return_boolean (task, FALSE);
+      return;
+    }
+
+  load->n_seconds = (load->total + 7999) / 8000;
+  full_seconds = load->total / 8000;
+  n = CLAMP (full_seconds / SEGMENT_MIN_SECONDS, 1, (guint) load->n_segments);
+  seconds_per_segment = full_seconds / n;
+
+  pt_sample_store_set_length (load->hires, load->total);
+  load->seconds = g_new0 (gint, load->n_seconds);
+  g_atomic_int_set (&load->ready, TRUE);
+
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                    "MESSAGE", "Decoding %d segments of %d seconds, duration=%" GST_TIME_FORMAT,
+                    n, seconds_per_segment, GST_TIME_ARGS (load->duration));
+
+  segments = g_new0 (Segment, n);
+  threads = g_new (GThread *, n);
+  for (i = 0; i < n; i++)
+    {
+      segments[i].load = load;
+      segments[i].cancellable = cancellable;
+      segments[i].start = i * seconds_per_segment * 8000;
+      segments[i].last = (i == n - 1);
+      segments[i].end = segments[i].last ? load->total : (i + 1) * seconds_per_segment * 8000;
+      segments[i].position = segments[i].start;
+      segments[i].next_second = segments[i].start / 8000;
+      threads[i] = g_thread_new ("pt-waveloader", decode_segment, &segments[i]);
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      g_thread_join (threads[i]);
+      if (segments[i].error && !error)
+        error = g_steal_pointer (&segments[i].error);
+      g_clear_error (&segments[i].error);
+    }
+
+  load->end = MIN (segments[n - 1].position, load->total);
+  g_free (segments);
+  g_free (threads);
+
+  if (g_task_return_error_if_cancelled (task))
+    {
+      g_clear_error (&error);
+      return;
+    }
+  if (error)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  /* Overflow is added in the main thread */
+  pt_peak_pyramid_update (load->pyramid, load->hires, load->end);
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+convert_decoded_seconds (PtWaveloader *self)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  ParallelLoad        *load = priv->parallel;
+  uint                 index_in;
+  uint                 index_out;
+  uint                 start = 0;
+  uint                 end = 0;
+
+  /* Segments progress independently, announce each contiguous range of new
+   * data */
+  for (guint s = 0; s < load->n_seconds; s++)
+    {
+      if (!g_atomic_int_compare_and_exchange (&load->seconds[s], SECOND_DECODED, SECOND_CONVERTED))
+        continue;
+
+      index_in = s * 8000;
+      index_out = s * priv->pps * 2;
+      if (index_out != end)
+        {
+          if (start < end)
+            g_signal_emit (self, signals[DATA_AVAILABLE], 0, start, end);
+          start = index_out;
+        }
+      convert_one_second (priv->hires, priv->lowres, &index_in, &index_out, priv->pps);
+      end = index_out;
+    }
+
+  if (start < end)
+    g_signal_emit (self, signals[DATA_AVAILABLE], 0, start, end);
+}
+
+static gboolean
+check_parallel_progress (PtWaveloader *self)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  ParallelLoad        *load = priv->parallel;
+  uint                 new_size;
+  gdouble              temp;
+
+  if (!g_atomic_int_get (&load->ready))
+    return G_SOURCE_CONTINUE;
+
+  new_size = calc_lowres_len (load->total, priv->pps);
+  if (priv->lowres->len != new_size)
+    {
+      /* Clear old data, seconds are not converted in order */
+      priv->duration = load->duration;
+      g_array_set_size (priv->lowres, 0);
+      g_array_set_size (priv->lowres, new_size);
+      g_signal_emit_by_name (self, "array-size-changed");
+    }
+
+  convert_decoded_seconds (self);
+
+  temp = (gdouble) g_atomic_int_get (&load->done) / load->total;
+  if (temp > priv->progress && temp < 1)
+    {
+      priv->progress = temp;
+      g_signal_emit_by_name (self, "progress", priv->progress);
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+load_parallel_cb (GObject      *source_object,
+                  GAsyncResult *res,
+                  gpointer      user_data)
+{
+  PtWaveloader        *self = PT_WAVELOADER (source_object);
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  GTask               *task = user_data;
+  ParallelLoad        *load = priv->parallel;
+  GError              *error = NULL;
+  uint                 n_samples;
+  uint                 lowres_len;
+  uint                 tail;
+  uint                 index_in;
+  uint                 index_out;
+  uint                 start = G_MAXUINT;
+
+  g_clear_pointer (&priv->progress_timeout, source_remove);
+
+  if (!g_task_propagate_boolean (G_TASK (res), &error))
+    {
+      priv->parallel = NULL;
+      parallel_load_free (load);
+      if (!error)
+        {
+          load_pipeline (self, task);
+          return;
+        }
+      pt_sample_store_clear (priv->hires);
+      g_array_set_size (priv->lowres, 0);
+      pt_peak_pyramid_reset (priv->pyramid, priv->bounded, priv->quantize);
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  /* Take over the seconds decoded since the last check */
+  check_parallel_progress (self);
+  priv->parallel = NULL;
+
+  pt_sample_store_set_length (priv->hires, load->end);
+  pt_sample_store_append (priv->hires, (gint16 *) load->overflow->data, load->overflow->len);
+  n_samples = pt_sample_store_get_length (priv->hires);
+  pt_peak_pyramid_update (priv->pyramid, priv->hires, n_samples);
+
+  priv->duration = load->duration;
+  if (load->end < load->total || load->overflow->len > 0)
+    priv->duration = gst_util_uint64_scale (n_samples, GST_SECOND, 8000);
+
+  lowres_len = calc_lowres_len (n_samples, priv->pps);
+  if (priv->lowres->len != lowres_len)
+    {
+      g_array_set_size (priv->lowres, lowres_len);
+      g_signal_emit_by_name (self, "array-size-changed");
+    }
+
+  /* Full seconds are converted already, unless a segment stopped early.
+   * The last second might have changed with the overflow. */
+  tail = MIN (load->end, load->total) / 8000;
+  for (guint s = 0; s < tail; s++)
+    {
+      if (g_atomic_int_get (&load->seconds[s]) == SECOND_CONVERTED)
+        continue;
+      index_in = s * 8000;
+      index_out = s * priv->pps * 2;
+      start = MIN (start, index_out);
+      convert_one_second (priv->hires, priv->lowres, &index_in, &index_out, priv->pps);
+    }
+
+  priv->hires_index = tail * 8000;
+  priv->lowres_index = tail * priv->pps * 2;
+  start = MIN (start, priv->lowres_index);
+  while (n_samples > priv->hires_index)
+    {
+      convert_one_second (priv->hires,
+                          priv->lowres,
+                          &priv->hires_index,
+                          &priv->lowres_index,
+                          priv->pps);
+    }
+
+  if (start < priv->lowres->len)
+    g_signal_emit (self, signals[DATA_AVAILABLE], 0, start, priv->lowres->len);
+
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                    "MESSAGE", "Parallel decoding done: samples=%d, lowres->len=%d, pps=%d, duration=%" GST_TIME_FORMAT,
+                    n_samples, priv->lowres->len, priv->pps, GST_TIME_ARGS (priv->duration));
+
+  save_to_cache (self);
+  finish_samples (self);
+  parallel_load_free (load);
+  g_task_return_boolean (task, TRUE);
+  g_object_unref (task);
+}
+
+static void
+load_parallel (PtWaveloader *self,
+               GTask        *task)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  ParallelLoad        *load;
+  GTask               *thread_task;
+
+  load = g_new0 (ParallelLoad, 1);
+  load->uri = g_strdup (priv->uri);
+  load->resample = priv->resample;
+  load->n_segments = priv->n_segments > 0 ? priv->n_segments : (gint) g_get_num_processors ();
+  load->hires = priv->hires;
+  load->pyramid = priv->pyramid;
+  load->overflow = g_array_new (FALSE, FALSE, sizeof (gint16));
+  priv->parallel = load;
+
+  thread_task = g_task_new (self, g_task_get_cancellable (task), load_parallel_cb, task);
+  g_task_set_task_data (thread_task, load, NULL);
+  g_task_run_in_thread (thread_task, load_parallel_real);
+  g_object_unref (thread_task);
+
+  priv->progress_timeout = timeout_add (30, (GSourceFunc) check_parallel_progress, self);
+}
+
+/* ------------------------- PCM fast path ---------------------------------- */
+
+/* Uncompressed WAV and AIFF files are read directly in a thread, without a
+ * GStreamer pipeline. The frames go through the same Decimator as decoded
+ * ones. */
+
+struct _PcmLoad
+{
+  PtPcmFile *file;
+  guint      total; /* number of samples at 8000 Hz */
+  gint       done;  /* atomic */
+};
+
+static void
+pcm_load_free (PcmLoad *load)
+{
+  pt_pcm_file_free (load->file);
+  g_free (load);
+}
+
+static void
+load_pcm_real (GTask        *task,
+               gpointer      source_object,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+  PtWaveloader *self = source_object;
+  PcmLoad      *load = task_data;
+  guint         rate = pt_pcm_file_get_rate (load->file);
+  guint64       n_frames = pt_pcm_file_get_n_frames (load->file);
+  Decimator     d = { 0 };
+  gint16       *frames;
+  const gint16 *out;
+  guint64       first;
+  guint         n, n_out;
+
+  /* Frames of one second */
+  frames = g_new (gint16, rate);
+  decimator_start (&d, rate, FALSE, 0);
+
+  for (first = 0; first < n_frames; first += n)
+    {
+      if (g_task_return_error_if_cancelled (task))
+        {
+          decimator_clear (&d);
+          g_free (frames);
+          return;
+        }
+
+      /* A recorder might rewrite the file */
+      if (!pt_pcm_file_check_length (load->file))
+        {
+          decimator_clear (&d);
+          g_free (frames);
+          g_task_return_new_error (task,
+                                   GST_RESOURCE_ERROR,
+                                   GST_RESOURCE_ERROR_READ,
+                                   _ ("The file was truncated while it was read."));
+          return;
+        }
+
+      n = MIN (rate, n_frames - first);
+      pt_pcm_file_read (load->file, first, n, frames);
+      out = decimator_process (&d, frames, n, &n_out);
+      add_samples (self, out, n_out);
+      g_atomic_int_set (&load->done, d.sample);
+    }
+
+  out = decimator_flush (&d, &n_out);
+  add_samples (self, out, n_out);
+  g_atomic_int_set (&load->done, d.sample);
+
+  decimator_clear (&d);
+  g_free (frames);
+  g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+check_pcm_progress (PtWaveloader *self)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  gdouble              temp;
+
+  publish_peaks (self);
+
+  temp = (gdouble) g_atomic_int_get (&priv->pcm->done) / priv->pcm->total;
+  if (temp > priv->progress && temp < 1)
+    {
+      priv->progress = temp;
+      g_signal_emit_by_name (self, "progress", priv->progress);
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+load_pcm_cb (GObject      *source_object,
+             GAsyncResult *res,
+             gpointer      user_data)
+{
+  PtWaveloader        *self = PT_WAVELOADER (source_object);
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  GTask               *task = user_data;
+  PcmLoad             *load = priv->pcm;
+  GError              *error = NULL;
+
+  g_clear_pointer (&priv->progress_timeout, source_remove);
+  priv->pcm = NULL;
+
+  if (!g_task_propagate_boolean (G_TASK (res), &error))
+    {
+      discard_peaks (self);
+      pt_sample_store_clear (priv->hires);
+      g_array_set_size (priv->lowres, 0);
+      pt_peak_pyramid_reset (priv->pyramid, priv->bounded, priv->quantize);
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      pcm_load_free (load);
+      return;
+    }
+
+  convert_remaining (self);
+
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                    "MESSAGE", "PCM file read: samples=%d, lowres->len=%d, pps=%d, duration=%" GST_TIME_FORMAT,
+                    pt_sample_store_get_length (priv->hires), priv->lowres->len, priv->pps, GST_TIME_ARGS (priv->duration));
+
+  save_to_cache (self);
+  finish_samples (self);
+  pcm_load_free (load);
+  g_task_return_boolean (task, TRUE);
+  g_object_unref (task);
+}
+
+static gboolean
+load_pcm (PtWaveloader *self,
+          GTask        *task)
+{
+  /* Returns FALSE if the file is not supported */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  PtPcmFile           *file;
+  PcmLoad             *load;
+  GTask               *thread_task;
+  guint64              total;
+
+  file = pt_pcm_file_new (priv->uri);
+  if (!file)
+    return FALSE;
+
+  total = gst_util_uint64_scale_ceil (pt_pcm_file_get_n_frames (file), 8000,
+                                      pt_pcm_file_get_rate (file));
+  if (total > G_MAXINT)
+    {
+      pt_pcm_file_free (file);
+      return FALSE;
+    }
+
+  load = g_new0 (PcmLoad, 1);
+  load->file = file;
+  load->total = total;
+  priv->pcm = load;
+
+  /* The size is known in advance */
+  priv->duration = gst_util_uint64_scale (pt_pcm_file_get_n_frames (file), GST_SECOND,
+                                          pt_pcm_file_get_rate (file));
+  g_array_set_size (priv->lowres, calc_lowres_len (total, priv->pps));
+  g_signal_emit_by_name (self, "array-size-changed");
+
+  thread_task = g_task_new (self, g_task_get_cancellable (task), load_pcm_cb, task);
+  g_task_set_task_data (thread_task, load, NULL);
+  g_task_run_in_thread (thread_task, load_pcm_real);
+  g_object_unref (thread_task);
+
+  priv->progress_timeout = timeout_add (30, (GSourceFunc) check_pcm_progress, self);
+
+  return TRUE;
+}
+
+/* ------------------------- Shared data ------------------------------------ */
+
+/* Samples and pyramid belong to a PtPeakData. With #PtWaveloader:shared it
+ * is taken from the process-wide store, see pt-peak-store.c: the first
+ * loader of a file decodes it, others wait until it’s complete and convert
+ * only their own lowres array. Loaders that follow a file or have bounded
+ * memory change their data after loading, they use private data. */
+
+static void start_load (PtWaveloader *self,
+                        GTask        *task);
+
+static void
+set_data (PtWaveloader *self,
+          PtPeakData   *data,
+          gboolean      owner)
+{
+  /* Takes over the reference */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  pt_peak_data_unref (priv->data);
+  priv->data = data;
+  priv->data_owner = owner;
+  priv->hires = pt_peak_data_get_samples (data);
+  priv->pyramid = pt_peak_data_get_pyramid (data);
+}
+
+static void
+attach_data (PtWaveloader *self)
+{
+  /* Gets data for a new load. Private data is reused if nobody else
+   * uses it. */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  PtPeakData          *data;
+  gboolean             owner = TRUE;
+
+  if (priv->shared && !priv->bounded && !priv->follow)
+    data = pt_peak_store_attach (priv->uri, &owner);
+  else if (!pt_peak_data_is_shared (priv->data))
+    data = pt_peak_data_ref (priv->data);
+  else
+    data = pt_peak_data_new ();
+
+  set_data (self, data, owner);
+  if (!owner)
+    return;
+
+  pt_sample_store_clear (priv->hires);
+  pt_peak_pyramid_reset (priv->pyramid, priv->bounded, priv->quantize);
+}
+
+static void
+detach_data (PtWaveloader *self)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  if (pt_peak_data_is_shared (priv->data))
+    {
+      set_data (self, pt_peak_data_new (), TRUE);
+      return;
+    }
+
+  pt_sample_store_clear (priv->hires);
+  pt_peak_pyramid_reset (priv->pyramid, FALSE, FALSE);
+}
+
+static void
+unshare_data (PtWaveloader *self)
+{
+  /* Copies shared data before it’s changed */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  PtPeakData          *data;
+  PtSampleStore       *samples;
+  const gint16        *block;
+  guint                len;
+  guint                pos = 0;
+  guint                n;
+
+  if (!pt_peak_data_is_shared (priv->data))
+    return;
+
+  data = pt_peak_data_new ();
+  samples = pt_peak_data_get_samples (data);
+  len = pt_sample_store_get_length (priv->hires);
+  while (pos < len)
+    {
+      block = pt_sample_store_get_block (priv->hires, pos, &n);
+      n = MIN (n, len - pos);
+      pt_sample_store_append (samples, block, n);
+      pos += n;
+    }
+
+  pt_peak_pyramid_reset (pt_peak_data_get_pyramid (data), FALSE, priv->quantize);
+  pt_peak_pyramid_update (pt_peak_data_get_pyramid (data), samples, len);
+  set_data (self, data, TRUE);
+}
+
+static void
+load_from_data (PtWaveloader *self)
+{
+  /* Converts complete data of another loader */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  uint                 n_samples;
+
+  n_samples = pt_sample_store_get_length (priv->hires);
+  priv->duration = pt_peak_data_get_duration (priv->data);
+  g_array_set_size (priv->lowres, calc_lowres_len (n_samples, priv->pps));
+  convert_from_pyramid (priv->pyramid,
+                        priv->hires,
+                        n_samples,
+                        (float *) priv->lowres->data,
+                        priv->pps,
+                        0,
+                        priv->lowres->len / 2,
+                        NULL);
+  priv->hires_index = n_samples;
+  priv->lowres_index = priv->lowres->len;
+
+  g_signal_emit_by_name (self, "array-size-changed");
+  g_signal_emit (self, signals[DATA_AVAILABLE], 0, 0, priv->lowres->len);
+}
+
+static gboolean
+check_shared_progress (GTask *task)
+{
+  /* Waits for the owner of the data */
+
+  PtWaveloader        *self = g_task_get_source_object (task);
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  GError              *error = NULL;
+
+  if (g_cancellable_is_cancelled (g_task_get_cancellable (task)))
+    {
+      g_clear_pointer (&priv->progress_timeout, g_source_unref);
+      set_data (self, pt_peak_data_new (), TRUE);
+      g_array_set_size (priv->lowres, 0);
+      g_task_return_boolean (task, FALSE);
+      g_object_unref (task);
+      return G_SOURCE_REMOVE;
+    }
+
+  switch (pt_peak_data_get_state (priv->data, &error))
+    {
+    case PT_PEAK_DATA_LOADING:
+      return G_SOURCE_CONTINUE;
+    case PT_PEAK_DATA_COMPLETE:
+      g_clear_pointer (&priv->progress_timeout, g_source_unref);
+      load_from_data (self);
+      g_task_return_boolean (task, TRUE);
+      g_object_unref (task);
+      return G_SOURCE_REMOVE;
+    case PT_PEAK_DATA_FAILED:
+    default:
+      g_clear_pointer (&priv->progress_timeout, g_source_unref);
+      if (!error)
+        {
+          /* The owner was cancelled, try it ourselves */
+          start_load (self, task);
+          return G_SOURCE_REMOVE;
+        }
+      set_data (self, pt_peak_data_new (), TRUE);
+      g_array_set_size (priv->lowres, 0);
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return G_SOURCE_REMOVE;
+    }
+}
+
+static void
+shared_load_cb (PtWaveloader *self,
+                GAsyncResult *res,
+                gpointer      user_data)
+{
+  /* The owner of shared data is done. Waiting loaders get the state, the
+   * caller gets the result. */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  GTask               *task = user_data;
+  GError              *error = NULL;
+  gboolean             success;
+
+  success = g_task_propagate_boolean (G_TASK (res), &error);
+  if (success)
+    pt_peak_data_complete (priv->data, priv->duration);
+  else if (error && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    pt_peak_data_fail (priv->data, error);
+  else
+    pt_peak_data_fail (priv->data, NULL);
+
+  if (error)
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, success);
+  g_object_unref (task);
+}
+
+/* ------------------------- Follow mode ------------------------------------ */
+
+/* A file that is still being written is watched with a GFileMonitor. On
+ * each change only the new data is read in a thread: PCM files from the
+ * first new frame on, other files by a new pipeline, seeking to the old
+ * end. The last incomplete second in lowres is converted again. Load and
+ * resize operations stop an update before they start, it’s resumed
+ * afterwards. The thread changes hires and the pyramid with follow_lock
+ * held, the main thread holds it while it reads them. */
+
+static void
+follow_add (PtWaveloader *self,
+            const gint16 *samples,
+            guint         n_samples,
+            guint         pos)
+{
+  /* Adds samples starting at @pos, drops what is known already and fills
+   * gaps with silence */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  guint                len = pt_sample_store_get_length (priv->hires);
+  gint16               zeros[1024] = { 0 };
+
+  if (pos + n_samples <= len)
+    return;
+
+  g_mutex_lock (&priv->follow_lock);
+
+  if (pos < len)
+    {
+      samples += len - pos;
+      n_samples -= len - pos;
+    }
+
+  while (pos > len)
+    {
+      add_samples (self, zeros, MIN (pos - len, G_N_ELEMENTS (zeros)));
+      len = pt_sample_store_get_length (priv->hires);
+    }
+
+  add_samples (self, samples, n_samples);
+  g_mutex_unlock (&priv->follow_lock);
+}
+
+static void
+follow_read_pcm (PtWaveloader *self,
+                 PtPcmFile    *file)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  guint                rate = pt_pcm_file_get_rate (file);
+  guint64              n_frames = pt_pcm_file_get_n_frames (file);
+  Decimator            d = { 0 };
+  gint16              *frames;
+  const gint16        *out;
+  guint64              first;
+  guint                n, n_out, pos;
+
+  /* Start at the frame of the first incomplete sample */
+  first = gst_util_uint64_scale (pt_sample_store_get_length (priv->hires), rate, 8000);
+  if (first >= n_frames)
+    return;
+
+  frames = g_new (gint16, rate);
+  decimator_start (&d, rate, FALSE, first);
+
+  for (; first < n_frames; first += n)
+    {
+      /* The file is still written to, it might have been truncated */
+      if (g_cancellable_is_cancelled (priv->follow_cancel) ||
+          !pt_pcm_file_check_length (file))
+        goto out;
+
+      n = MIN (rate, n_frames - first);
+      pt_pcm_file_read (file, first, n, frames);
+      pos = d.sample;
+      out = decimator_process (&d, frames, n, &n_out);
+      follow_add (self, out, n_out, pos);
+    }
+
+  pos = d.sample;
+  out = decimator_flush (&d, &n_out);
+  follow_add (self, out, n_out, pos);
+
+out:
+  decimator_clear (&d);
+  g_free (frames);
+}
+
+static void
+follow_decode (PtWaveloader *self)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  Decimator            d = { 0 };
+  GstElement          *pipeline;
+  GstElement          *sink;
+  GstSample           *sample;
+  GstBuffer           *buffer;
+  GstMapInfo           map;
+  const gint16        *out;
+  guint                n_out, pos, len;
+  guint64              frame;
+
+  pipeline = create_pipeline (priv->uri, priv->resample, &sink);
+  if (!pipeline)
+    return;
+
+  len = pt_sample_store_get_length (priv->hires);
+  if (!preroll_pipeline (pipeline, NULL) ||
+      (len > 0 && !gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+                                            GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE,
+                                            gst_util_uint64_scale (len, GST_SECOND, 8000))))
+    goto out;
+
+  decimator_start (&d, 8000, FALSE, len);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  while (!g_cancellable_is_cancelled (priv->follow_cancel))
+    {
+      if (pop_bus_error (pipeline, NULL))
+        goto out;
+
+      sample = gst_app_sink_try_pull_sample (GST_APP_SINK (sink), 100 * GST_MSECOND);
+      if (!sample)
+        {
+          if (gst_app_sink_is_eos (GST_APP_SINK (sink)))
+            break;
+          continue;
+        }
+
+      buffer = gst_sample_get_buffer (sample);
+      if (decimator_set_caps (&d, gst_sample_get_caps (sample)) &&
+          gst_buffer_map (buffer, &map, GST_MAP_READ))
+        {
+          if (GST_BUFFER_PTS_IS_VALID (buffer))
+            {
+              frame = gst_util_uint64_scale_round (GST_BUFFER_PTS (buffer), d.rate, GST_SECOND);
+              if (frame != d.frame)
+                decimator_start (&d, d.rate, d.is_float, frame);
+            }
+          pos = d.sample;
+          out = decimator_process (&d, map.data, map.size / (d.is_float ? 4 : 2), &n_out);
+          follow_add (self, out, n_out, pos);
+          gst_buffer_unmap (buffer, &map);
+        }
+      gst_sample_unref (sample);
+    }
+
+  if (!g_cancellable_is_cancelled (priv->follow_cancel))
+    {
+      pos = d.sample;
+      out = decimator_flush (&d, &n_out);
+      follow_add (self, out, n_out, pos);
+    }
+
+out:
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  decimator_clear (&d);
+}
+
+static gpointer
+follow_update_real (gpointer data)
+{
+  PtWaveloader        *self = data;
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  PtPcmFile           *file;
+
+  file = pt_pcm_file_new (priv->uri);
+  if (file)
+    {
+      follow_read_pcm (self, file);
+      pt_pcm_file_free (file);
+    }
+  else
+    {
+      follow_decode (self);
+    }
+
+  g_atomic_int_set (&priv->follow_done, TRUE);
+  return NULL;
+}
+
+static void
+follow_finish (PtWaveloader *self)
+{
+  /* Waits for the update thread and takes over its data */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  guint                len = priv->lowres->len;
+  gint64               duration;
+
+  g_thread_join (priv->follow_thread);
+  priv->follow_thread = NULL;
+  g_clear_pointer (&priv->follow_timeout, source_remove);
+
+  convert_remaining (self);
+  if (priv->lowres->len != len)
+    g_signal_emit_by_name (self, "array-size-changed");
+
+  duration = gst_util_uint64_scale (pt_sample_store_get_length (priv->hires), GST_SECOND, 8000);
+  if (duration > priv->duration)
+    {
+      priv->duration = duration;
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                        "MESSAGE", "Followed file grew to %" GST_TIME_FORMAT,
+                        GST_TIME_ARGS (priv->duration));
+      g_signal_emit (self, signals[DURATION_CHANGED], 0, priv->duration);
+    }
+}
+
+static void follow_update (PtWaveloader *self);
+
+static gboolean
+check_follow_progress (PtWaveloader *self)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  publish_peaks (self);
+
+  if (!g_atomic_int_get (&priv->follow_done))
+    return G_SOURCE_CONTINUE;
+
+  g_clear_pointer (&priv->follow_timeout, g_source_unref);
+  follow_finish (self);
+
+  if (priv->follow_again)
+    follow_update (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+follow_update (PtWaveloader *self)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  guint                len;
+
+  if (priv->follow_thread || priv->load_pending || priv->data_pending ||
+      priv->resize_threads > 0)
+    {
+      priv->follow_again = TRUE;
+      return;
+    }
+
+  priv->follow_again = FALSE;
+
+  /* Convert the last incomplete second again */
+  len = pt_sample_store_get_length (priv->hires);
+  priv->hires_index = len - len % 8000;
+  priv->lowres_index = priv->hires_index / 8000 * priv->pps * 2;
+
+  g_cancellable_reset (priv->follow_cancel);
+  g_atomic_int_set (&priv->follow_done, FALSE);
+  priv->follow_thread = g_thread_new ("pt-follow", follow_update_real, self);
+  priv->follow_timeout = timeout_add (30, (GSourceFunc) check_follow_progress, self);
+}
+
+static void
+follow_stop (PtWaveloader *self)
+{
+  /* Stops a running update, it ends after the current buffer. Data added
+   * so far is kept, the update will be resumed by follow_resume(). */
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  if (!priv->follow_thread)
+    return;
+
+  g_cancellable_cancel (priv->follow_cancel);
+  follow_finish (self);
+  priv->follow_again = TRUE;
 }
 
-static gboolean
-bus_handler (GstBus     *bus,
-             GstMessage *msg,
-             gpointer    data)
+static void
+follow_resume (PtWaveloader *self)
 {
-  GTask               *task = (GTask *) data;
-  PtWaveloader        *self = g_task_get_source_object (task);
   PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
 
-  switch (GST_MESSAGE_TYPE (msg))
-    {
-    case GST_MESSAGE_ERROR:
-      {
-        gchar  *debug;
-        GError *error;
+  if (priv->monitor && priv->follow_again)
+    follow_update (self);
+}
 
-        g_clear_handle_id (&priv->progress_timeout, g_source_remove);
-        gst_message_parse_error (msg, &error, &debug);
+static void
+file_changed_cb (GFileMonitor     *monitor,
+                 GFile            *file,
+                 GFile            *other_file,
+                 GFileMonitorEvent event,
+                 PtWaveloader     *self)
+{
+  if (event == G_FILE_MONITOR_EVENT_CHANGED ||
+      event == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
+    follow_update (self);
+}
 
-        /* Error is returned. Log the message here at level DEBUG,
-           as higher levels will abort tests. */
+static void
+follow_start (PtWaveloader *self)
+{
+  /* Watches the file after a successful load, in case it grew while it
+   * was loaded it’s updated at once */
 
-        g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
-                          "MESSAGE", "Error from element %s: %s", GST_OBJECT_NAME (msg->src), error->message);
-        g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
-                          "MESSAGE", "Debugging info: %s", (debug) ? debug : "none");
-        g_free (debug);
-        priv->bus_watch_id = 0;
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        return FALSE;
-      }
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  GFile               *file;
+  GError              *error = NULL;
 
-    case GST_MESSAGE_EOS:
-      {
+  if (priv->monitor || priv->bounded || !priv->uri)
+    return;
 
-        /* convert remaining data from hires to lowres */
-        g_array_set_size (priv->lowres, calc_lowres_len (priv->hires->len, priv->pps));
+  file = g_file_new_for_uri (priv->uri);
+  priv->monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, &error);
+  g_object_unref (file);
 
-        /* while hires has more full seconds than lowres ... */
-        while (priv->hires->len > priv->hires_index)
-          {
-            convert_one_second (priv->hires,
-                                priv->lowres,
-                                &priv->hires_index,
-                                &priv->lowres_index,
-                                priv->pps);
-          }
+  if (!priv->monitor)
+    {
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO,
+                        "MESSAGE", "File can’t be followed: %s", error->message);
+      g_error_free (error);
+      return;
+    }
 
-        /* query length and convert to samples */
-        if (!gst_element_query_duration (priv->pipeline, GST_FORMAT_TIME, &priv->duration))
-          {
-            GST_WARNING ("getting sample duration failed");
-          }
+  unshare_data (self);
+  g_signal_connect (priv->monitor, "changed", G_CALLBACK (file_changed_cb), self);
+  follow_update (self);
+}
 
-        g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
-                          "MESSAGE", "Sample decoded: hires->len=%d, lowres->len=%d, pps=%d, duration=%" GST_TIME_FORMAT,
-                          priv->hires->len, priv->lowres->len, priv->pps, GST_TIME_ARGS (priv->duration));
+static void
+follow_clear (PtWaveloader *self)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
 
-        g_clear_handle_id (&priv->progress_timeout, g_source_remove);
-        priv->bus_watch_id = 0;
-        g_task_return_boolean (task, TRUE);
-        g_object_unref (task);
-        return FALSE;
-      }
-    case GST_MESSAGE_DURATION_CHANGED:
-      {
-        gst_element_query_duration (priv->pipeline, GST_FORMAT_TIME, &priv->duration);
-        gint new_size;
-        new_size = priv->duration / 1000000000 * priv->pps * 2;
-        g_array_set_size (priv->lowres, new_size);
-        g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
-                          "MESSAGE", "Duration changed signal: %" GST_TIME_FORMAT " lowres resized to len %d",
-                          GST_TIME_ARGS (priv->duration), new_size);
-        g_signal_emit_by_name (self, "array-size-changed");
-        break;
-      }
-    default:
-      break;
-    }
+  follow_stop (self);
+  priv->follow_again = FALSE;
 
-  return TRUE;
+  if (priv->monitor)
+    {
+      g_signal_handlers_disconnect_by_data (priv->monitor, self);
+      g_file_monitor_cancel (priv->monitor);
+      g_clear_object (&priv->monitor);
+    }
 }
 
 /**
@@ -461,10 +2492,15 @@ pt_waveloader_load_finish (PtWaveloader *self,
 {
   g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
   PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  gboolean             success;
 
   priv->load_pending = FALSE;
   g_signal_emit_by_name (self, "progress", result ? 1.0 : 0.0);
-  return g_task_propagate_boolean (G_TASK (result), error);
+  success = g_task_propagate_boolean (G_TASK (result), error);
+  if (success && priv->follow)
+    follow_start (self);
+
+  return success;
 }
 
 /**
@@ -477,13 +2513,34 @@ pt_waveloader_load_finish (PtWaveloader *self,
  *
  * Saves sample data to private memory. To keep the memory footprint low, the
  * raw data is downsampled to 8000 samples per second (16 bit per sample). This
- * requires approx. 1 MB of memory per minute.
+ * requires approx. 1 MB of memory per minute. An index for fast resizing
+ * needs another 0.5 MB per minute. With #PtWaveloader:bounded-memory raw data
+ * is dropped and only a compact index is kept, using approx. 120 kB per
+ * minute or 60 kB with #PtWaveloader:quantize-peaks.
  *
  * #PtWaveloader:uri must be set. If it is not valid, an error will be returned.
  * If there is another load operation going on, an error will be returned.
  *
  * While saving data #PtWaveloader::progress is emitted every 30 ms.
  *
+ * If #PtWaveloader:cache is TRUE and the file was decoded before, data is
+ * loaded from the cache instead. That saves decoding, but samples are still
+ * read and processed, for long files it takes a while, too. Cache files are
+ * read and written in a thread.
+ *
+ * If #PtWaveloader:shared is TRUE and another loader has loaded the same
+ * file or is still loading it, its data is used instead. No progress is
+ * emitted while waiting for the other loader.
+ *
+ * Local uncompressed WAV (including BWF and RF64) and AIFF files are read
+ * directly, without decoding. Their peaks are taken from all samples at the
+ * file’s own rate, so they can be slightly higher than from other files.
+ *
+ * If #PtWaveloader:segments is not 1, parts of the file are decoded in
+ * parallel. Data is then not available in order, progress is the share of
+ * decoded data. If the duration is unknown, the file is decoded from start
+ * to end.
+ *
  * In your callback call #pt_waveloader_load_finish to get the result of the
  * operation.
  *
@@ -503,8 +2560,7 @@ pt_waveloader_load_async (PtWaveloader       *self,
   PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
   g_return_if_fail (priv->uri != NULL);
 
-  GTask  *task;
-  GstBus *bus;
+  GTask *task;
 
   task = g_task_new (self, cancellable, callback, user_data);
   /* Lets have an initial size of 60 sec */
@@ -513,7 +2569,7 @@ pt_waveloader_load_async (PtWaveloader       *self,
   priv->lowres_index = 0;
   priv->hires_index = 0;
 
-  if (priv->load_pending)
+  if (priv->load_pending || priv->resize_threads > 0)
     {
       g_task_return_new_error (
           task,
@@ -524,11 +2580,76 @@ pt_waveloader_load_async (PtWaveloader       *self,
       return;
     }
 
+  follow_clear (self);
   priv->load_pending = TRUE;
   priv->progress = 0;
-  g_array_set_size (priv->hires, 0);
+  priv->duration = 0;
+  discard_peaks (self);
+  start_load (self, task);
+}
+
+static void
+start_load (PtWaveloader *self,
+            GTask        *task)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  attach_data (self);
+
+  if (!priv->data_owner)
+    {
+      priv->progress_timeout = timeout_add (30, (GSourceFunc) check_shared_progress, task);
+      return;
+    }
+
+  /* Others may be waiting for the data, tell them when it’s done */
+  if (pt_peak_data_is_shared (priv->data))
+    {
+      GTask *shared_task;
+
+      shared_task = g_task_new (self, g_task_get_cancellable (task),
+                                (GAsyncReadyCallback) shared_load_cb, task);
+      task = shared_task;
+    }
+
+  if (priv->use_cache)
+    {
+      load_from_cache (self, task);
+      return;
+    }
+
+  start_decoding (self, task);
+}
+
+static void
+start_decoding (PtWaveloader *self,
+                GTask        *task)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  if (load_pcm (self, task))
+    return;
+
+  if (priv->n_segments != 1)
+    {
+      load_parallel (self, task);
+      return;
+    }
+
+  load_pipeline (self, task);
+}
+
+static void
+load_pipeline (PtWaveloader *self,
+               GTask        *task)
+{
+  /* Decodes the file with a single pipeline, samples are added in the
+   * streaming thread */
 
-  /* setup pipeline TODO: do it just on init */
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  GstBus              *bus;
+
+  decimator_start (&priv->decimator, 8000, FALSE, 0);
   if (!setup_pipeline (self))
     {
       g_task_return_new_error (
@@ -543,13 +2664,13 @@ pt_waveloader_load_async (PtWaveloader       *self,
 
   /* setup message handler */
   bus = gst_pipeline_get_bus (GST_PIPELINE (priv->pipeline));
-  priv->bus_watch_id = gst_bus_add_watch (bus, bus_handler, task);
+  priv->bus_watch = bus_watch_add (bus, bus_handler, task);
   gst_object_unref (bus);
 
   /* Run pipeline and start timeout for progress and cancellation.
    * Errors are reported on bus. */
   gst_element_set_state (priv->pipeline, GST_STATE_PLAYING);
-  priv->progress_timeout = g_timeout_add (30, (GSourceFunc) check_progress, task);
+  priv->progress_timeout = timeout_add (30, (GSourceFunc) check_progress, task);
 }
 
 /**
@@ -592,6 +2713,7 @@ pt_waveloader_resize_finish (PtWaveloader *self,
 
   PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
   priv->data_pending = FALSE;
+  follow_resume (self);
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
@@ -601,107 +2723,342 @@ pt_waveloader_resize_real (GTask        *task,
                            gpointer      task_data,
                            GCancellable *cancellable)
 {
-  PtWaveloader        *self = source_object;
+  PtWaveloader        *self = source_object;
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  gint                 pps = GPOINTER_TO_INT (task_data);
+  uint                 n_samples;
+  uint                 lowres_len;
+  gboolean             result;
+
+  n_samples = pt_sample_store_get_length (priv->hires);
+  lowres_len = calc_lowres_len (n_samples, pps);
+  if (priv->lowres == NULL || priv->lowres->len != lowres_len)
+    {
+      g_array_set_size (priv->lowres, lowres_len);
+      g_signal_emit_by_name (self, "array-size-changed");
+    }
+
+  result = convert_from_pyramid (priv->pyramid,
+                                 priv->bounded ? NULL : priv->hires,
+                                 n_samples,
+                                 (float *) priv->lowres->data,
+                                 pps,
+                                 0,
+                                 lowres_len / 2,
+                                 cancellable);
+
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                    "MESSAGE", "raw samples: %d", n_samples);
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                    "MESSAGE", "Array size: %" G_GINT64_FORMAT " ",
+                    lowres_len);
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                    "MESSAGE", "samples: %" G_GINT64_FORMAT " ",
+                    lowres_len / 2);
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                    "MESSAGE", "pixels per sec: %d", pps);
+
+  g_task_return_boolean (task, result);
+}
+
+/**
+ * pt_waveloader_resize_async:
+ * @self: a #PtWaveloader
+ * @pps: the requested pixel per second ratio
+ * @cancellable: (nullable): a #GCancellable or NULL
+ * @callback: (scope async) (closure user_data): a #GAsyncReadyCallback to call when the operation is complete
+ * @user_data: user_data for @callback
+ *
+ * Resizes wave form data at the requested resolution @pps. If the array's
+ * size has to be changed, #PtWaveloader::array-size-changed is emitted.
+ * Any data in the array will be overwritten.
+ *
+ * The resolution is given as pixel per seconds, e.g. 100 means one second
+ * is represented by 100 samples, is 100 pixels wide. @pps must be >= 1 and <= 8000.
+
+ *
+ * Resizing doesn't scan the raw data again, the values are taken from an index
+ * that is built while loading. The cost depends on the size of the resulting
+ * array, not on the duration of the file.
+ *
+ * You should have loaded a file with #pt_waveloader_load_async before resizing
+ * it. There are no concurrent operations allowed. An error is returned,
+ * if the file was not loaded before, if it is still loading or if there is
+ * another #pt_waveloader_get_data_async operation going on.
+ *
+ * Cancelling the operation returns an error and lets the array in an inconsistent
+ * state. Its size will be according to the requested new resolution, but the data
+ * will be partly old, partly new.
+ *
+ * In your callback call #pt_waveloader_get_data_finish to get the result of the
+ * operation.
+ *
+ * Since: 2.0
+ */
+void
+pt_waveloader_resize_async (PtWaveloader       *self,
+                            gint                pps,
+                            GCancellable       *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer            user_data)
+{
+  g_return_if_fail (PT_IS_WAVELOADER (self));
+  g_return_if_fail ((pps >= 1) && (pps <= 8000));
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  GTask               *task;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  if (pt_sample_store_get_length (priv->hires) == 0)
+    {
+      g_task_return_new_error (
+          task,
+          GST_CORE_ERROR,
+          GST_CORE_ERROR_FAILED,
+          /* error message not for users, maybe
+           * g_return_if_fail() would be better here. */
+          "No Array!");
+      g_object_unref (task);
+      return;
+    }
+  if (priv->load_pending || priv->data_pending || priv->resize_threads > 0)
+    {
+      g_task_return_new_error (
+          task,
+          GST_CORE_ERROR,
+          GST_CORE_ERROR_FAILED,
+          /* error message not for users, should be
+           * handled by application */
+          "Waveloader has outstanding operation.");
+      g_object_unref (task);
+      return;
+    }
+
+  follow_stop (self);
+  priv->data_pending = TRUE;
+  priv->pps = pps;
+  g_task_set_task_data (task, GINT_TO_POINTER (pps), NULL);
+  g_task_run_in_thread (task, pt_waveloader_resize_real);
+  g_object_unref (task);
+}
+
+/* ------------------------- Progressive resize ----------------------------- */
+
+/* pt_waveloader_resize_range_async() computes a priority range, usually the
+ * visible part of a waveform, immediately in the main thread. The rest is
+ * computed in a thread in chunks, alternating right and left of the
+ * priority range, and handed over to the main thread like during loading.
+ * A new progressive resize supersedes a running one. */
+
+struct _ResizeLoad
+{
+  GTask        *task; /* the caller’s task */
+  GCancellable *cancellable;
+  GAsyncQueue  *chunks;
+  gint          pps;
+  uint          n_samples;
+  uint          n_pairs;
+  uint          first; /* priority range, in min/max pairs */
+  uint          last;
+};
+
+static void
+resize_load_free (ResizeLoad *load)
+{
+  g_clear_object (&load->task);
+  g_object_unref (load->cancellable);
+  g_async_queue_unref (load->chunks);
+  g_free (load);
+}
+
+static gboolean
+resize_chunk (PtWaveloader *self,
+              ResizeLoad   *load,
+              uint          first,
+              uint          last)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  PeakChunk           *chunk;
+  GCancellable        *caller_cancellable = g_task_get_cancellable (load->task);
+
+  if (g_cancellable_is_cancelled (load->cancellable) || g_cancellable_is_cancelled (caller_cancellable))
+    return FALSE;
+
+  chunk = g_new (PeakChunk, 1);
+  chunk->index = first * 2;
+  chunk->peaks = g_array_sized_new (FALSE, FALSE, sizeof (float), (last - first) * 2);
+  g_array_set_size (chunk->peaks, (last - first) * 2);
+  convert_from_pyramid (priv->pyramid,
+                        priv->bounded ? NULL : priv->hires,
+                        load->n_samples,
+                        (float *) chunk->peaks->data,
+                        load->pps,
+                        first,
+                        last,
+                        NULL);
+  g_async_queue_push (load->chunks, chunk);
+
+  return TRUE;
+}
+
+static void
+resize_range_real (GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+  PtWaveloader *self = source_object;
+  ResizeLoad   *load = task_data;
+  uint          right = load->last;
+  uint          left = load->first;
+  uint          next;
+
+  while (right < load->n_pairs || left > 0)
+    {
+      if (right < load->n_pairs)
+        {
+          next = MIN (right + RESIZE_CHUNK_SIZE, load->n_pairs);
+          if (!resize_chunk (self, load, right, next))
+            break;
+          right = next;
+        }
+
+      if (left > 0)
+        {
+          next = left - MIN (left, RESIZE_CHUNK_SIZE);
+          if (!resize_chunk (self, load, next, left))
+            break;
+          left = next;
+        }
+    }
+
+  g_task_return_boolean (task, right == load->n_pairs && left == 0);
+}
+
+static gboolean
+check_resize_progress (PtWaveloader *self)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  if (priv->resize)
+    publish_chunks (self, priv->resize->chunks);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+resize_range_cb (GObject      *source_object,
+                 GAsyncResult *res,
+                 gpointer      user_data)
+{
+  PtWaveloader        *self = PT_WAVELOADER (source_object);
   PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
-  gint                 pps = GPOINTER_TO_INT (task_data);
-  uint                 lowres_len;
-  uint                 index_in = 0;
-  uint                 index_out = 0;
-  gboolean             result = TRUE;
+  ResizeLoad          *load = user_data;
 
-  lowres_len = calc_lowres_len (priv->hires->len, pps);
-  if (priv->lowres == NULL || priv->lowres->len != lowres_len)
+  priv->resize_threads -= 1;
+  if (priv->resize_threads == 0)
+    follow_resume (self);
+
+  /* A superseded resize has returned its task already */
+  if (load != priv->resize)
     {
-      g_array_set_size (priv->lowres, lowres_len);
-      g_signal_emit_by_name (self, "array-size-changed");
+      resize_load_free (load);
+      return;
     }
 
-  while (priv->hires->len > index_in)
+  priv->resize = NULL;
+  g_clear_pointer (&priv->resize_timeout, source_remove);
+
+  if (g_task_propagate_boolean (G_TASK (res), NULL))
     {
+      publish_chunks (self, load->chunks);
+      g_task_return_boolean (load->task, TRUE);
+    }
+  else
+    {
+      g_task_return_new_error (load->task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_CANCELLED,
+                               _ ("Resize cancelled."));
+    }
 
-      if (g_cancellable_is_cancelled (cancellable))
-        {
-          result = FALSE;
-          break;
-        }
+  resize_load_free (load);
+}
 
-      convert_one_second (priv->hires,
-                          priv->lowres,
-                          &index_in,
-                          &index_out,
-                          pps);
-    }
+static void
+supersede_resize (PtWaveloader *self)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  ResizeLoad          *load = priv->resize;
 
-  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
-                    "MESSAGE", "hires->len: %d", priv->hires->len);
-  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
-                    "MESSAGE", "Array size: %" G_GINT64_FORMAT " ",
-                    lowres_len);
-  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
-                    "MESSAGE", "samples: %" G_GINT64_FORMAT " ",
-                    lowres_len / 2);
-  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
-                    "MESSAGE", "pixels per sec: %d", pps);
-  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
-                    "MESSAGE", "index_in: %d", index_in);
-  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
-                    "MESSAGE", "index_out: %d", index_out);
+  if (!load)
+    return;
 
-  g_task_return_boolean (task, result);
+  /* The thread might still run for a short while, its chunks are not
+   * published any more. Its data is freed in resize_range_cb(). */
+  g_cancellable_cancel (load->cancellable);
+  g_task_return_new_error (load->task,
+                           G_IO_ERROR,
+                           G_IO_ERROR_CANCELLED,
+                           _ ("Resize superseded."));
+  g_clear_object (&load->task);
+  priv->resize = NULL;
 }
 
 /**
- * pt_waveloader_resize_async:
+ * pt_waveloader_resize_range_async:
  * @self: a #PtWaveloader
  * @pps: the requested pixel per second ratio
+ * @first: index of the first min/max pair to compute first
+ * @last: index after the last min/max pair to compute first
  * @cancellable: (nullable): a #GCancellable or NULL
  * @callback: (scope async) (closure user_data): a #GAsyncReadyCallback to call when the operation is complete
  * @user_data: user_data for @callback
  *
- * Resizes wave form data at the requested resolution @pps. If the array's
- * size has to be changed, #PtWaveloader::array-size-changed is emitted.
- * Any data in the array will be overwritten.
- *
- * The resolution is given as pixel per seconds, e.g. 100 means one second
- * is represented by 100 samples, is 100 pixels wide. @pps must be >= 25 and <= 200.
- *
- * You should have loaded a file with #pt_waveloader_load_async before resizing
- * it. There are no concurrent operations allowed. An error is returned,
- * if the file was not loaded before, if it is still loading or if there is
- * another #pt_waveloader_get_data_async operation going on.
+ * Like #pt_waveloader_resize_async, but computes the range from @first to
+ * @last at the new resolution before anything else, e.g. the visible part of
+ * a waveform. The array is resized and the range is computed before this
+ * function returns, #PtWaveloader::array-size-changed and
+ * #PtWaveloader::data-available are emitted for it.
  *
- * Cancelling the operation returns an error and lets the array in an inconsistent
- * state. Its size will be according to the requested new resolution, but the data
- * will be partly old, partly new.
+ * The rest of the array is computed in the background, starting next to
+ * the range. Until #PtWaveloader::data-available is emitted for them, other
+ * parts of the array contain outdated data. The range is clamped to the
+ * size of the array.
  *
- * In your callback call #pt_waveloader_get_data_finish to get the result of the
- * operation.
+ * A new call supersedes an outstanding progressive resize: its callback is
+ * called with a %G_IO_ERROR_CANCELLED error and the new resize starts
+ * immediately. Other operations are not allowed while a progressive resize
+ * is going on. Use #pt_waveloader_resize_finish in your callback.
  *
- * Since: 2.0
+ * Since: 4.3
  */
 void
-pt_waveloader_resize_async (PtWaveloader       *self,
-                            gint                pps,
-                            GCancellable       *cancellable,
-                            GAsyncReadyCallback callback,
-                            gpointer            user_data)
+pt_waveloader_resize_range_async (PtWaveloader       *self,
+                                  gint                pps,
+                                  gint                first,
+                                  gint                last,
+                                  GCancellable       *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer            user_data)
 {
   g_return_if_fail (PT_IS_WAVELOADER (self));
-  g_return_if_fail ((pps >= 25) && (pps <= 200));
+  g_return_if_fail ((pps >= 1) && (pps <= 8000));
 
   PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
   GTask               *task;
+  GTask               *thread_task;
+  ResizeLoad          *load;
+  uint                 lowres_len;
 
   task = g_task_new (self, cancellable, callback, user_data);
-  if (priv->hires->len == 0)
+  if (pt_sample_store_get_length (priv->hires) == 0)
     {
       g_task_return_new_error (
           task,
           GST_CORE_ERROR,
           GST_CORE_ERROR_FAILED,
-          /* error message not for users, maybe
-           * g_return_if_fail() would be better here. */
-          "No Array!");
+          _ ("No file loaded."));
       g_object_unref (task);
       return;
     }
@@ -711,17 +3068,59 @@ pt_waveloader_resize_async (PtWaveloader       *self,
           task,
           GST_CORE_ERROR,
           GST_CORE_ERROR_FAILED,
-          /* error message not for users, should be
-           * handled by application */
-          "Waveloader has outstanding operation.");
+          _ ("Waveloader has outstanding operation."));
       g_object_unref (task);
       return;
     }
 
-  priv->data_pending = TRUE;
-  g_task_set_task_data (task, GINT_TO_POINTER (pps), NULL);
-  g_task_run_in_thread (task, pt_waveloader_resize_real);
-  g_object_unref (task);
+  follow_stop (self);
+  supersede_resize (self);
+  priv->pps = pps;
+
+  load = g_new0 (ResizeLoad, 1);
+  load->task = task;
+  load->cancellable = g_cancellable_new ();
+  load->chunks = g_async_queue_new_full (peak_chunk_free);
+  load->pps = pps;
+  load->n_samples = pt_sample_store_get_length (priv->hires);
+  lowres_len = calc_lowres_len (load->n_samples, pps);
+  load->n_pairs = lowres_len / 2;
+  load->last = CLAMP (last, 0, (gint) load->n_pairs);
+  load->first = CLAMP (first, 0, (gint) load->last);
+
+  /* Priority range */
+  if (priv->lowres->len != lowres_len)
+    {
+      g_array_set_size (priv->lowres, lowres_len);
+      g_signal_emit_by_name (self, "array-size-changed");
+    }
+  g_mutex_lock (&priv->follow_lock);
+  convert_from_pyramid (priv->pyramid,
+                        priv->bounded ? NULL : priv->hires,
+                        load->n_samples,
+                        &g_array_index (priv->lowres, float, load->first * 2),
+                        pps,
+                        load->first,
+                        load->last,
+                        NULL);
+  g_mutex_unlock (&priv->follow_lock);
+  if (load->first < load->last)
+    g_signal_emit (self, signals[DATA_AVAILABLE], 0, load->first * 2, load->last * 2);
+
+  g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+                    "MESSAGE", "Progressive resize to %d pps, priority range %u-%u of %u",
+                    pps, load->first, load->last, load->n_pairs);
+
+  /* Background */
+  priv->resize = load;
+  priv->resize_threads += 1;
+  thread_task = g_task_new (self, load->cancellable, resize_range_cb, load);
+  g_task_set_task_data (thread_task, load, NULL);
+  g_task_run_in_thread (thread_task, resize_range_real);
+  g_object_unref (thread_task);
+
+  if (!priv->resize_timeout)
+    priv->resize_timeout = timeout_add (30, (GSourceFunc) check_resize_progress, self);
 }
 
 typedef struct
@@ -758,7 +3157,7 @@ pt_waveloader_resize (PtWaveloader *self,
                       GError      **error)
 {
   g_return_val_if_fail (PT_IS_WAVELOADER (self), FALSE);
-  g_return_val_if_fail ((pps >= 25) && (pps <= 200), FALSE);
+  g_return_val_if_fail ((pps >= 1) && (pps <= 8000), FALSE);
   g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
   gboolean      result;
@@ -808,6 +3207,255 @@ pt_waveloader_get_data (PtWaveloader *self)
   PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
   return priv->lowres;
 }
+
+/**
+ * pt_waveloader_get_bytes:
+ * @self: a #PtWaveloader
+ * @start_index: index of the first value
+ * @end_index: index after the last value, -1 for the end of the array
+ *
+ * Returns a copy of a range of the array of pt_waveloader_get_data(), e.g.
+ * for language bindings that can wrap a #GBytes as a buffer. The data are
+ * floats in native byte order, alternating minimum and maximum. Indexes are
+ * clamped to the array’s length.
+ *
+ * The bytes are a snapshot, later loads, resizes and updates don’t change
+ * them.
+ *
+ * Return value: (transfer full): a #GBytes with the values
+ *
+ * Since: 4.3
+ */
+GBytes *
+pt_waveloader_get_bytes (PtWaveloader *self,
+                         gint          start_index,
+                         gint          end_index)
+{
+  g_return_val_if_fail (PT_IS_WAVELOADER (self), NULL);
+  g_return_val_if_fail (start_index >= 0, NULL);
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  guint                start;
+  guint                end;
+
+  end = end_index < 0 ? priv->lowres->len : MIN ((guint) end_index, priv->lowres->len);
+  start = MIN ((guint) start_index, end);
+
+  return g_bytes_new ((float *) priv->lowres->data + start,
+                      (end - start) * sizeof (float));
+}
+
+/**
+ * pt_waveloader_get_peaks:
+ * @self: a #PtWaveloader
+ * @start: start of the range in nanoseconds
+ * @end: end of the range in nanoseconds
+ * @n_bins: number of min/max pairs to compute
+ * @out: (out caller-allocates) (array): return location for 2 × @n_bins
+ * floats
+ *
+ * Computes @n_bins min/max pairs for the time range from @start to @end, in
+ * the same format as the array returned by pt_waveloader_get_data(). Each
+ * pair covers an equal part of the range, any resolution is possible, from
+ * a single pair for the whole file up to several pairs per sample. The
+ * waveform is stored with 8000 samples per second; if a pair covers less
+ * than one sample, it shows the sample at its position.
+ *
+ * The values are taken from the index that is used for resizing, the cost
+ * depends on @n_bins, not on the length of the range. Pairs after the end
+ * of the file are set to 0. With #PtWaveloader:bounded-memory the values
+ * are not exact, but never smaller than the real minimum and maximum.
+ *
+ * The file must be loaded completely before.
+ *
+ * Return value: TRUE if successful, FALSE if there is no data or the file
+ * is still loading
+ *
+ * Since: 4.3
+ */
+gboolean
+pt_waveloader_get_peaks (PtWaveloader *self,
+                         gint64        start,
+                         gint64        end,
+                         gint          n_bins,
+                         gfloat       *out)
+{
+  g_return_val_if_fail (PT_IS_WAVELOADER (self), FALSE);
+  g_return_val_if_fail (start >= 0 && start <= end, FALSE);
+  g_return_val_if_fail (n_bins >= 0, FALSE);
+  g_return_val_if_fail (out != NULL || n_bins == 0, FALSE);
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  guint64              n_samples;
+  guint64              first, last;
+  guint64              bin_start, bin_end;
+  gint16               dmin, dmax;
+
+  if (priv->load_pending)
+    return FALSE;
+
+  /* A followed file might grow meanwhile */
+  g_mutex_lock (&priv->follow_lock);
+  n_samples = pt_sample_store_get_length (priv->hires);
+  if (n_samples == 0)
+    {
+      g_mutex_unlock (&priv->follow_lock);
+      return FALSE;
+    }
+
+  first = gst_util_uint64_scale (start, 8000, GST_SECOND);
+  last = gst_util_uint64_scale (end, 8000, GST_SECOND);
+
+  for (gint i = 0; i < n_bins; i++)
+    {
+      bin_start = first + gst_util_uint64_scale (last - first, i, n_bins);
+      bin_end = first + gst_util_uint64_scale (last - first, i + 1, n_bins);
+
+      /* Less than one sample per bin */
+      if (bin_end <= bin_start)
+        bin_end = bin_start + 1;
+      bin_end = MIN (bin_end, n_samples);
+
+      /* Always include 0, as in the array */
+      dmin = 0;
+      dmax = 0;
+      if (bin_start < bin_end)
+        pt_peak_pyramid_get_range (priv->pyramid,
+                                   priv->bounded ? NULL : priv->hires,
+                                   bin_start, bin_end,
+                                   &dmin, &dmax);
+
+      out[i * 2] = dmin / 32768.0;
+      out[i * 2 + 1] = dmax / 32768.0;
+    }
+  g_mutex_unlock (&priv->follow_lock);
+
+  return TRUE;
+}
+
+/**
+ * pt_waveloader_get_memory_usage:
+ * @self: a #PtWaveloader
+ *
+ * Returns the memory currently used for waveform data: raw samples, the
+ * index for resizing and the array returned by pt_waveloader_get_data().
+ * Applications can use this to choose #PtWaveloader:bounded-memory for long
+ * files. With #PtWaveloader:shared raw samples and index are counted by each
+ * loader that uses them.
+ *
+ * Return value: memory usage in bytes
+ *
+ * Since: 4.3
+ */
+gsize
+pt_waveloader_get_memory_usage (PtWaveloader *self)
+{
+  g_return_val_if_fail (PT_IS_WAVELOADER (self), 0);
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+  gsize                size;
+
+  g_mutex_lock (&priv->follow_lock);
+  size = pt_sample_store_get_size (priv->hires) +
+         (gsize) priv->lowres->len * sizeof (float) +
+         pt_peak_pyramid_get_size (priv->pyramid);
+  g_mutex_unlock (&priv->follow_lock);
+
+  return size;
+}
+
+/* ------------------------- Loader pool ------------------------------------ */
+
+/* Idle loaders, shared by all waveviewers of the process. Their pipeline is
+ * kept in READY state, so that the next file doesn’t need a new one.
+ * Ownership is handed over explicitly: a loader that is acquired belongs to
+ * the caller, it must not give out references. Loaders that were not
+ * acquired from the pool are never put into it. */
+
+G_LOCK_DEFINE_STATIC (pool);
+static GQueue pool = G_QUEUE_INIT;
+
+/* Returns an idle loader from the pool or a new one, with no URI and
+ * default properties. The caller owns the reference. */
+PtWaveloader *
+_pt_waveloader_pool_acquire (void)
+{
+  PtWaveloader *loader;
+
+  G_LOCK (pool);
+  loader = g_queue_pop_head (&pool);
+  G_UNLOCK (pool);
+
+  if (!loader)
+    loader = pt_waveloader_new (NULL);
+
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (loader);
+  priv->pooled = TRUE;
+
+  return loader;
+}
+
+/* Takes over a loader and the caller’s reference. If it was acquired from
+ * the pool, is idle and the pool is not full, its data is freed and it’s kept
+ * for the next caller of _pt_waveloader_pool_acquire(), otherwise it’s
+ * unreferenced. The caller has to disconnect its signal handlers before and
+ * must not use the loader any more. */
+void
+_pt_waveloader_pool_release (PtWaveloader *loader)
+{
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (loader);
+  gboolean             keep;
+
+  if (!priv->pooled || priv->load_pending || priv->data_pending ||
+      priv->resize_threads > 0)
+    {
+      g_object_unref (loader);
+      return;
+    }
+
+  follow_clear (loader);
+  discard_peaks (loader);
+  detach_data (loader);
+  g_clear_pointer (&priv->uri, g_free);
+  priv->duration = 0;
+  priv->use_cache = FALSE;
+  priv->cache_max_size = CACHE_MAX_SIZE;
+  priv->n_segments = 1;
+  priv->bounded = FALSE;
+  priv->quantize = FALSE;
+  priv->follow = FALSE;
+  priv->shared = FALSE;
+
+  /* Nobody else uses the array, free it instead of keeping its
+   * allocated size */
+  g_array_unref (priv->lowres);
+  priv->lowres = g_array_new (FALSE, TRUE, sizeof (float));
+
+  G_LOCK (pool);
+  keep = g_queue_get_length (&pool) < POOL_SIZE;
+  if (keep)
+    g_queue_push_head (&pool, loader);
+  G_UNLOCK (pool);
+
+  if (!keep)
+    g_object_unref (loader);
+}
+
+/* Frees all idle loaders, e.g. at the end of tests, so that leak checkers
+ * don’t report them */
+void
+_pt_waveloader_pool_clear (void)
+{
+  GQueue idle = G_QUEUE_INIT;
+
+  G_LOCK (pool);
+  idle = pool;
+  g_queue_init (&pool);
+  G_UNLOCK (pool);
+
+  g_queue_clear_full (&idle, g_object_unref);
+}
+
 /* --------------------- Init and GObject management ------------------------ */
 
 static void
@@ -826,12 +3474,29 @@ pt_waveloader_init (PtWaveloader *self)
 
   priv->pipeline = NULL;
   priv->uri = NULL;
-  priv->hires = g_array_new (FALSE, /* zero terminated */
-                             TRUE,  /* clear to zero   */
-                             sizeof (gint16));
+  priv->data = NULL;
+  set_data (self, pt_peak_data_new (), TRUE);
+  priv->shared = FALSE;
   priv->lowres = g_array_new (FALSE, TRUE, sizeof (float));
+  priv->chunks = g_async_queue_new_full (peak_chunk_free);
   priv->load_pending = FALSE;
   priv->data_pending = FALSE;
+  priv->resize = NULL;
+  priv->resize_threads = 0;
+  priv->resize_timeout = NULL;
+  priv->use_cache = FALSE;
+  priv->cache_max_size = CACHE_MAX_SIZE;
+  priv->cache = pt_peak_cache_new ();
+  priv->n_segments = 1;
+  priv->parallel = NULL;
+  priv->pcm = NULL;
+  priv->bounded = FALSE;
+  priv->quantize = FALSE;
+  priv->follow = FALSE;
+  priv->monitor = NULL;
+  priv->follow_thread = NULL;
+  priv->follow_cancel = g_cancellable_new ();
+  g_mutex_init (&priv->follow_lock);
 }
 
 static void
@@ -840,14 +3505,12 @@ pt_waveloader_dispose (GObject *object)
   PtWaveloader        *self = PT_WAVELOADER (object);
   PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
 
-  g_free (priv->uri);
-
-  g_array_unref (priv->hires);
-  g_array_unref (priv->lowres);
-
-  g_clear_handle_id (&priv->bus_watch_id, g_source_remove);
-  g_clear_handle_id (&priv->progress_timeout, g_source_remove);
+  /* Stop the update thread before freeing its data */
+  follow_clear (self);
+  g_clear_object (&priv->follow_cancel);
+  g_clear_pointer (&priv->uri, g_free);
 
+  /* Stop the streaming thread before freeing its data */
   if (priv->pipeline)
     {
       gst_element_set_state (priv->pipeline, GST_STATE_NULL);
@@ -855,9 +3518,32 @@ pt_waveloader_dispose (GObject *object)
       priv->pipeline = NULL;
     }
 
+  g_clear_pointer (&priv->data, pt_peak_data_unref);
+  priv->hires = NULL;
+  priv->pyramid = NULL;
+  g_array_unref (priv->lowres);
+  g_clear_pointer (&priv->chunks, g_async_queue_unref);
+  g_clear_object (&priv->cache);
+  decimator_clear (&priv->decimator);
+
+  g_clear_pointer (&priv->bus_watch, source_remove);
+  g_clear_pointer (&priv->progress_timeout, source_remove);
+  g_clear_pointer (&priv->resize_timeout, source_remove);
+
   G_OBJECT_CLASS (pt_waveloader_parent_class)->dispose (object);
 }
 
+static void
+pt_waveloader_finalize (GObject *object)
+{
+  PtWaveloader        *self = PT_WAVELOADER (object);
+  PtWaveloaderPrivate *priv = pt_waveloader_get_instance_private (self);
+
+  g_mutex_clear (&priv->follow_lock);
+
+  G_OBJECT_CLASS (pt_waveloader_parent_class)->finalize (object);
+}
+
 static void
 pt_waveloader_set_property (GObject      *object,
                             guint         property_id,
@@ -870,9 +3556,35 @@ pt_waveloader_set_property (GObject      *object,
   switch (property_id)
     {
     case PROP_URI:
+      follow_clear (self);
       g_free (priv->uri);
       priv->uri = g_value_dup_string (value);
       break;
+    case PROP_CACHE:
+      priv->use_cache = g_value_get_boolean (value);
+      break;
+    case PROP_CACHE_MAX_SIZE:
+      priv->cache_max_size = g_value_get_uint64 (value);
+      break;
+    case PROP_SEGMENTS:
+      priv->n_segments = g_value_get_int (value);
+      break;
+    case PROP_BOUNDED_MEMORY:
+      priv->bounded = g_value_get_boolean (value);
+      break;
+    case PROP_QUANTIZE_PEAKS:
+      priv->quantize = g_value_get_boolean (value);
+      break;
+    case PROP_FOLLOW:
+      priv->follow = g_value_get_boolean (value);
+      if (!priv->follow)
+        follow_clear (self);
+      else if (!priv->load_pending && pt_sample_store_get_length (priv->hires) > 0)
+        follow_start (self);
+      break;
+    case PROP_SHARED:
+      priv->shared = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -893,6 +3605,27 @@ pt_waveloader_get_property (GObject    *object,
     case PROP_URI:
       g_value_set_string (value, priv->uri);
       break;
+    case PROP_CACHE:
+      g_value_set_boolean (value, priv->use_cache);
+      break;
+    case PROP_CACHE_MAX_SIZE:
+      g_value_set_uint64 (value, priv->cache_max_size);
+      break;
+    case PROP_SEGMENTS:
+      g_value_set_int (value, priv->n_segments);
+      break;
+    case PROP_BOUNDED_MEMORY:
+      g_value_set_boolean (value, priv->bounded);
+      break;
+    case PROP_QUANTIZE_PEAKS:
+      g_value_set_boolean (value, priv->quantize);
+      break;
+    case PROP_FOLLOW:
+      g_value_set_boolean (value, priv->follow);
+      break;
+    case PROP_SHARED:
+      g_value_set_boolean (value, priv->shared);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -905,6 +3638,9 @@ pt_waveloader_class_init (PtWaveloaderClass *klass)
   G_OBJECT_CLASS (klass)->set_property = pt_waveloader_set_property;
   G_OBJECT_CLASS (klass)->get_property = pt_waveloader_get_property;
   G_OBJECT_CLASS (klass)->dispose = pt_waveloader_dispose;
+  G_OBJECT_CLASS (klass)->finalize = pt_waveloader_finalize;
+
+  min_max = pt_peak_kernel_get_best ();
 
   /**
    * PtWaveloader::progress:
@@ -944,6 +3680,54 @@ pt_waveloader_class_init (PtWaveloaderClass *klass)
                     G_TYPE_NONE,
                     0);
 
+  /**
+   * PtWaveloader::data-available:
+   * @self: the waveloader emitting the signal
+   * @start_index: index of the first new value in the array
+   * @end_index: index after the last new value in the array
+   *
+   * While loading, new waveform data is available in the array returned by
+   * pt_waveloader_get_data(). Data is added in steps of one second and the
+   * signal is always emitted in the main context, it’s safe to read the
+   * given range in the handler. A handler for
+   * #PtWaveloader::array-size-changed has been called before, if the new
+   * data didn’t fit into the array.
+   *
+   * Since: 4.3
+   */
+  signals[DATA_AVAILABLE] =
+      g_signal_new ("data-available",
+                    PT_TYPE_WAVELOADER,
+                    G_SIGNAL_RUN_FIRST,
+                    0,
+                    NULL,
+                    NULL,
+                    _pt_cclosure_marshal_VOID__UINT_UINT,
+                    G_TYPE_NONE,
+                    2, G_TYPE_UINT, G_TYPE_UINT);
+
+  /**
+   * PtWaveloader::duration-changed:
+   * @self: the waveloader emitting the signal
+   * @duration: the new duration in nanoseconds
+   *
+   * With #PtWaveloader:follow new data was appended to the file and added
+   * to the array. Handlers for #PtWaveloader::array-size-changed and
+   * #PtWaveloader::data-available have been called before.
+   *
+   * Since: 4.3
+   */
+  signals[DURATION_CHANGED] =
+      g_signal_new ("duration-changed",
+                    PT_TYPE_WAVELOADER,
+                    G_SIGNAL_RUN_FIRST,
+                    0,
+                    NULL,
+                    NULL,
+                    _pt_cclosure_marshal_VOID__INT64,
+                    G_TYPE_NONE,
+                    1, G_TYPE_INT64);
+
   /**
    * PtWaveloader:uri:
    *
@@ -955,6 +3739,122 @@ pt_waveloader_class_init (PtWaveloaderClass *klass)
           "",
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
 
+  /**
+   * PtWaveloader:cache:
+   *
+   * Whether decoded data is saved to and loaded from a cache in the user’s
+   * cache directory. Cache files are identified by URI, file size and
+   * modification time. The least recently used files are removed if the
+   * cache grows bigger than #PtWaveloader:cache-max-size.
+   *
+   * Since: 4.3
+   */
+  obj_properties[PROP_CACHE] =
+      g_param_spec_boolean (
+          "cache", NULL, NULL,
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * PtWaveloader:cache-max-size:
+   *
+   * Maximum size of all cache files in bytes, the default is 1 GB. After
+   * saving a file the least recently used files are removed until the cache
+   * fits. Files bigger than this are not saved. 0 means no limit, nothing is
+   * removed then.
+   *
+   * Since: 4.3
+   */
+  obj_properties[PROP_CACHE_MAX_SIZE] =
+      g_param_spec_uint64 (
+          "cache-max-size", NULL, NULL,
+          0, G_MAXUINT64, CACHE_MAX_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * PtWaveloader:segments:
+   *
+   * Number of segments that are decoded in parallel, each one in its own
+   * thread. 1 decodes the file from start to end, 0 uses one segment per
+   * processor. Segments are at least 10 seconds long, short files use fewer
+   * segments. Files without a known duration are decoded in one segment.
+   *
+   * Since: 4.3
+   */
+  obj_properties[PROP_SEGMENTS] =
+      g_param_spec_int (
+          "segments", NULL, NULL,
+          0, 64, 1,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * PtWaveloader:bounded-memory:
+   *
+   * Whether raw samples are dropped after they are processed. Only a compact
+   * index of peaks is kept, which needs about 1/8 of the memory. Resizing
+   * is less exact then, peaks may be slightly wider at high resolutions.
+   * Decoded data is not saved to the cache in this mode.
+   *
+   * Takes effect on the next load operation.
+   *
+   * Since: 4.3
+   */
+  obj_properties[PROP_BOUNDED_MEMORY] =
+      g_param_spec_boolean (
+          "bounded-memory", NULL, NULL,
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * PtWaveloader:quantize-peaks:
+   *
+   * Whether peaks in bounded-memory mode are saved with 8 bit instead of
+   * 16 bit, which halves the memory again. Has no effect, if
+   * #PtWaveloader:bounded-memory is FALSE.
+   *
+   * Takes effect on the next load operation.
+   *
+   * Since: 4.3
+   */
+  obj_properties[PROP_QUANTIZE_PEAKS] =
+      g_param_spec_boolean (
+          "quantize-peaks", NULL, NULL,
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * PtWaveloader:follow:
+   *
+   * Whether the file is watched after it was loaded. If it grows, e.g.
+   * because it is still being recorded, only the new data is decoded and
+   * appended to the array. #PtWaveloader::duration-changed is emitted then.
+   * Has no effect, if #PtWaveloader:bounded-memory is TRUE.
+   *
+   * Since: 4.3
+   */
+  obj_properties[PROP_FOLLOW] =
+      g_param_spec_boolean (
+          "follow", NULL, NULL,
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * PtWaveloader:shared:
+   *
+   * Whether decoded data is shared with other loaders of the process that
+   * load the same file. Only one of them decodes it, the others wait for
+   * it. Data is freed when the last loader loads another file or is
+   * finalized. Has no effect with #PtWaveloader:bounded-memory or
+   * #PtWaveloader:follow.
+   *
+   * Since: 4.3
+   */
+  obj_properties[PROP_SHARED] =
+      g_param_spec_boolean (
+          "shared", NULL, NULL,
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (
       G_OBJECT_CLASS (klass),
       N_PROPERTIES,
@@ -54,12 +54,32 @@ void          pt_waveloader_resize_async  (PtWaveloader       *self,
                                            GAsyncReadyCallback callback,
                                            gpointer            user_data);
 
+void          pt_waveloader_resize_range_async (PtWaveloader       *self,
+                                                gint                pps,
+                                                gint                first,
+                                                gint                last,
+                                                GCancellable       *cancellable,
+                                                GAsyncReadyCallback callback,
+                                                gpointer            user_data);
+
 gboolean      pt_waveloader_resize        (PtWaveloader       *self,
                                            gint                pps,
                                            GError            **error);
 
 GArray       *pt_waveloader_get_data      (PtWaveloader       *self);
 
+GBytes       *pt_waveloader_get_bytes     (PtWaveloader       *self,
+                                           gint                start_index,
+                                           gint                end_index);
+
+gboolean      pt_waveloader_get_peaks     (PtWaveloader       *self,
+                                           gint64              start,
+                                           gint64              end,
+                                           gint                n_bins,
+                                           gfloat             *out);
+
+gsize         pt_waveloader_get_memory_usage (PtWaveloader *self);
+
 PtWaveloader *pt_waveloader_new           (gchar              *uri);
 
 G_END_DECLS
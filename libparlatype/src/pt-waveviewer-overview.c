@@ -0,0 +1,490 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * pt-waveviewer-overview
+ * Internal widget that shows the whole file for PtWaveviewer.
+ *
+ * The overview draws the waveform of the whole file at the widget’s width,
+ * the visible part of the waveviewer as a rectangle and the playback
+ * cursor. Clicking or dragging moves the visible part.
+ *
+ * It doesn’t read the waveviewer’s peaks on drawing. Instead it keeps a
+ * summary of N_BINS minimum/maximum pairs, each covering bin_ms
+ * milliseconds. PtWaveviewer feeds every range of new peaks with
+ * pt_waveviewer_overview_add(), so the summary grows while the file is
+ * loading. If the file is longer than the summary, neighbouring bins are
+ * merged and bin_ms is doubled. A pixel that is longer than a bin goes into
+ * every bin it covers. Ranges can be added again, e.g. after a zoom step;
+ * peaks at a lower resolution than the summary’s widen the bins they cover
+ * then, but never make them smaller.
+ *
+ * The whole file is mapped to the widget’s width using the duration set
+ * with pt_waveviewer_overview_set_duration(). While loading that’s the
+ * estimated duration, the part that is not loaded yet is empty.
+ *
+ * The widget has a name "overview".
+ */
+
+#include "config.h"
+
+#include "pt-waveviewer-overview.h"
+
+/* Size of the summary */
+#define N_BINS 4096
+
+/* Initial duration of one bin in milliseconds */
+#define BIN_MS_MIN 10
+
+#define OVERVIEW_HEIGHT 40
+
+struct _PtWaveviewerOverview
+{
+  GtkWidget parent;
+
+  gfloat *bins;   /* N_BINS pairs of minimum and maximum */
+  gint    n_bins; /* number of bins in use */
+  gint64  bin_ms; /* duration of one bin */
+
+  gint64 duration; /* in milliseconds */
+  gint64 cursor;   /* in milliseconds */
+
+  GtkAdjustment *adj; /* the PtWaveviewer’s adjustment */
+
+  GtkGesture *drag;
+  gdouble     drag_start;
+  gdouble     drag_offset; /* pointer position within the rectangle */
+
+  GdkRGBA wave_color;
+};
+
+/* Same as .cursor in pt-waveviewer.css */
+static const GdkRGBA cursor_color = { 0.8f, 0.0f, 0.0f, 1.0f };
+
+G_DEFINE_TYPE (PtWaveviewerOverview, pt_waveviewer_overview, GTK_TYPE_WIDGET);
+
+static void
+merge_bins (PtWaveviewerOverview *self)
+{
+  /* Halve the resolution of the summary: two neighbouring bins become one */
+
+  gint i;
+
+  for (i = 0; i < N_BINS / 2; i++)
+    {
+      self->bins[i * 2] = MIN (self->bins[i * 4], self->bins[i * 4 + 2]);
+      self->bins[i * 2 + 1] = MAX (self->bins[i * 4 + 1], self->bins[i * 4 + 3]);
+    }
+
+  memset (self->bins + N_BINS, 0, N_BINS * sizeof (gfloat));
+  self->n_bins = (self->n_bins + 1) / 2;
+  self->bin_ms *= 2;
+}
+
+static gint
+time_to_x (PtWaveviewerOverview *self,
+           gint64                ms,
+           gint                  width)
+{
+  return (gint) (ms * width / self->duration);
+}
+
+static void
+get_rectangle (PtWaveviewerOverview *self,
+               gint                  width,
+               gdouble              *x,
+               gdouble              *w)
+{
+  /* Visible part of the waveviewer in widget coordinates */
+
+  gdouble upper;
+
+  *x = 0;
+  *w = 0;
+
+  if (!self->adj)
+    return;
+
+  upper = gtk_adjustment_get_upper (self->adj);
+  if (upper <= 0)
+    return;
+
+  *x = gtk_adjustment_get_value (self->adj) / upper * width;
+  *w = MAX (gtk_adjustment_get_page_size (self->adj) / upper * width, 1);
+}
+
+static void
+append_wave (PtWaveviewerOverview *self,
+             GtkSnapshot          *snapshot,
+             gint                  width,
+             gint                  height)
+{
+  /* One filled path like the waveform, each pixel combines the bins of
+   * its time range */
+
+  GskPathBuilder *builder;
+  GskPath        *path;
+  gfloat         *pixels;
+  gint            x, end;
+  gint            bin, first, last;
+  gfloat          min, max;
+  gint            half = height / 2 - 1;
+  gint            middle = height / 2;
+
+  pixels = g_new (gfloat, width * 2);
+
+  for (end = 0; end < width; end++)
+    {
+      first = end * self->duration / width / self->bin_ms;
+      last = (end + 1) * self->duration / width / self->bin_ms;
+      if (first >= self->n_bins)
+        break;
+      last = CLAMP (last, first + 1, self->n_bins);
+
+      min = max = 0;
+      for (bin = first; bin < last; bin++)
+        {
+          min = MIN (min, self->bins[bin * 2]);
+          max = MAX (max, self->bins[bin * 2 + 1]);
+        }
+      pixels[end * 2] = min;
+      pixels[end * 2 + 1] = max;
+    }
+
+  if (end == 0)
+    {
+      g_free (pixels);
+      return;
+    }
+
+  builder = gsk_path_builder_new ();
+
+  /* Upper edge */
+  for (x = 0; x < end; x++)
+    {
+      max = middle - half * pixels[x * 2 + 1];
+      if (x == 0)
+        gsk_path_builder_move_to (builder, x, max);
+      else
+        gsk_path_builder_line_to (builder, x, max);
+      gsk_path_builder_line_to (builder, x + 1, max);
+    }
+
+  /* Lower edge, backwards */
+  for (x = end - 1; x >= 0; x--)
+    {
+      min = middle - half * pixels[x * 2];
+      gsk_path_builder_line_to (builder, x + 1, min);
+      gsk_path_builder_line_to (builder, x, min);
+    }
+
+  gsk_path_builder_close (builder);
+  path = gsk_path_builder_free_to_path (builder);
+  gtk_snapshot_append_fill (snapshot, path, GSK_FILL_RULE_WINDING, &self->wave_color);
+  gsk_path_unref (path);
+  g_free (pixels);
+}
+
+static void
+pt_waveviewer_overview_snapshot (GtkWidget   *widget,
+                                 GtkSnapshot *snapshot)
+{
+  PtWaveviewerOverview *self = (PtWaveviewerOverview *) widget;
+
+  gint           width = gtk_widget_get_width (widget);
+  gint           height = gtk_widget_get_height (widget);
+  GdkRGBA        fill_color;
+  GdkRGBA        border_color[4];
+  GskRoundedRect border;
+  gfloat         border_width[4] = { 1, 1, 1, 1 };
+  gdouble        x, w;
+  gint           i;
+
+  if (self->duration <= 0 || width <= 0)
+    return;
+
+  gtk_widget_get_color (widget, &self->wave_color);
+  append_wave (self, snapshot, width, height);
+
+  /* Visible part */
+  get_rectangle (self, width, &x, &w);
+  if (w > 0)
+    {
+      fill_color = self->wave_color;
+      fill_color.alpha *= 0.2f;
+      for (i = 0; i < 4; i++)
+        {
+          border_color[i] = self->wave_color;
+          border_color[i].alpha *= 0.6f;
+        }
+
+      gtk_snapshot_append_color (snapshot, &fill_color,
+                                 &GRAPHENE_RECT_INIT (x, 0, w, height));
+      gsk_rounded_rect_init_from_rect (&border,
+                                       &GRAPHENE_RECT_INIT (x, 0, w, height), 0);
+      gtk_snapshot_append_border (snapshot, &border, border_width, border_color);
+    }
+
+  /* Playback cursor */
+  gtk_snapshot_append_color (snapshot, &cursor_color,
+                             &GRAPHENE_RECT_INIT (time_to_x (self, self->cursor, width), 0, 1, height));
+}
+
+static void
+move_rectangle (PtWaveviewerOverview *self,
+                gdouble               x)
+{
+  /* Moves the left edge of the rectangle to @x */
+
+  gint    width = gtk_widget_get_width (GTK_WIDGET (self));
+  gdouble upper;
+
+  if (!self->adj || width <= 0)
+    return;
+
+  upper = gtk_adjustment_get_upper (self->adj);
+  gtk_adjustment_set_value (self->adj, x / width * upper);
+}
+
+static void
+drag_begin_cb (GtkGestureDrag       *gesture,
+               gdouble               start_x,
+               gdouble               start_y,
+               PtWaveviewerOverview *self)
+{
+  /* Dragging the rectangle keeps the pointer’s position in it, a click
+   * elsewhere centers it at the pointer */
+
+  gdouble x, w;
+
+  get_rectangle (self, gtk_widget_get_width (GTK_WIDGET (self)), &x, &w);
+
+  self->drag_start = start_x;
+  if (start_x >= x && start_x <= x + w)
+    {
+      self->drag_offset = start_x - x;
+    }
+  else
+    {
+      self->drag_offset = w / 2;
+      move_rectangle (self, start_x - self->drag_offset);
+    }
+}
+
+static void
+drag_update_cb (GtkGestureDrag       *gesture,
+                gdouble               offset_x,
+                gdouble               offset_y,
+                PtWaveviewerOverview *self)
+{
+  move_rectangle (self, self->drag_start + offset_x - self->drag_offset);
+}
+
+static void
+adj_changed_cb (GtkAdjustment        *adj,
+                PtWaveviewerOverview *self)
+{
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+/**
+ * pt_waveviewer_overview_reset:
+ * @self: the widget
+ *
+ * Clears the summary, e.g. before a new file is loaded.
+ */
+void
+pt_waveviewer_overview_reset (PtWaveviewerOverview *self)
+{
+  memset (self->bins, 0, N_BINS * 2 * sizeof (gfloat));
+  self->n_bins = 0;
+  self->bin_ms = BIN_MS_MIN;
+  self->cursor = 0;
+
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+/**
+ * pt_waveviewer_overview_add:
+ * @self: the widget
+ * @peaks: the waveviewer’s peaks
+ * @start_index: index of the first new value in @peaks
+ * @end_index: index after the last new value in @peaks
+ * @pps: resolution of @peaks in pixels per second
+ *
+ * Adds new peaks to the summary.
+ */
+void
+pt_waveviewer_overview_add (PtWaveviewerOverview *self,
+                            GArray               *peaks,
+                            guint                 start_index,
+                            guint                 end_index,
+                            gint                  pps)
+{
+  guint  pixel;
+  gint64 first, last, bin;
+  gfloat min, max;
+
+  g_return_if_fail (pps > 0);
+
+  end_index = MIN (end_index, peaks->len);
+
+  for (pixel = start_index / 2; pixel < end_index / 2; pixel++)
+    {
+      /* Bins of the first and the last millisecond of the pixel */
+      first = (gint64) pixel * 1000 / pps / self->bin_ms;
+      last = ((gint64) (pixel + 1) * 1000 - 1) / pps / self->bin_ms;
+      while (last >= N_BINS)
+        {
+          merge_bins (self);
+          first /= 2;
+          last /= 2;
+        }
+
+      min = g_array_index (peaks, float, pixel * 2);
+      max = g_array_index (peaks, float, pixel * 2 + 1);
+      for (bin = first; bin <= last; bin++)
+        {
+          self->bins[bin * 2] = MIN (self->bins[bin * 2], min);
+          self->bins[bin * 2 + 1] = MAX (self->bins[bin * 2 + 1], max);
+        }
+      self->n_bins = MAX (self->n_bins, last + 1);
+    }
+
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+/**
+ * pt_waveviewer_overview_set_duration:
+ * @self: the widget
+ * @duration: duration of the file in milliseconds
+ *
+ * Sets the duration that is mapped to the widget’s width.
+ */
+void
+pt_waveviewer_overview_set_duration (PtWaveviewerOverview *self,
+                                     gint64                duration)
+{
+  if (self->duration == duration)
+    return;
+
+  self->duration = duration;
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+/**
+ * pt_waveviewer_overview_set_cursor:
+ * @self: the widget
+ * @cursor: position of the playback cursor in milliseconds
+ *
+ * Moves the cursor. The widget is redrawn only if it moved by a pixel.
+ */
+void
+pt_waveviewer_overview_set_cursor (PtWaveviewerOverview *self,
+                                   gint64                cursor)
+{
+  gint width = gtk_widget_get_width (GTK_WIDGET (self));
+
+  if (self->duration > 0 && width > 0 && time_to_x (self, self->cursor, width) == time_to_x (self, cursor, width))
+    {
+      self->cursor = cursor;
+      return;
+    }
+
+  self->cursor = cursor;
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+/**
+ * pt_waveviewer_overview_set_adjustment:
+ * @self: the widget
+ * @adj: the waveviewer’s horizontal adjustment
+ *
+ * The overview shows the visible part of @adj and scrolls it.
+ */
+void
+pt_waveviewer_overview_set_adjustment (PtWaveviewerOverview *self,
+                                       GtkAdjustment        *adj)
+{
+  if (self->adj)
+    {
+      g_signal_handlers_disconnect_by_data (self->adj, self);
+      g_clear_object (&self->adj);
+    }
+
+  if (!adj)
+    return;
+
+  self->adj = g_object_ref (adj);
+  g_signal_connect (self->adj, "value-changed", G_CALLBACK (adj_changed_cb), self);
+  g_signal_connect (self->adj, "changed", G_CALLBACK (adj_changed_cb), self);
+}
+
+static void
+pt_waveviewer_overview_dispose (GObject *object)
+{
+  PtWaveviewerOverview *self = PT_WAVEVIEWER_OVERVIEW (object);
+
+  pt_waveviewer_overview_set_adjustment (self, NULL);
+
+  G_OBJECT_CLASS (pt_waveviewer_overview_parent_class)->dispose (object);
+}
+
+static void
+pt_waveviewer_overview_finalize (GObject *object)
+{
+  PtWaveviewerOverview *self = PT_WAVEVIEWER_OVERVIEW (object);
+
+  g_free (self->bins);
+
+  G_OBJECT_CLASS (pt_waveviewer_overview_parent_class)->finalize (object);
+}
+
+static void
+pt_waveviewer_overview_init (PtWaveviewerOverview *self)
+{
+  self->bins = g_new0 (gfloat, N_BINS * 2);
+  self->n_bins = 0;
+  self->bin_ms = BIN_MS_MIN;
+  self->duration = 0;
+  self->cursor = 0;
+  self->adj = NULL;
+
+  self->drag = gtk_gesture_drag_new ();
+  g_signal_connect (self->drag, "drag-begin", G_CALLBACK (drag_begin_cb), self);
+  g_signal_connect (self->drag, "drag-update", G_CALLBACK (drag_update_cb), self);
+  gtk_widget_add_controller (GTK_WIDGET (self), GTK_EVENT_CONTROLLER (self->drag));
+
+  gtk_widget_set_name (GTK_WIDGET (self), "overview");
+  gtk_widget_set_size_request (GTK_WIDGET (self), -1, OVERVIEW_HEIGHT);
+}
+
+static void
+pt_waveviewer_overview_class_init (PtWaveviewerOverviewClass *klass)
+{
+  GObjectClass   *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->dispose = pt_waveviewer_overview_dispose;
+  object_class->finalize = pt_waveviewer_overview_finalize;
+  widget_class->snapshot = pt_waveviewer_overview_snapshot;
+}
+
+GtkWidget *
+pt_waveviewer_overview_new (void)
+{
+  return GTK_WIDGET (g_object_new (PT_TYPE_WAVEVIEWER_OVERVIEW, NULL));
+}
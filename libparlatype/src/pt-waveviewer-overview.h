@@ -0,0 +1,41 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+#define PT_TYPE_WAVEVIEWER_OVERVIEW (pt_waveviewer_overview_get_type ())
+G_DECLARE_FINAL_TYPE (PtWaveviewerOverview, pt_waveviewer_overview, PT, WAVEVIEWER_OVERVIEW, GtkWidget)
+
+void       pt_waveviewer_overview_reset          (PtWaveviewerOverview *self);
+
+void       pt_waveviewer_overview_add            (PtWaveviewerOverview *self,
+                                                  GArray               *peaks,
+                                                  guint                 start_index,
+                                                  guint                 end_index,
+                                                  gint                  pps);
+
+void       pt_waveviewer_overview_set_duration   (PtWaveviewerOverview *self,
+                                                  gint64                duration);
+
+void       pt_waveviewer_overview_set_cursor     (PtWaveviewerOverview *self,
+                                                  gint64                cursor);
+
+void       pt_waveviewer_overview_set_adjustment (PtWaveviewerOverview *self,
+                                                  GtkAdjustment        *adj);
+
+GtkWidget *pt_waveviewer_overview_new            (void);
@@ -30,13 +30,14 @@
  * 5px for marks and 6px for padding.
  *
  * Marks (primary and secondary) are computed based on font size and pixel per
- * second ratio.
+ * second ratio. Layouts of time strings are kept in a small cache, so that
+ * they are not shaped again on every scroll step.
  *
  * It listens to changes of the parent's horizontal GtkAdjustment and redraws
  * itself (scroll movements, size changes).
  *
- * The widget listens to the style-updated signal (e.g. changed font size, color)
- * and the state-flags-changed signal to update its height/color.
+ * On CSS changes that affect the font, on font setting changes and on scale
+ * factor changes the cached layouts are dropped and the height is updated.
  *
  * The widget has a GTK_STYLE_CLASS_MARK and a name "ruler".
  */
@@ -54,6 +55,16 @@
 #define PRIMARY_MARK_HEIGHT 8
 #define SECONDARY_MARK_HEIGHT 4
 
+/* Number of time string layouts kept */
+#define LAYOUT_CACHE_SIZE 64
+
+typedef struct
+{
+  gchar         *text;
+  PangoLayout   *layout;
+  PangoRectangle rect; /* pixel extents */
+} LayoutEntry;
+
 struct _PtWaveviewerRuler
 {
   GtkWidget parent;
@@ -69,6 +80,11 @@ struct _PtWaveviewerRuler
   gint     time_string_width;
   gint     primary_modulo;
   gint     secondary_modulo;
+
+  /* Shaped time strings, most recently used first */
+  GQueue                layouts;
+  GHashTable           *layout_table; /* text → GList link in layouts */
+  PangoFontDescription *layout_font; /* font of all layouts */
 };
 
 G_DEFINE_TYPE (PtWaveviewerRuler, pt_waveviewer_ruler, GTK_TYPE_WIDGET);
@@ -99,24 +115,92 @@ pixel_to_time (PtWaveviewerRuler *self,
   return result;
 }
 
+static void
+layout_entry_free (LayoutEntry *entry)
+{
+  g_free (entry->text);
+  g_object_unref (entry->layout);
+  g_free (entry);
+}
+
+static void
+clear_layouts (PtWaveviewerRuler *self)
+{
+  g_hash_table_remove_all (self->layout_table);
+  g_queue_clear_full (&self->layouts, (GDestroyNotify) layout_entry_free);
+}
+
+static LayoutEntry *
+get_layout (PtWaveviewerRuler *self,
+            const gchar       *text)
+{
+  /* Returns the layout for @text from the cache or a new one. The least
+   * recently used layout is dropped if the cache is full. */
+
+  LayoutEntry *entry;
+  GList       *link;
+
+  link = g_hash_table_lookup (self->layout_table, text);
+  if (link)
+    {
+      g_queue_unlink (&self->layouts, link);
+      g_queue_push_head_link (&self->layouts, link);
+      return link->data;
+    }
+
+  entry = g_new (LayoutEntry, 1);
+  entry->text = g_strdup (text);
+  entry->layout = gtk_widget_create_pango_layout (GTK_WIDGET (self), text);
+  pango_layout_get_pixel_extents (entry->layout, &entry->rect, NULL);
+  g_queue_push_head (&self->layouts, entry);
+  g_hash_table_insert (self->layout_table, entry->text, self->layouts.head);
+
+  if (g_queue_get_length (&self->layouts) > LAYOUT_CACHE_SIZE)
+    {
+      entry = g_queue_pop_tail (&self->layouts);
+      g_hash_table_remove (self->layout_table, entry->text);
+      layout_entry_free (entry);
+    }
+
+  return self->layouts.head->data;
+}
+
+static gint64
+first_mark (gint64 pixel,
+            gint64 step)
+{
+  /* First multiple of @step at or after @pixel */
+
+  if (pixel <= 0)
+    return 0;
+
+  return (pixel + step - 1) / step * step;
+}
+
 static void
 pt_waveviewer_ruler_snapshot (GtkWidget   *widget,
                               GtkSnapshot *snapshot)
 {
+  /* Marks are multiples of a step in pixels, they are computed from the
+   * first visible one. The cost depends on the number of marks, not on
+   * the width. */
+
   PtWaveviewerRuler *self = (PtWaveviewerRuler *) widget;
   gdouble            height = gtk_widget_get_height (widget);
 
-  gint           i;      /* counter, pixel on x-axis in the view */
-  gint           sample; /* sample in the array */
-  gchar         *text;
-  PangoLayout   *layout;
-  PangoRectangle rect;
-  gint           halfwidth;
-  gint64         tmp_time;
-  GdkRGBA        text_color;
-  gint           width;
-  gint           offset;
-  gint           p_x, p_y;
+  gint         i;      /* pixel on x-axis in the view */
+  gint64       sample; /* sample in the array */
+  gint64       step;
+  gint64       end;
+  gchar        text[32];
+  LayoutEntry *entry;
+  gint         halfwidth;
+  gint64       tmp_time;
+  GdkRGBA      text_color;
+  gint         width;
+  gint         offset;
+  gint         secs;
+  gint         p_x, p_y;
 
   if (self->n_samples == 0)
     return;
@@ -148,57 +232,50 @@ pt_waveviewer_ruler_snapshot (GtkWidget   *widget,
      Use secondary_modulo. */
   if (self->primary_modulo > 1)
     {
-      for (i = 0; i <= width; i += 1)
+      step = (gint64) self->px_per_sec * self->secondary_modulo;
+      end = MIN (offset + width, self->n_samples);
+      for (sample = first_mark (offset, step); sample <= end; sample += step)
         {
-          sample = i + offset;
-          if (sample > self->n_samples)
-            break;
-          if (sample % (self->px_per_sec * self->secondary_modulo) == 0)
-            gtk_snapshot_append_color (snapshot, &text_color,
-                                       &GRAPHENE_RECT_INIT (i, 0, 1, SECONDARY_MARK_HEIGHT));
+          gtk_snapshot_append_color (snapshot, &text_color,
+                                     &GRAPHENE_RECT_INIT (sample - offset, 0, 1, SECONDARY_MARK_HEIGHT));
         }
     }
 
   /* Primary marks and time strings
      Add some padding to show time strings (time_string_width) */
-  for (i = 0 - self->time_string_width; i <= width + self->time_string_width; i += 1)
+  step = (gint64) self->px_per_sec * self->primary_modulo;
+  end = MIN (offset + width + self->time_string_width, self->n_samples);
+  for (sample = first_mark (offset - self->time_string_width, step); sample <= end; sample += step)
     {
-      sample = i + offset;
-      if (sample < 0 || sample > self->n_samples)
-        continue;
-      if (sample % (self->px_per_sec * self->primary_modulo) == 0)
+      i = sample - offset;
+      gtk_snapshot_append_color (snapshot, &text_color,
+                                 &GRAPHENE_RECT_INIT (i, 0, 1, PRIMARY_MARK_HEIGHT));
+      secs = sample / self->px_per_sec;
+      if (self->time_format_long)
         {
-          gtk_snapshot_append_color (snapshot, &text_color,
-                                     &GRAPHENE_RECT_INIT (i, 0, 1, PRIMARY_MARK_HEIGHT));
-          if (self->time_format_long)
-            {
-              text = g_strdup_printf (C_ ("long time format", "%d:%02d:%02d"),
-                                      sample / self->px_per_sec / 3600,
-                                      (sample / self->px_per_sec % 3600) / 60,
-                                      sample / self->px_per_sec % 60);
-            }
-          else
-            {
-              text = g_strdup_printf (C_ ("shortest time format", "%d:%02d"),
-                                      sample / self->px_per_sec / 60,
-                                      sample / self->px_per_sec % 60);
-            }
-          layout = gtk_widget_create_pango_layout (widget, text);
-
-          /* display timestring only if it is fully visible in drawing area */
-          pango_layout_get_pixel_extents (layout, &rect, NULL);
-          halfwidth = rect.width / 2;
-          if (i - halfwidth > 0 && i + halfwidth < width)
-            {
-              p_x = i - halfwidth;                     /* center at mark   */
-              p_y = height - rect.y - rect.height - 3; /* 3px above border */
-              gtk_snapshot_save (snapshot);
-              gtk_snapshot_translate (snapshot, &GRAPHENE_POINT_INIT (p_x, p_y));
-              gtk_snapshot_append_layout (snapshot, layout, &text_color);
-              gtk_snapshot_restore (snapshot);
-            }
-          g_free (text);
-          g_object_unref (layout);
+          g_snprintf (text, sizeof (text), C_ ("long time format", "%d:%02d:%02d"),
+                      secs / 3600,
+                      (secs % 3600) / 60,
+                      secs % 60);
+        }
+      else
+        {
+          g_snprintf (text, sizeof (text), C_ ("shortest time format", "%d:%02d"),
+                      secs / 60,
+                      secs % 60);
+        }
+      entry = get_layout (self, text);
+
+      /* display timestring only if it is fully visible in drawing area */
+      halfwidth = entry->rect.width / 2;
+      if (i - halfwidth > 0 && i + halfwidth < width)
+        {
+          p_x = i - halfwidth;                                 /* center at mark   */
+          p_y = height - entry->rect.y - entry->rect.height - 3; /* 3px above border */
+          gtk_snapshot_save (snapshot);
+          gtk_snapshot_translate (snapshot, &GRAPHENE_POINT_INIT (p_x, p_y));
+          gtk_snapshot_append_layout (snapshot, entry->layout, &text_color);
+          gtk_snapshot_restore (snapshot);
         }
     }
 }
@@ -277,6 +354,59 @@ calculate_height (PtWaveviewerRuler *self)
   gtk_widget_set_size_request (GTK_WIDGET (self), -1, ruler_height);
 }
 
+static void
+invalidate_layouts (PtWaveviewerRuler *self)
+{
+  /* Layouts and the height depend on font, font options and scale */
+
+  clear_layouts (self);
+  calculate_height (self);
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+static void
+pt_waveviewer_ruler_css_changed (GtkWidget         *widget,
+                                 GtkCssStyleChange *change)
+{
+  /* Most changes are colors or state, keep the layouts unless the font
+   * changed. The parent class updates the Pango context. */
+
+  PtWaveviewerRuler          *self = PT_WAVEVIEWER_RULER (widget);
+  const PangoFontDescription *font;
+
+  GTK_WIDGET_CLASS (pt_waveviewer_ruler_parent_class)->css_changed (widget, change);
+
+  font = pango_context_get_font_description (gtk_widget_get_pango_context (widget));
+  if (self->layout_font && pango_font_description_equal (font, self->layout_font))
+    return;
+
+  g_clear_pointer (&self->layout_font, pango_font_description_free);
+  self->layout_font = pango_font_description_copy (font);
+  invalidate_layouts (self);
+}
+
+static void
+pt_waveviewer_ruler_system_setting_changed (GtkWidget       *widget,
+                                            GtkSystemSetting setting)
+{
+  PtWaveviewerRuler *self = PT_WAVEVIEWER_RULER (widget);
+
+  GTK_WIDGET_CLASS (pt_waveviewer_ruler_parent_class)->system_setting_changed (widget, setting);
+
+  if (setting == GTK_SYSTEM_SETTING_DPI ||
+      setting == GTK_SYSTEM_SETTING_FONT_NAME ||
+      setting == GTK_SYSTEM_SETTING_FONT_CONFIG)
+    invalidate_layouts (self);
+}
+
+static void
+scale_factor_changed (GObject    *object,
+                      GParamSpec *pspec,
+                      gpointer    data)
+{
+  invalidate_layouts (PT_WAVEVIEWER_RULER (object));
+}
+
 static void
 adj_value_changed (GtkAdjustment *adj,
                    gpointer       data)
@@ -317,6 +447,18 @@ pt_waveviewer_ruler_set_ruler (PtWaveviewerRuler *self,
   gtk_widget_queue_draw (GTK_WIDGET (self));
 }
 
+static void
+pt_waveviewer_ruler_finalize (GObject *object)
+{
+  PtWaveviewerRuler *self = PT_WAVEVIEWER_RULER (object);
+
+  clear_layouts (self);
+  g_hash_table_unref (self->layout_table);
+  g_clear_pointer (&self->layout_font, pango_font_description_free);
+
+  G_OBJECT_CLASS (pt_waveviewer_ruler_parent_class)->finalize (object);
+}
+
 static void
 pt_waveviewer_ruler_init (PtWaveviewerRuler *self)
 {
@@ -324,18 +466,28 @@ pt_waveviewer_ruler_init (PtWaveviewerRuler *self)
   self->px_per_sec = 0;
   self->duration = 0;
   self->adj = NULL;
+  g_queue_init (&self->layouts);
+  self->layout_table = g_hash_table_new (g_str_hash, g_str_equal);
+  self->layout_font = NULL;
 
   gtk_widget_set_name (GTK_WIDGET (self), "ruler");
   gtk_widget_add_css_class (GTK_WIDGET (self), "mark");
+
+  g_signal_connect (self, "notify::scale-factor",
+                    G_CALLBACK (scale_factor_changed), NULL);
 }
 
 static void
 pt_waveviewer_ruler_class_init (PtWaveviewerRulerClass *klass)
 {
+  GObjectClass   *object_class = G_OBJECT_CLASS (klass);
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+  object_class->finalize = pt_waveviewer_ruler_finalize;
+  widget_class->css_changed = pt_waveviewer_ruler_css_changed;
   widget_class->root = pt_waveviewer_ruler_root;
   widget_class->snapshot = pt_waveviewer_ruler_snapshot;
+  widget_class->system_setting_changed = pt_waveviewer_ruler_system_setting_changed;
 }
 
 GtkWidget *
@@ -29,6 +29,16 @@
  * pt_waveviewer_waveform_set() is used to pass an array with data to the
  * widget.
  *
+ * The waveform is cached in tiles, textures of a fixed width that are
+ * generated in threads. They are valid for the resolution given with
+ * pt_waveviewer_waveform_set_pps(), the widget’s height, scale factor and
+ * color. Tiles with changed peaks are marked with
+ * pt_waveviewer_waveform_invalidate() and generated again.
+ *
+ * After a resolution change the tiles of the old resolution are drawn
+ * scaled as a preview, until invalidated ranges cover their peaks at the
+ * new resolution.
+ *
  * It listens to changes of the parent's horizontal GtkAdjustment and redraws
  * itself (scroll movements, size changes).
  *
@@ -44,6 +54,33 @@
 
 #include "pt-waveviewer.h"
 
+/* Width of a tile in pixels */
+#define TILE_WIDTH 256
+
+/* Tiles are evicted if there are more, the ones farthest from the visible
+ * area first */
+#define MAX_TILES 64
+
+typedef struct
+{
+  GdkTexture *texture;    /* NULL until it was generated once */
+  guint       version;    /* incremented if its peaks changed */
+  guint       generation; /* of the last job */
+  gboolean    pending;    /* a thread is generating it */
+  gboolean    stale;      /* texture shows outdated peaks */
+} Tile;
+
+typedef struct
+{
+  guint    generation;
+  gint     index;
+  guint    version;
+  GArray  *peaks; /* copy of the tile’s peaks */
+  gint     height;
+  gint     scale;
+  GdkRGBA  color;
+} TileJob;
+
 struct _PtWaveviewerWaveform
 {
   GtkWidget parent;
@@ -55,61 +92,452 @@ struct _PtWaveviewerWaveform
 
   /* Rendering */
   GdkRGBA wave_color;
+
+  /* Tile cache, valid for this key */
+  GHashTable *tiles;      /* tile index → Tile */
+  guint       generation; /* incremented for each job */
+  gint        tile_pps;
+  gint        tile_height;
+  gint        tile_scale;
+  GdkRGBA     tile_color;
+
+  /* Zoom preview: textures of the previous resolution, drawn scaled until
+   * the tiles’ peaks are converted to the new resolution */
+  GHashTable *preview; /* tile index → GdkTexture, NULL without preview */
+  gint        preview_pps;
+  GArray     *converted; /* guint, converted pixels per tile */
+  guint       n_converted;
 };
 
 G_DEFINE_TYPE (PtWaveviewerWaveform, pt_waveviewer_waveform, GTK_TYPE_WIDGET);
 
-static gint64
-pixel_to_array (PtWaveviewerWaveform *self,
-                gint64                pixel)
+static void
+tile_free (gpointer data)
+{
+  Tile *tile = data;
+
+  g_clear_object (&tile->texture);
+  g_free (tile);
+}
+
+static void
+tile_job_free (gpointer data)
+{
+  TileJob *job = data;
+
+  g_array_unref (job->peaks);
+  g_free (job);
+}
+
+static void
+flush_tiles (PtWaveviewerWaveform *self)
+{
+  /* Results of running jobs are dropped, their tiles are gone or new ones
+   * with another generation */
+
+  g_hash_table_remove_all (self->tiles);
+}
+
+static void
+end_preview (PtWaveviewerWaveform *self)
+{
+  g_clear_pointer (&self->preview, g_hash_table_unref);
+  g_array_set_size (self->converted, 0);
+  self->n_converted = 0;
+}
+
+static void
+start_preview (PtWaveviewerWaveform *self)
+{
+  /* Keeps the textures of the current resolution. If the previous zoom
+   * step is not finished yet, its preview is kept instead. */
+
+  GHashTableIter iter;
+  gpointer       key;
+  Tile          *tile;
+
+  g_array_set_size (self->converted, 0);
+  self->n_converted = 0;
+
+  if (self->preview || self->tile_pps == 0)
+    return;
+
+  self->preview = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_object_unref);
+  self->preview_pps = self->tile_pps;
+  g_hash_table_iter_init (&iter, self->tiles);
+  while (g_hash_table_iter_next (&iter, &key, (gpointer *) &tile))
+    {
+      if (tile->texture)
+        g_hash_table_insert (self->preview, key, g_object_ref (tile->texture));
+    }
+}
+
+static void
+add_converted (PtWaveviewerWaveform *self,
+               guint                 first,
+               guint                 end)
+{
+  /* Pixels @first to @end (exclusive) have peaks at the new resolution.
+   * The preview ends when all pixels are converted. */
+
+  guint  n_pixels = self->peaks->len / 2;
+  guint  last_tile;
+  guint  overlap;
+  guint  old;
+  guint *count;
+
+  end = MIN (end, n_pixels);
+  if (first >= end)
+    return;
+
+  last_tile = (end - 1) / TILE_WIDTH;
+  if (self->converted->len <= last_tile)
+    g_array_set_size (self->converted, last_tile + 1);
+
+  for (guint i = first / TILE_WIDTH; i <= last_tile; i++)
+    {
+      /* Ranges can be added twice, count at most the tile’s pixels */
+      overlap = MIN (end, (i + 1) * TILE_WIDTH) - MAX (first, i * TILE_WIDTH);
+      count = &g_array_index (self->converted, guint, i);
+      old = *count;
+      *count = MIN (*count + overlap, MIN (TILE_WIDTH, n_pixels - i * TILE_WIDTH));
+      self->n_converted += *count - old;
+    }
+
+  if (self->n_converted >= n_pixels)
+    end_preview (self);
+}
+
+static gboolean
+tile_is_converted (PtWaveviewerWaveform *self,
+                   gint                  index,
+                   gint                  n_pixels)
+{
+  if (!self->preview)
+    return TRUE;
+
+  if (index >= self->converted->len)
+    return FALSE;
+
+  return g_array_index (self->converted, guint, index) >= MIN (TILE_WIDTH, n_pixels - index * TILE_WIDTH);
+}
+
+static void
+append_preview (PtWaveviewerWaveform *self,
+                GtkSnapshot          *snapshot,
+                gint                  index,
+                gint                  n_pixels,
+                gint                  offset,
+                gint                  height)
+{
+  /* Draws the tile @index with the scaled textures of the previous
+   * resolution, positions are anchored at time, not at pixels */
+
+  GdkTexture *texture;
+  gdouble     ratio = (gdouble) self->tile_pps / self->preview_pps;
+  gint        first = index * TILE_WIDTH;
+  gint        end = MIN ((index + 1) * TILE_WIDTH, n_pixels);
+
+  gtk_snapshot_push_clip (snapshot, &GRAPHENE_RECT_INIT (first - offset, 0, end - first, height));
+  for (gint i = first / ratio / TILE_WIDTH; i <= (end - 1) / ratio / TILE_WIDTH; i++)
+    {
+      texture = g_hash_table_lookup (self->preview, GINT_TO_POINTER (i));
+      if (!texture)
+        continue;
+      gtk_snapshot_append_texture (snapshot, texture,
+                                   &GRAPHENE_RECT_INIT (i * TILE_WIDTH * ratio - offset, 0,
+                                                        TILE_WIDTH * ratio, height));
+    }
+  gtk_snapshot_pop (snapshot);
+}
+
+static void
+render_tile (GTask        *task,
+             gpointer      source_object,
+             gpointer      task_data,
+             GCancellable *cancellable)
+{
+  /* Draws a tile at device pixel size in a thread, like the path in
+   * append_path(): one column per pixel from its maximum to its minimum */
+
+  TileJob *job = task_data;
+  guint32 *pixels;
+  guint32  argb;
+  gint     width = TILE_WIDTH * job->scale;
+  gint     height = job->height * job->scale;
+  gint     n_pixels = job->peaks->len / 2;
+  gint     half = job->height / 2 - 1;
+  gint     middle = job->height / 2;
+  gint     top, bottom;
+  gfloat   a = job->color.alpha;
+  GBytes  *bytes;
+
+  /* Premultiplied, native endian, i.e. GDK_MEMORY_DEFAULT */
+  argb = ((guint32) (a * 255 + 0.5) << 24) |
+         ((guint32) (job->color.red * a * 255 + 0.5) << 16) |
+         ((guint32) (job->color.green * a * 255 + 0.5) << 8) |
+         ((guint32) (job->color.blue * a * 255 + 0.5));
+
+  pixels = g_new0 (guint32, (gsize) width * height);
+  for (gint pixel = 0; pixel < n_pixels; pixel++)
+    {
+      top = (gint) ((middle - half * g_array_index (job->peaks, float, pixel * 2 + 1)) * job->scale);
+      bottom = (gint) ((middle + half * g_array_index (job->peaks, float, pixel * 2) * -1) * job->scale + 0.999);
+      top = CLAMP (top, 0, height);
+      bottom = CLAMP (bottom, top, height);
+      for (gint y = top; y < bottom; y++)
+        {
+          for (gint x = pixel * job->scale; x < (pixel + 1) * job->scale; x++)
+            pixels[y * width + x] = argb;
+        }
+    }
+
+  bytes = g_bytes_new_take (pixels, (gsize) width * height * sizeof (guint32));
+  g_task_return_pointer (task,
+                         gdk_memory_texture_new (width, height, GDK_MEMORY_DEFAULT,
+                                                 bytes, width * sizeof (guint32)),
+                         g_object_unref);
+  g_bytes_unref (bytes);
+}
+
+static void request_tile (PtWaveviewerWaveform *self,
+                          gint                  index,
+                          Tile                 *tile);
+
+static void
+render_tile_cb (PtWaveviewerWaveform *self,
+                GAsyncResult         *res,
+                gpointer              user_data)
+{
+  TileJob    *job = g_task_get_task_data (G_TASK (res));
+  GdkTexture *texture;
+  Tile       *tile;
+
+  texture = g_task_propagate_pointer (G_TASK (res), NULL);
+
+  /* Flushed or evicted meanwhile, maybe there is a new tile at the same
+   * index */
+  tile = g_hash_table_lookup (self->tiles, GINT_TO_POINTER (job->index));
+  if (!tile || job->generation != tile->generation)
+    {
+      g_clear_object (&texture);
+      return;
+    }
+
+  tile->pending = FALSE;
+  g_set_object (&tile->texture, texture);
+  g_clear_object (&texture);
+
+  /* Peaks changed while it was generated */
+  if (job->version != tile->version)
+    request_tile (self, job->index, tile);
+  else
+    tile->stale = FALSE;
+
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+static void
+request_tile (PtWaveviewerWaveform *self,
+              gint                  index,
+              Tile                 *tile)
 {
-  /* Convert a position in the drawing area to an index in the peaks array.
-     The returned index is the peak’s min value, +1 is the max value.
-     If the array would be exceeded, return -1 */
+  TileJob *job;
+  GTask   *task;
+  guint    first = index * TILE_WIDTH * 2;
+  guint    len;
+
+  if (tile->pending)
+    return;
+
+  /* Copy the tile’s peaks, the array is changed in the main thread */
+  len = first < self->peaks->len ? MIN (TILE_WIDTH * 2, self->peaks->len - first) : 0;
+  job = g_new (TileJob, 1);
+  job->generation = ++self->generation;
+  tile->generation = job->generation;
+  job->index = index;
+  job->version = tile->version;
+  job->peaks = g_array_sized_new (FALSE, FALSE, sizeof (float), len);
+  g_array_append_vals (job->peaks, &g_array_index (self->peaks, float, first), len);
+  job->height = self->tile_height;
+  job->scale = self->tile_scale;
+  job->color = self->tile_color;
+
+  tile->pending = TRUE;
+  task = g_task_new (self, NULL, (GAsyncReadyCallback) render_tile_cb, NULL);
+  g_task_set_task_data (task, job, tile_job_free);
+  g_task_run_in_thread (task, render_tile);
+  g_object_unref (task);
+}
+
+static Tile *
+get_tile (PtWaveviewerWaveform *self,
+          gint                  index)
+{
+  /* Returns the tile, a new one or a stale one is generated */
+
+  Tile *tile;
+
+  tile = g_hash_table_lookup (self->tiles, GINT_TO_POINTER (index));
+  if (!tile)
+    {
+      tile = g_new0 (Tile, 1);
+      tile->stale = TRUE;
+      g_hash_table_insert (self->tiles, GINT_TO_POINTER (index), tile);
+    }
+
+  if (tile->stale)
+    request_tile (self, index, tile);
 
-  gint64 result;
+  return tile;
+}
+
+static void
+evict_tiles (PtWaveviewerWaveform *self,
+             gint                  first,
+             gint                  last)
+{
+  GHashTableIter iter;
+  gpointer       key;
+  gint           margin;
+  gint           index;
 
-  result = pixel * 2;
-  if (result + 1 >= self->peaks->len)
-    result = -1;
+  if (g_hash_table_size (self->tiles) <= MAX_TILES)
+    return;
 
-  return result;
+  margin = MAX (0, (MAX_TILES - (last - first + 1)) / 2);
+  g_hash_table_iter_init (&iter, self->tiles);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      index = GPOINTER_TO_INT (key);
+      if (index < first - margin || index > last + margin)
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
+static void
+append_path (PtWaveviewerWaveform *self,
+             GtkSnapshot          *snapshot,
+             gint                  first,
+             gint                  end,
+             gint                  offset,
+             gint                  height)
+{
+  /* Pixels @first to @end (exclusive) are one filled path: along the
+   * maxima from left to right and back along the minima. Each pixel is a
+   * step of width 1, like a rectangle from its minimum to its maximum.
+   * It’s used while a tile is generated. */
+
+  GArray         *peaks = self->peaks;
+  GskPathBuilder *builder;
+  GskPath        *path;
+  gint            pixel;
+  gfloat          min, max;
+  gint            half = height / 2 - 1;
+  gint            middle = height / 2;
+
+  if (first >= end)
+    return;
+
+  builder = gsk_path_builder_new ();
+
+  /* Upper edge */
+  for (pixel = first; pixel < end; pixel++)
+    {
+      max = middle - half * g_array_index (peaks, float, pixel * 2 + 1);
+      if (pixel == first)
+        gsk_path_builder_move_to (builder, pixel - offset, max);
+      else
+        gsk_path_builder_line_to (builder, pixel - offset, max);
+      gsk_path_builder_line_to (builder, pixel + 1 - offset, max);
+    }
+
+  /* Lower edge, backwards */
+  for (pixel = end - 1; pixel >= first; pixel--)
+    {
+      min = middle + half * g_array_index (peaks, float, pixel * 2) * -1;
+      gsk_path_builder_line_to (builder, pixel + 1 - offset, min);
+      gsk_path_builder_line_to (builder, pixel - offset, min);
+    }
+
+  gsk_path_builder_close (builder);
+  path = gsk_path_builder_free_to_path (builder);
+  gtk_snapshot_append_fill (snapshot, path, GSK_FILL_RULE_WINDING, &self->wave_color);
+  gsk_path_unref (path);
 }
 
 static void
 pt_waveviewer_waveform_snapshot (GtkWidget   *widget,
                                  GtkSnapshot *snapshot)
 {
+  /* The waveform is drawn in tiles of TILE_WIDTH pixels. They are
+   * generated in threads and reused on scrolling. Tiles that are not
+   * ready yet are drawn directly. */
+
   PtWaveviewerWaveform *self = (PtWaveviewerWaveform *) widget;
 
   GArray *peaks = self->peaks;
-  gint    pixel;
-  gint    array;
-  gdouble min, max;
-  gint    width, height, offset;
-  gint    half, middle;
+  Tile   *tile;
+  gint    width, height, offset, scale;
+  gint    n_pixels;
+  gint    first, last;
+  gint    x;
 
   if (peaks == NULL || peaks->len == 0)
     return;
 
   height = gtk_widget_get_height (widget);
   width = gtk_widget_get_width (widget);
+  scale = gtk_widget_get_scale_factor (widget);
   gtk_widget_get_color (widget, &self->wave_color);
 
-  /* paint waveform */
+  if (height != self->tile_height || scale != self->tile_scale ||
+      !gdk_rgba_equal (&self->wave_color, &self->tile_color))
+    {
+      flush_tiles (self);
+      end_preview (self);
+      self->tile_height = height;
+      self->tile_scale = scale;
+      self->tile_color = self->wave_color;
+    }
+
   offset = (gint) gtk_adjustment_get_value (self->adj);
-  half = height / 2 - 1;
-  middle = height / 2;
-  for (pixel = 0; pixel <= width; pixel += 1)
+
+  /* Pixels with data */
+  n_pixels = peaks->len / 2;
+  if (offset >= n_pixels)
+    return;
+
+  first = offset / TILE_WIDTH;
+  last = (MIN (offset + width, n_pixels) - 1) / TILE_WIDTH;
+
+  for (gint i = first; i <= last; i++)
     {
-      array = pixel_to_array (self, pixel + offset);
-      if (array == -1)
-        break;
-      min = (middle + half * g_array_index (peaks, float, array) * -1);
-      max = (middle - half * g_array_index (peaks, float, array + 1));
-      gtk_snapshot_append_color (snapshot, &self->wave_color,
-                                 &GRAPHENE_RECT_INIT (pixel, max, 1, min - max));
+      if (!tile_is_converted (self, i, n_pixels))
+        {
+          append_preview (self, snapshot, i, n_pixels, offset, height);
+          continue;
+        }
+
+      tile = get_tile (self, i);
+      x = i * TILE_WIDTH - offset;
+      if (tile->texture)
+        gtk_snapshot_append_texture (snapshot, tile->texture,
+                                     &GRAPHENE_RECT_INIT (x, 0, TILE_WIDTH, height));
+      else
+        append_path (self, snapshot,
+                     MAX (i * TILE_WIDTH, offset),
+                     MIN (MIN ((i + 1) * TILE_WIDTH, offset + width + 1), n_pixels),
+                     offset, height);
     }
+
+  /* Next tiles for scrolling */
+  if (first > 0 && tile_is_converted (self, first - 1, n_pixels))
+    get_tile (self, first - 1);
+  if ((last + 1) * TILE_WIDTH < n_pixels && tile_is_converted (self, last + 1, n_pixels))
+    get_tile (self, last + 1);
+
+  evict_tiles (self, first, last);
 }
 
 static void
@@ -128,9 +556,51 @@ pt_waveviewer_waveform_set (PtWaveviewerWaveform *self,
                             GArray               *peaks)
 {
   self->peaks = peaks;
+  flush_tiles (self);
+  end_preview (self);
   gtk_widget_queue_draw (GTK_WIDGET (self));
 }
 
+void
+pt_waveviewer_waveform_set_pps (PtWaveviewerWaveform *self,
+                                gint                  pps)
+{
+  if (self->tile_pps == pps)
+    return;
+
+  start_preview (self);
+  self->tile_pps = pps;
+  flush_tiles (self);
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+void
+pt_waveviewer_waveform_invalidate (PtWaveviewerWaveform *self,
+                                   guint                 start_index,
+                                   guint                 end_index)
+{
+  /* Peaks from @start_index to @end_index (exclusive) changed, tiles that
+   * show them are generated again when they are drawn next time. It’s up
+   * to the caller to queue a redraw. */
+
+  Tile *tile;
+
+  if (end_index <= start_index)
+    return;
+
+  if (self->preview)
+    add_converted (self, start_index / 2, (end_index + 1) / 2);
+
+  for (guint i = start_index / 2 / TILE_WIDTH; i <= (end_index - 1) / 2 / TILE_WIDTH; i++)
+    {
+      tile = g_hash_table_lookup (self->tiles, GINT_TO_POINTER (i));
+      if (!tile)
+        continue;
+      tile->version++;
+      tile->stale = TRUE;
+    }
+}
+
 static void
 adj_value_changed (GtkAdjustment *adj,
                    gpointer       data)
@@ -157,10 +627,31 @@ pt_waveviewer_waveform_root (GtkWidget *widget)
     }
 }
 
+static void
+pt_waveviewer_waveform_finalize (GObject *object)
+{
+  PtWaveviewerWaveform *self = PT_WAVEVIEWER_WAVEFORM (object);
+
+  g_hash_table_unref (self->tiles);
+  g_clear_pointer (&self->preview, g_hash_table_unref);
+  g_array_unref (self->converted);
+
+  G_OBJECT_CLASS (pt_waveviewer_waveform_parent_class)->finalize (object);
+}
+
 static void
 pt_waveviewer_waveform_init (PtWaveviewerWaveform *self)
 {
   self->peaks = NULL;
+  self->tiles = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, tile_free);
+  self->generation = 0;
+  self->tile_pps = 0;
+  self->tile_height = 0;
+  self->tile_scale = 0;
+  self->preview = NULL;
+  self->preview_pps = 0;
+  self->converted = g_array_new (FALSE, TRUE, sizeof (guint));
+  self->n_converted = 0;
   gtk_widget_add_css_class (GTK_WIDGET (self), "view");
   gtk_widget_get_color (GTK_WIDGET (self), &self->wave_color);
 }
@@ -168,8 +659,10 @@ pt_waveviewer_waveform_init (PtWaveviewerWaveform *self)
 static void
 pt_waveviewer_waveform_class_init (PtWaveviewerWaveformClass *klass)
 {
+  GObjectClass   *object_class = G_OBJECT_CLASS (klass);
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+  object_class->finalize = pt_waveviewer_waveform_finalize;
   widget_class->root = pt_waveviewer_waveform_root;
   widget_class->snapshot = pt_waveviewer_waveform_snapshot;
   widget_class->state_flags_changed = pt_waveviewer_waveform_state_flags_changed;
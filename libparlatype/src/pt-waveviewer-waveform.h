@@ -21,7 +21,12 @@
 #define PT_TYPE_WAVEVIEWER_WAVEFORM (pt_waveviewer_waveform_get_type ())
 G_DECLARE_FINAL_TYPE (PtWaveviewerWaveform, pt_waveviewer_waveform, PT, WAVEVIEWER_WAVEFORM, GtkWidget)
 
-void       pt_waveviewer_waveform_set (PtWaveviewerWaveform *self,
-                                       GArray               *peaks);
+void       pt_waveviewer_waveform_set        (PtWaveviewerWaveform *self,
+                                              GArray               *peaks);
+void       pt_waveviewer_waveform_set_pps    (PtWaveviewerWaveform *self,
+                                              gint                  pps);
+void       pt_waveviewer_waveform_invalidate (PtWaveviewerWaveform *self,
+                                              guint                 start_index,
+                                              guint                 end_index);
 
-GtkWidget *pt_waveviewer_waveform_new (void);
+GtkWidget *pt_waveviewer_waveform_new        (void);
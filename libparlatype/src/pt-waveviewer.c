@@ -40,8 +40,9 @@
 #include "pt-waveviewer.h"
 
 #include "pt-marshalers.h"
-#include "pt-waveloader.h"
+#include "pt-waveloader-private.h"
 #include "pt-waveviewer-cursor.h"
+#include "pt-waveviewer-overview.h"
 #include "pt-waveviewer-ruler.h"
 #include "pt-waveviewer-scrollbox.h"
 #include "pt-waveviewer-selection.h"
@@ -57,6 +58,9 @@
 #define PPS_MIN 25
 #define PPS_MAX 200
 
+/* Minimum interval between redraws for newly loaded data, in ms */
+#define REDRAW_INTERVAL 50
+
 typedef struct _PtWaveviewerPrivate PtWaveviewerPrivate;
 struct _PtWaveviewerPrivate
 {
@@ -66,12 +70,14 @@ struct _PtWaveviewerPrivate
   gint64        peaks_size; /* size of array */
   gint          px_per_sec;
   gint64        duration; /* in milliseconds */
+  GCancellable *resize_cancel;
 
   /* Properties */
   gint64   playback_cursor;
   gboolean follow_cursor;
   gboolean fixed_cursor;
   gboolean show_ruler;
+  gboolean show_overview;
   gboolean has_selection;
   gint     pps;
 
@@ -96,6 +102,8 @@ struct _PtWaveviewerPrivate
   GtkWidget *waveform;
   GtkWidget *revealer;
   GtkWidget *ruler;
+  GtkWidget *overview_revealer;
+  GtkWidget *overview;
   GtkWidget *cursor;
   GtkWidget *selection;
 
@@ -106,7 +114,7 @@ struct _PtWaveviewerPrivate
   GtkEventController *key_ctrl;
   GtkEventController *focus_ctrl;
 
-  guint tick_handler;
+  guint redraw_timeout;
 };
 
 enum
@@ -119,6 +127,10 @@ enum
   PROP_SELECTION_START,
   PROP_SELECTION_END,
   PROP_PPS,
+  PROP_FOLLOW_FILE,
+  PROP_SHOW_OVERVIEW,
+  PROP_CACHE_PEAKS,
+  PROP_DECODE_SEGMENTS,
   N_PROPERTIES
 };
 
@@ -127,6 +139,7 @@ enum
   CURSOR_CHANGED,
   SELECTION_CHANGED,
   PLAY_TOGGLED,
+  DURATION_CHANGED,
   LAST_SIGNAL
 };
 
@@ -209,6 +222,8 @@ render_cursor (PtWaveviewer *self)
   pixel = time_to_pixel (self, priv->playback_cursor);
 
   pt_waveviewer_cursor_render (cursor, pixel - offset);
+  pt_waveviewer_overview_set_cursor (PT_WAVEVIEWER_OVERVIEW (priv->overview),
+                                     priv->playback_cursor);
 }
 
 static gint64
@@ -823,6 +838,92 @@ array_size_changed_cb (PtWaveloader *loader,
       priv->peaks_size / 2,
       priv->px_per_sec,
       priv->duration);
+
+  pt_waveviewer_overview_set_duration (PT_WAVEVIEWER_OVERVIEW (priv->overview),
+                                       priv->duration);
+}
+
+static gboolean
+redraw_waveform_cb (PtWaveviewer *self)
+{
+  PtWaveviewerPrivate *priv = pt_waveviewer_get_instance_private (self);
+
+  priv->redraw_timeout = 0;
+  gtk_widget_queue_draw (priv->waveform);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+data_available_cb (PtWaveloader *loader,
+                   guint         start_index,
+                   guint         end_index,
+                   gpointer      user_data)
+{
+  /* New peaks are added to the overview. They are redrawn only if they are
+   * visible. Redraws are coalesced, at most one per REDRAW_INTERVAL. */
+
+  PtWaveviewer        *self = PT_WAVEVIEWER (user_data);
+  PtWaveviewerPrivate *priv = pt_waveviewer_get_instance_private (self);
+  gdouble              left;
+  gdouble              right;
+
+  pt_waveviewer_waveform_invalidate (PT_WAVEVIEWER_WAVEFORM (priv->waveform),
+                                     start_index, end_index);
+  pt_waveviewer_overview_add (PT_WAVEVIEWER_OVERVIEW (priv->overview),
+                              priv->peaks, start_index, end_index, priv->pps);
+
+  left = gtk_adjustment_get_value (priv->adj);
+  right = left + gtk_adjustment_get_page_size (priv->adj);
+  if (end_index / 2.0 < left || start_index / 2.0 > right)
+    return;
+
+  if (priv->redraw_timeout == 0)
+    priv->redraw_timeout = g_timeout_add (REDRAW_INTERVAL, (GSourceFunc) redraw_waveform_cb, self);
+}
+
+static void
+duration_changed_cb (PtWaveloader *loader,
+                     gint64        duration,
+                     gpointer      user_data)
+{
+  PtWaveviewer        *self = PT_WAVEVIEWER (user_data);
+  PtWaveviewerPrivate *priv = pt_waveviewer_get_instance_private (self);
+
+  array_size_changed_cb (NULL, self);
+  gtk_widget_queue_draw (priv->waveform);
+  if (priv->follow_cursor)
+    scroll_to_cursor (self);
+  render_cursor (self);
+  g_signal_emit (self, signals[DURATION_CHANGED], 0, priv->duration);
+}
+
+static void
+resize_cb (PtWaveloader *loader,
+           GAsyncResult *res,
+           PtWaveviewer *self)
+{
+  PtWaveviewerPrivate *priv;
+  GError              *error = NULL;
+
+  if (!pt_waveloader_resize_finish (loader, res, &error))
+    {
+      /* Superseded by the next zoom step or cancelled in finalize */
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_print ("%s\n", error->message);
+
+          /* End the zoom preview, show what we have */
+          priv = pt_waveviewer_get_instance_private (self);
+          pt_waveviewer_waveform_invalidate (PT_WAVEVIEWER_WAVEFORM (priv->waveform),
+                                             0, priv->peaks->len);
+          gtk_widget_queue_draw (priv->waveform);
+        }
+      g_clear_error (&error);
+      return;
+    }
+
+  priv = pt_waveviewer_get_instance_private (self);
+  gtk_widget_queue_draw (priv->waveform);
 }
 
 static void
@@ -830,7 +931,8 @@ pt_waveviewer_set_pps (PtWaveviewer *self,
                        int           pps)
 {
   PtWaveviewerPrivate *priv = pt_waveviewer_get_instance_private (self);
-  GError              *error = NULL;
+  gint                 left;
+  gint                 width;
 
   pps = CLAMP (pps, PPS_MIN, PPS_MAX);
 
@@ -838,17 +940,26 @@ pt_waveviewer_set_pps (PtWaveviewer *self,
     return;
 
   priv->pps = pps;
+  pt_waveviewer_waveform_set_pps (PT_WAVEVIEWER_WAVEFORM (priv->waveform), pps);
 
   if (priv->peaks->len == 0)
     return;
 
+  /* Compute the visible part at the new resolution first, the rest
+   * follows in the background */
   get_anchor_point (self);
-  if (!pt_waveloader_resize (priv->loader, priv->pps, &error))
-    {
-      g_print ("%s\n", error->message);
-      g_clear_error (&error);
-      return;
-    }
+  left = priv->zoom_time * priv->pps / 1000 - priv->zoom_pos;
+  width = (gint) gtk_adjustment_get_page_size (priv->adj);
+  g_cancellable_cancel (priv->resize_cancel);
+  g_clear_object (&priv->resize_cancel);
+  priv->resize_cancel = g_cancellable_new ();
+  pt_waveloader_resize_range_async (priv->loader,
+                                    priv->pps,
+                                    left,
+                                    left + width,
+                                    priv->resize_cancel,
+                                    (GAsyncReadyCallback) resize_cb,
+                                    self);
 
   array_size_changed_cb (NULL, self);
   gtk_adjustment_set_value (priv->adj,
@@ -884,13 +995,6 @@ load_cb (PtWaveloader *loader,
   PtWaveviewerPrivate *priv = pt_waveviewer_get_instance_private (self);
   GError              *error = NULL;
 
-  if (priv->tick_handler != 0)
-    {
-      gtk_widget_remove_tick_callback (priv->waveform,
-                                       priv->tick_handler);
-      priv->tick_handler = 0;
-    }
-
   if (pt_waveloader_load_finish (loader, res, &error))
     {
       array_size_changed_cb (NULL, self);
@@ -930,15 +1034,6 @@ pt_waveviewer_load_wave_finish (PtWaveviewer *self,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
-static gboolean
-update_waveform_cb (GtkWidget     *widget,
-                    GdkFrameClock *frame_clock,
-                    gpointer       data)
-{
-  gtk_widget_queue_draw (widget);
-  return G_SOURCE_CONTINUE;
-}
-
 /**
  * pt_waveviewer_load_wave_async:
  * @self: the widget
@@ -951,6 +1046,9 @@ update_waveform_cb (GtkWidget     *widget,
  * #PtWaveviewer:pps. While loading, a #PtWaveviewer::load-progress signal is
  * emitted. A previous waveform is discarded.
  *
+ * If another waveviewer of the process shows the same file or is still
+ * loading it, its decoded data is shared instead of decoding the file again.
+ *
  * Since: 2.0
  */
 void
@@ -1007,17 +1105,11 @@ pt_waveviewer_load_wave_async (PtWaveviewer       *self,
 #endif
 
   reset_selection (self);
+  pt_waveviewer_overview_reset (PT_WAVEVIEWER_OVERVIEW (priv->overview));
 
   g_object_set (priv->loader, "uri", uri, NULL);
+  pt_waveviewer_waveform_set (PT_WAVEVIEWER_WAVEFORM (priv->waveform), priv->peaks);
   priv->px_per_sec = priv->pps;
-  if (priv->tick_handler == 0)
-    {
-      priv->tick_handler =
-          gtk_widget_add_tick_callback (
-              priv->waveform,
-              (GtkTickCallback) update_waveform_cb,
-              self, NULL);
-    }
   pt_waveloader_load_async (priv->loader,
                             priv->pps,
                             cancel,
@@ -1032,13 +1124,11 @@ pt_waveviewer_finalize (GObject *object)
   PtWaveviewerPrivate *priv = pt_waveviewer_get_instance_private (self);
 
   g_clear_object (&priv->arrows);
-  g_clear_object (&priv->loader);
-  if (priv->tick_handler != 0)
-    {
-      gtk_widget_remove_tick_callback (priv->waveform,
-                                       priv->tick_handler);
-      priv->tick_handler = 0;
-    }
+  g_cancellable_cancel (priv->resize_cancel);
+  g_clear_object (&priv->resize_cancel);
+  g_signal_handlers_disconnect_by_data (priv->loader, self);
+  g_clear_pointer (&priv->loader, _pt_waveloader_pool_release);
+  g_clear_handle_id (&priv->redraw_timeout, g_source_remove);
 
   G_OBJECT_CLASS (pt_waveviewer_parent_class)->finalize (object);
 }
@@ -1076,6 +1166,9 @@ pt_waveviewer_get_property (GObject    *object,
     case PROP_SHOW_RULER:
       g_value_set_boolean (value, priv->show_ruler);
       break;
+    case PROP_SHOW_OVERVIEW:
+      g_value_set_boolean (value, priv->show_overview);
+      break;
     case PROP_HAS_SELECTION:
       g_value_set_boolean (value, priv->has_selection);
       break;
@@ -1088,6 +1181,15 @@ pt_waveviewer_get_property (GObject    *object,
     case PROP_PPS:
       g_value_set_int (value, priv->pps);
       break;
+    case PROP_FOLLOW_FILE:
+      g_object_get_property (G_OBJECT (priv->loader), "follow", value);
+      break;
+    case PROP_CACHE_PEAKS:
+      g_object_get_property (G_OBJECT (priv->loader), "cache", value);
+      break;
+    case PROP_DECODE_SEGMENTS:
+      g_object_get_property (G_OBJECT (priv->loader), "segments", value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -1131,9 +1233,23 @@ pt_waveviewer_set_property (GObject      *object,
       gtk_revealer_set_reveal_child (GTK_REVEALER (priv->revealer),
                                      priv->show_ruler);
       break;
+    case PROP_SHOW_OVERVIEW:
+      priv->show_overview = g_value_get_boolean (value);
+      gtk_revealer_set_reveal_child (GTK_REVEALER (priv->overview_revealer),
+                                     priv->show_overview);
+      break;
     case PROP_PPS:
       pt_waveviewer_set_pps (self, g_value_get_int (value));
       break;
+    case PROP_FOLLOW_FILE:
+      g_object_set_property (G_OBJECT (priv->loader), "follow", value);
+      break;
+    case PROP_CACHE_PEAKS:
+      g_object_set_property (G_OBJECT (priv->loader), "cache", value);
+      break;
+    case PROP_DECODE_SEGMENTS:
+      g_object_set_property (G_OBJECT (priv->loader), "segments", value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -1157,6 +1273,7 @@ pt_waveviewer_constructed (GObject *object)
   GtkScrolledWindow   *scrolled_window = GTK_SCROLLED_WINDOW (priv->scrolled_window);
   GtkWidget           *scrollbar;
   GtkGesture          *scrollbar_button_handler;
+  GtkGesture          *overview_button_handler;
   GtkEventController  *scrollbar_scroll_handler;
 
   /* Get Adjustment and Scrollbar from ScrolledWindow and connect signals */
@@ -1189,6 +1306,19 @@ pt_waveviewer_constructed (GObject *object)
       G_CALLBACK (scrollbar_scroll_event_cb),
       self);
   gtk_widget_add_controller (scrollbar, scrollbar_scroll_handler);
+
+  /* The overview scrolls, too */
+  pt_waveviewer_overview_set_adjustment (PT_WAVEVIEWER_OVERVIEW (priv->overview), priv->adj);
+
+  overview_button_handler = gtk_gesture_click_new ();
+  gtk_gesture_single_set_button (GTK_GESTURE_SINGLE (overview_button_handler), 0);
+  gtk_event_controller_set_propagation_phase (GTK_EVENT_CONTROLLER (overview_button_handler), GTK_PHASE_CAPTURE);
+  g_signal_connect (
+      overview_button_handler,
+      "pressed",
+      G_CALLBACK (scrollbar_button_press_event_cb),
+      self);
+  gtk_widget_add_controller (priv->overview, GTK_EVENT_CONTROLLER (overview_button_handler));
 }
 
 static GdkCursor *
@@ -1210,11 +1340,14 @@ pt_waveviewer_init (PtWaveviewer *self)
 
   g_type_ensure (PT_TYPE_WAVEVIEWER_SCROLLBOX);
   g_type_ensure (PT_TYPE_WAVEVIEWER_RULER);
+  g_type_ensure (PT_TYPE_WAVEVIEWER_OVERVIEW);
   g_type_ensure (PT_TYPE_WAVEVIEWER_WAVEFORM);
   g_type_ensure (PT_TYPE_WAVEVIEWER_SELECTION);
   g_type_ensure (PT_TYPE_WAVEVIEWER_CURSOR);
 
   gtk_widget_init_template (GTK_WIDGET (self));
+  gtk_orientable_set_orientation (GTK_ORIENTABLE (gtk_widget_get_layout_manager (GTK_WIDGET (self))),
+                                  GTK_ORIENTATION_VERTICAL);
 
   GtkCssProvider *provider;
   GFile          *css_file;
@@ -1229,9 +1362,11 @@ pt_waveviewer_init (PtWaveviewer *self)
   priv->zoom_time = 0;
   priv->zoom_pos = 0;
   priv->arrows = get_resize_cursor ();
-  priv->loader = pt_waveloader_new (NULL);
+  priv->loader = _pt_waveloader_pool_acquire ();
+  g_object_set (priv->loader, "shared", TRUE, NULL);
   priv->peaks = pt_waveloader_get_data (priv->loader);
-  priv->tick_handler = 0;
+  priv->redraw_timeout = 0;
+  priv->resize_cancel = NULL;
 
   gtk_widget_set_focusable (GTK_WIDGET (self), TRUE);
 
@@ -1308,6 +1443,16 @@ pt_waveviewer_init (PtWaveviewer *self)
                     "array-size-changed",
                     G_CALLBACK (array_size_changed_cb),
                     self);
+
+  g_signal_connect (priv->loader,
+                    "data-available",
+                    G_CALLBACK (data_available_cb),
+                    self);
+
+  g_signal_connect (priv->loader,
+                    "duration-changed",
+                    G_CALLBACK (duration_changed_cb),
+                    self);
 }
 
 static void
@@ -1329,12 +1474,14 @@ pt_waveviewer_class_init (PtWaveviewerClass *klass)
   gtk_widget_class_bind_template_child_private (widget_class, PtWaveviewer, scrollbox);
   gtk_widget_class_bind_template_child_private (widget_class, PtWaveviewer, revealer);
   gtk_widget_class_bind_template_child_private (widget_class, PtWaveviewer, ruler);
+  gtk_widget_class_bind_template_child_private (widget_class, PtWaveviewer, overview_revealer);
+  gtk_widget_class_bind_template_child_private (widget_class, PtWaveviewer, overview);
   gtk_widget_class_bind_template_child_private (widget_class, PtWaveviewer, overlay);
   gtk_widget_class_bind_template_child_private (widget_class, PtWaveviewer, waveform);
   gtk_widget_class_bind_template_child_private (widget_class, PtWaveviewer, selection);
   gtk_widget_class_bind_template_child_private (widget_class, PtWaveviewer, cursor);
 
-  gtk_widget_class_set_layout_manager_type (widget_class, GTK_TYPE_BIN_LAYOUT);
+  gtk_widget_class_set_layout_manager_type (widget_class, GTK_TYPE_BOX_LAYOUT);
 
   /**
    * PtWaveviewer::load-progress:
@@ -1408,6 +1555,27 @@ pt_waveviewer_class_init (PtWaveviewerClass *klass)
                     G_TYPE_NONE,
                     0);
 
+  /**
+   * PtWaveviewer::duration-changed:
+   * @self: the waveviewer emitting the signal
+   * @duration: the new duration in milliseconds
+   *
+   * Signals that the followed file grew and the waveform was extended, see
+   * #PtWaveviewer:follow-file.
+   *
+   * Since: 4.3
+   */
+  signals[DURATION_CHANGED] =
+      g_signal_new ("duration-changed",
+                    PT_TYPE_WAVEVIEWER,
+                    G_SIGNAL_RUN_FIRST,
+                    0,
+                    NULL,
+                    NULL,
+                    _pt_cclosure_marshal_VOID__INT64,
+                    G_TYPE_NONE,
+                    1, G_TYPE_INT64);
+
   /**
    * PtWaveviewer:playback-cursor:
    *
@@ -1520,6 +1688,71 @@ pt_waveviewer_class_init (PtWaveviewerClass *klass)
           100,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
 
+  /**
+   * PtWaveviewer:follow-file:
+   *
+   * Whether the file is watched after it was loaded. If it grows, e.g.
+   * because it is still being recorded, the waveform is extended and
+   * #PtWaveviewer::duration-changed is emitted.
+   *
+   * Since: 4.3
+   */
+
+  obj_properties[PROP_FOLLOW_FILE] =
+      g_param_spec_boolean (
+          "follow-file", NULL, NULL,
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * PtWaveviewer:show-overview:
+   *
+   * Whether an overview of the whole file is shown (TRUE) or not (FALSE).
+   * It shows the visible part of the waveform and the playback cursor, the
+   * visible part can be moved with the pointer. The overview is available
+   * while the file is loading.
+   *
+   * Since: 4.3
+   */
+
+  obj_properties[PROP_SHOW_OVERVIEW] =
+      g_param_spec_boolean (
+          "show-overview", NULL, NULL,
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * PtWaveviewer:cache-peaks:
+   *
+   * Whether the waveform is saved to and loaded from a cache in the user’s
+   * cache directory, see #PtWaveloader:cache. Takes effect on the next
+   * load operation.
+   *
+   * Since: 4.3
+   */
+
+  obj_properties[PROP_CACHE_PEAKS] =
+      g_param_spec_boolean (
+          "cache-peaks", NULL, NULL,
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * PtWaveviewer:decode-segments:
+   *
+   * Number of segments of a file that are decoded in parallel, see
+   * #PtWaveloader:segments. 0 uses one segment per processor. Takes effect
+   * on the next load operation.
+   *
+   * Since: 4.3
+   */
+
+  obj_properties[PROP_DECODE_SEGMENTS] =
+      g_param_spec_int (
+          "decode-segments", NULL, NULL,
+          0, 64, 1,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (
       gobject_class,
       N_PROPERTIES,
@@ -0,0 +1,173 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <pt-player-private.h>
+#include <pt-position-manager.h>
+
+/* Helpers ------------------------------------------------------------------ */
+
+static GFile *
+copy_test_file (gchar **dir)
+{
+  /* The position is saved in the file’s metadata, use a copy */
+
+  GError *error = NULL;
+  GFile  *source;
+  GFile  *dest;
+  gchar  *path;
+
+  *dir = g_dir_make_tmp ("parlatype-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  path = g_test_build_filename (G_TEST_DIST, "data", "tick-10sec.ogg", NULL);
+  source = g_file_new_for_path (path);
+  g_free (path);
+
+  path = g_build_filename (*dir, "tick-10sec.ogg", NULL);
+  dest = g_file_new_for_path (path);
+  g_free (path);
+
+  g_file_copy (source, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_object_unref (source);
+
+  return dest;
+}
+
+static void
+remove_test_file (GFile *file,
+                  gchar *dir)
+{
+  g_file_delete (file, NULL, NULL);
+  g_object_unref (file);
+  g_rmdir (dir);
+  g_free (dir);
+}
+
+static void
+open_async_cb (PtPlayer     *player,
+               GAsyncResult *res,
+               GMainLoop    *loop)
+{
+  GError  *error = NULL;
+  gboolean success;
+
+  success = pt_player_open_uri_finish (player, res, &error);
+  g_assert_no_error (error);
+  g_assert_true (success);
+  g_main_loop_quit (loop);
+}
+
+static gboolean
+quit_cb (gpointer user_data)
+{
+  g_main_loop_quit (user_data);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+open_and_settle (PtPlayer *player,
+                 GFile    *file)
+{
+  /* Opens @file and waits a bit longer, so that the messages of another
+   * seek or preroll would be counted, too */
+
+  GMainLoop *loop;
+  gchar     *uri;
+
+  loop = g_main_loop_new (g_main_context_default (), FALSE);
+  uri = g_file_get_uri (file);
+
+  pt_player_open_uri_async (player, uri, NULL, (GAsyncReadyCallback) open_async_cb, loop);
+  g_main_loop_run (loop);
+
+  g_timeout_add (200, quit_cb, loop);
+  g_main_loop_run (loop);
+
+  g_free (uri);
+  g_main_loop_unref (loop);
+}
+
+/* Tests -------------------------------------------------------------------- */
+
+static void
+open_without_position (void)
+{
+  PtPlayer *player;
+  GFile    *file;
+  gchar    *dir;
+  guint     seeks, prerolls;
+
+  file = copy_test_file (&dir);
+  player = pt_player_new ();
+
+  open_and_settle (player, file);
+  _pt_player_get_open_stats (player, &seeks, &prerolls);
+  g_assert_cmpuint (seeks, ==, 0);
+  g_assert_cmpuint (prerolls, ==, 1);
+  g_assert_cmpint (pt_player_get_position (player), ==, 0);
+
+  g_object_unref (player);
+  remove_test_file (file, dir);
+}
+
+static void
+open_at_position (void)
+{
+  PtPositionManager *mgr;
+  PtPlayer          *player;
+  GFile             *file;
+  gchar             *dir;
+  guint              seeks, prerolls;
+
+  file = copy_test_file (&dir);
+  mgr = pt_position_manager_new ();
+  pt_position_manager_save (mgr, file, 3000);
+  if (pt_position_manager_load (mgr, file) != 3000)
+    {
+      g_test_skip ("Metadata not supported");
+      g_object_unref (mgr);
+      remove_test_file (file, dir);
+      return;
+    }
+
+  player = pt_player_new ();
+  open_and_settle (player, file);
+  g_assert_cmpint (pt_player_get_position (player), ==, 3000);
+
+  /* The file is prerolled once, at the saved position */
+  _pt_player_get_open_stats (player, &seeks, &prerolls);
+  g_assert_cmpuint (seeks, ==, 1);
+  g_assert_cmpuint (prerolls, ==, 1);
+
+  g_object_unref (player);
+  g_object_unref (mgr);
+  remove_test_file (file, dir);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/player-static/open-without-position", open_without_position);
+  g_test_add_func ("/player-static/open-at-position", open_at_position);
+
+  return g_test_run ();
+}
@@ -186,6 +186,96 @@ player_open_fail (void)
   g_object_unref (player);
 }
 
+typedef struct
+{
+  GMainLoop *loop;
+  gint       pending;
+  gboolean   success;
+  GError    *error;
+} OpenResult;
+
+static void
+open_async_cb (PtPlayer     *player,
+               GAsyncResult *res,
+               OpenResult   *result)
+{
+  result->success = pt_player_open_uri_finish (player, res, &result->error);
+  if (--result->pending == 0 && result->loop)
+    g_main_loop_quit (result->loop);
+}
+
+static void
+player_open_async (void)
+{
+  PtPlayer     *player;
+  GMainLoop    *loop;
+  GCancellable *cancel;
+  OpenResult    first = { 0 };
+  OpenResult    second = { 0 };
+  gchar        *path;
+  gchar        *uri;
+  gchar        *timestring;
+
+  player = pt_player_new ();
+  loop = g_main_loop_new (g_main_context_default (), FALSE);
+  path = g_test_build_filename (G_TEST_DIST, "data", "tick-10sec.ogg", NULL);
+  uri = g_filename_to_uri (path, NULL, NULL);
+
+  /* Successful open */
+  first.loop = loop;
+  first.pending = 1;
+  pt_player_open_uri_async (player, uri, NULL, (GAsyncReadyCallback) open_async_cb, &first);
+  g_main_loop_run (loop);
+  g_assert_no_error (first.error);
+  g_assert_true (first.success);
+  timestring = pt_player_get_duration_time_string (player, PT_PRECISION_SECOND_100TH);
+  g_assert_cmpstr (timestring, ==, "0:09.98");
+  g_free (timestring);
+
+  /* A second open cancels the first one */
+  first.loop = NULL;
+  first.pending = 1;
+  pt_player_open_uri_async (player, uri, NULL, (GAsyncReadyCallback) open_async_cb, &first);
+  second.loop = loop;
+  second.pending = 1;
+  pt_player_open_uri_async (player, uri, NULL, (GAsyncReadyCallback) open_async_cb, &second);
+  g_main_loop_run (loop);
+  g_assert_cmpint (first.pending, ==, 0);
+  g_assert_error (first.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_false (first.success);
+  g_clear_error (&first.error);
+  g_assert_no_error (second.error);
+  g_assert_true (second.success);
+
+  /* Cancelled by the caller */
+  cancel = g_cancellable_new ();
+  first.loop = loop;
+  first.pending = 1;
+  pt_player_open_uri_async (player, uri, cancel, (GAsyncReadyCallback) open_async_cb, &first);
+  g_cancellable_cancel (cancel);
+  g_main_loop_run (loop);
+  g_assert_error (first.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_clear_error (&first.error);
+  g_object_unref (cancel);
+
+  /* Errors are returned, not emitted */
+  g_free (path);
+  g_free (uri);
+  path = g_test_build_filename (G_TEST_DIST, "data", "foo", NULL);
+  uri = g_filename_to_uri (path, NULL, NULL);
+  first.pending = 1;
+  pt_player_open_uri_async (player, uri, NULL, (GAsyncReadyCallback) open_async_cb, &first);
+  g_main_loop_run (loop);
+  g_assert_error (first.error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_NOT_FOUND);
+  g_assert_false (first.success);
+  g_clear_error (&first.error);
+
+  g_free (path);
+  g_free (uri);
+  g_main_loop_unref (loop);
+  g_object_unref (player);
+}
+
 static void
 player_open_ogg (PtPlayerFixture *fixture,
                  gconstpointer    user_data)
@@ -582,6 +672,36 @@ player_timestrings (PtPlayerFixture *fixture,
   g_main_loop_unref (data.loop);
 }
 
+static void
+player_position (PtPlayerFixture *fixture,
+                 gconstpointer    user_data)
+{
+  /* position is taken from the tracker, not from a pipeline query */
+
+  LoopData data;
+
+  data.loop = g_main_loop_new (g_main_context_default (), FALSE);
+  g_signal_connect (fixture->testplayer, "seek-done", G_CALLBACK (seek_done_cb), &data);
+
+  pt_player_jump_to_position (fixture->testplayer, 1000);
+  g_main_loop_run (data.loop);
+  g_assert_cmpint (pt_player_get_position (fixture->testplayer), ==, 1000);
+
+  pt_player_jump_relative (fixture->testplayer, 1500);
+  g_main_loop_run (data.loop);
+  g_assert_cmpint (pt_player_get_position (fixture->testplayer), ==, 2500);
+
+  /* paused: position doesn’t move */
+  g_assert_cmpint (pt_player_get_position (fixture->testplayer), ==, 2500);
+
+  /* selection starts after position, position moves to its start */
+  pt_player_set_selection (fixture->testplayer, 4000, 5000);
+  g_main_loop_run (data.loop);
+  g_assert_cmpint (pt_player_get_position (fixture->testplayer), ==, 4000);
+
+  g_main_loop_unref (data.loop);
+}
+
 static void
 player_config_loadable (void)
 {
@@ -630,6 +750,7 @@ main (int argc, char *argv[])
 
   g_test_add_func ("/player/new", player_new);
   g_test_add_func ("/player/open-fail", player_open_fail);
+  g_test_add_func ("/player/open-async", player_open_async);
   g_test_add ("/player/open-ogg", PtPlayerFixture, NULL,
               pt_player_fixture_set_up, player_open_ogg,
               pt_player_fixture_tear_down);
@@ -649,6 +770,9 @@ main (int argc, char *argv[])
   g_test_add ("/player/timestrings", PtPlayerFixture, NULL,
               pt_player_fixture_set_up, player_timestrings,
               pt_player_fixture_tear_down);
+  g_test_add ("/player/position", PtPlayerFixture, NULL,
+              pt_player_fixture_set_up, player_position,
+              pt_player_fixture_tear_down);
   g_test_add_func ("/player/config-loadable", player_config_loadable);
 
   return g_test_run ();
@@ -16,17 +16,279 @@
 
 #include <pt-waveloader.c>
 
+#include <glib/gstdio.h>
+
+/* Helpers ------------------------------------------------------------------ */
+
+static PtSampleStore *
+store_new_from_array (GArray *in)
+{
+  PtSampleStore *store = pt_sample_store_new ();
+
+  pt_sample_store_append (store, (gint16 *) in->data, in->len);
+  return store;
+}
+
+static GArray *
+array_new_from_store (PtSampleStore *in)
+{
+  GArray       *array = g_array_new (FALSE, TRUE, sizeof (gint16));
+  const gint16 *block;
+  guint         position = 0;
+  guint         n;
+
+  while ((block = pt_sample_store_get_block (in, position, &n)))
+    {
+      g_array_append_vals (array, block, n);
+      position += n;
+    }
+
+  return array;
+}
+
+static void
+convert_one_second_reference (GArray *in,
+                              GArray *out,
+                              uint   *index_in,
+                              uint   *index_out,
+                              int     pps)
+{
+  /* Scalar implementation of convert_one_second() before min/max kernels
+   * were introduced */
+
+  gint   k, m;
+  gint16 d;
+  gfloat vmin, vmax;
+  gint   chunk_size;
+  gint   mod;
+  gint   correct;
+
+  chunk_size = 8000 / pps;
+  mod = 8000 % pps;
+
+  if (*index_in >= in->len)
+    return;
+
+  for (k = 0; k < pps; k++)
+    {
+      vmin = 0;
+      vmax = 0;
+      correct = 0;
+      if (k < mod)
+        correct = 1;
+      for (m = 0; m < (chunk_size + correct); m++)
+        {
+          d = g_array_index (in, gint16, *index_in);
+          if (d < vmin)
+            vmin = d;
+          if (d > vmax)
+            vmax = d;
+          *index_in += 1;
+          if (*index_in == in->len)
+            break;
+        }
+      if (vmin > 0 && vmax > 0)
+        vmin = 0;
+      else if (vmin < 0 && vmax < 0)
+        vmax = 0;
+      vmin = vmin / 32768.0;
+      vmax = vmax / 32768.0;
+      memcpy (out->data + *index_out * sizeof (float), &vmin, sizeof (float));
+      *index_out += 1;
+      memcpy (out->data + *index_out * sizeof (float), &vmax, sizeof (float));
+      *index_out += 1;
+      if (*index_in == in->len)
+        break;
+    }
+}
+
+static void
+compare_kernels_with_reference (GArray *in)
+{
+  PtSampleStore   *store = store_new_from_array (in);
+  GArray          *expected = g_array_new (FALSE, TRUE, sizeof (float));
+  GArray          *out = g_array_new (FALSE, TRUE, sizeof (float));
+  PtPeakKernelFunc saved = min_max;
+  uint             index_in;
+  uint             index_out;
+  int              out_size;
+
+  for (int pps = 25; pps <= 200; pps++)
+    {
+      index_in = 0;
+      index_out = 0;
+      out_size = calc_lowres_len (in->len, pps);
+      g_array_set_size (expected, out_size);
+      while (in->len > index_in)
+        convert_one_second_reference (in, expected, &index_in, &index_out, pps);
+
+      for (int kernel = 0; kernel < PT_PEAK_KERNEL_N_KERNELS; kernel++)
+        {
+          min_max = pt_peak_kernel_get (kernel);
+          if (!min_max)
+            continue;
+
+          index_in = 0;
+          index_out = 0;
+          g_array_set_size (out, 0);
+          g_array_set_size (out, out_size);
+          while (in->len > index_in)
+            convert_one_second (store, out, &index_in, &index_out, pps);
+
+          g_assert_cmpmem (out->data, out_size * sizeof (float),
+                           expected->data, out_size * sizeof (float));
+        }
+    }
+
+  min_max = saved;
+  pt_sample_store_free (store);
+  g_array_unref (expected);
+  g_array_unref (out);
+}
+
+static gchar *
+write_wav_file (const gchar *dir)
+{
+  /* 48 kHz stereo, 16 bit, 3 seconds: 8000, alternating ±16000, silence */
+
+  GByteArray *wav = g_byte_array_new ();
+  guint32     rate = 48000;
+  guint32     data_size = rate * 3 * 4;
+  guint32     u32;
+  guint16     u16;
+  gint16      frame[2];
+  gchar      *path;
+  gchar      *uri;
+
+#define APPEND_U32(v) (u32 = GUINT32_TO_LE (v), g_byte_array_append (wav, (guint8 *) &u32, 4))
+#define APPEND_U16(v) (u16 = GUINT16_TO_LE (v), g_byte_array_append (wav, (guint8 *) &u16, 2))
+
+  g_byte_array_append (wav, (guint8 *) "RIFF", 4);
+  APPEND_U32 (4 + 8 + 16 + 8 + data_size);
+  g_byte_array_append (wav, (guint8 *) "WAVEfmt ", 8);
+  APPEND_U32 (16);
+  APPEND_U16 (1);
+  APPEND_U16 (2);
+  APPEND_U32 (rate);
+  APPEND_U32 (rate * 4);
+  APPEND_U16 (4);
+  APPEND_U16 (16);
+  g_byte_array_append (wav, (guint8 *) "data", 4);
+  APPEND_U32 (data_size);
+
+#undef APPEND_U32
+#undef APPEND_U16
+
+  for (guint i = 0; i < rate * 3; i++)
+    {
+      if (i < rate)
+        frame[0] = 8000;
+      else if (i < rate * 2)
+        frame[0] = (i % 2) ? -16000 : 16000;
+      else
+        frame[0] = 0;
+      frame[0] = GINT16_TO_LE (frame[0]);
+      frame[1] = frame[0];
+      g_byte_array_append (wav, (guint8 *) frame, 4);
+    }
+
+  path = g_build_filename (dir, "test.wav", NULL);
+  g_assert_true (g_file_set_contents (path, (gchar *) wav->data, wav->len, NULL));
+  uri = g_filename_to_uri (path, NULL, NULL);
+
+  g_byte_array_unref (wav);
+  g_free (path);
+  return uri;
+}
+
+static void
+load_cb (PtWaveloader *wl,
+         GAsyncResult *res,
+         gpointer      user_data)
+{
+  GMainLoop *loop = user_data;
+
+  g_assert_true (pt_waveloader_load_finish (wl, res, NULL));
+  g_main_loop_quit (loop);
+}
+
 /* Tests -------------------------------------------------------------------- */
 
+static void
+test_sample_store (void)
+{
+  /* Append in irregular steps, read back across blocks, drop blocks */
+
+  PtSampleStore *store = pt_sample_store_new ();
+  GArray        *in = g_array_new (FALSE, TRUE, sizeof (gint16));
+  GArray        *out;
+  const gint16  *block;
+  guint          n;
+  gint16         value;
+
+  for (int k = 0; k < 17029; k++)
+    {
+      value = g_test_rand_int_range (G_MININT16, G_MAXINT16 + 1);
+      g_array_append_val (in, value);
+    }
+  for (guint k = 0; k < in->len; k += 1111)
+    pt_sample_store_append (store, &g_array_index (in, gint16, k), MIN (1111, in->len - k));
+
+  g_assert_cmpuint (pt_sample_store_get_length (store), ==, 17029);
+  out = array_new_from_store (store);
+  g_assert_cmpmem (out->data, out->len * sizeof (gint16), in->data, in->len * sizeof (gint16));
+  g_array_unref (out);
+
+  block = pt_sample_store_get_block (store, 7999, &n);
+  g_assert_cmpuint (n, ==, 1);
+  g_assert_cmpint (block[0], ==, g_array_index (in, gint16, 7999));
+  block = pt_sample_store_get_block (store, 16500, &n);
+  g_assert_cmpuint (n, ==, 529);
+  g_assert_null (pt_sample_store_get_block (store, 17029, &n));
+
+  /* Blocks that end before the given index are dropped */
+  pt_sample_store_drop (store, 16001);
+  g_assert_null (pt_sample_store_get_block (store, 15999, &n));
+  g_assert_nonnull (pt_sample_store_get_block (store, 16000, &n));
+  g_assert_cmpuint (pt_sample_store_get_length (store), ==, 17029);
+
+  /* Appending continues in the last block */
+  value = 1;
+  pt_sample_store_append (store, &value, 1);
+  block = pt_sample_store_get_block (store, 17029, &n);
+  g_assert_cmpuint (n, ==, 1);
+  g_assert_cmpint (block[0], ==, 1);
+
+  /* New samples are zero */
+  pt_sample_store_set_length (store, 16010);
+  pt_sample_store_set_length (store, 24001);
+  block = pt_sample_store_get_block (store, 16010, &n);
+  g_assert_cmpuint (n, ==, 7990);
+  for (guint k = 0; k < n; k++)
+    g_assert_cmpint (block[k], ==, 0);
+
+  pt_sample_store_drop (store, 24001);
+  g_assert_null (pt_sample_store_get_block (store, 24000, &n));
+  g_assert_cmpuint (pt_sample_store_get_size (store), <, 1000);
+
+  /* A dropped incomplete block is allocated again and can be dropped again */
+  pt_sample_store_append (store, &value, 1);
+  g_assert_nonnull (pt_sample_store_get_block (store, 24001, &n));
+  g_assert_cmpuint (pt_sample_store_get_size (store), >, 1000);
+  pt_sample_store_drop (store, 24002);
+  g_assert_cmpuint (pt_sample_store_get_size (store), <, 1000);
+
+  pt_sample_store_free (store);
+  g_array_unref (in);
+}
+
 static void
 test_convert_one_second (void)
 {
   /* Resize a couple of input sizes to all possible zoom levels (pps from 25 to 200).
    * Values are zero, we are testing output size, not content. */
 
-  GArray *in = g_array_new (FALSE, /* zero terminated */
-                            TRUE,  /* clear to zero   */
-                            sizeof (gint16));
+  PtSampleStore *in = pt_sample_store_new ();
 
   GArray *out = g_array_new (FALSE, TRUE, sizeof (float));
 
@@ -44,16 +306,16 @@ test_convert_one_second (void)
 
   for (int i = 0; i < 4; i++)
     {
-      g_array_set_size (in, testsize[i]);
+      pt_sample_store_set_length (in, testsize[i]);
 
       for (pps = 25; pps <= 200; pps++)
         {
           index_in = 0;
           index_out = 0;
-          out_size = calc_lowres_len (in->len, pps);
+          out_size = calc_lowres_len (testsize[i], pps);
           g_array_set_size (out, out_size);
 
-          while (in->len > index_in)
+          while ((uint) testsize[i] > index_in)
             {
               convert_one_second (in, out, &index_in, &index_out, pps);
             }
@@ -63,16 +325,718 @@ test_convert_one_second (void)
         }
     }
 
-  g_array_unref (in);
+  pt_sample_store_free (in);
   g_array_unref (out);
 }
 
+static void
+test_convert_from_pyramid (void)
+{
+  /* Resize random input to various zoom levels, including very low and very
+   * high ones. Results must be the same as with convert_one_second(). */
+
+  PtSampleStore *in = pt_sample_store_new ();
+  GArray        *expected = g_array_new (FALSE, TRUE, sizeof (float));
+  GArray        *out = g_array_new (FALSE, TRUE, sizeof (float));
+  PtPeakPyramid *pyramid = pt_peak_pyramid_new ();
+
+  uint   index_in;
+  uint   index_out;
+  int    out_size;
+  int    first, last;
+  gint16 value;
+
+  int testsize[5] = { 7, 7000, 8111, 17029, 480013 };
+  int testpps[9] = { 1, 7, 25, 99, 100, 200, 1000, 7999, 8000 };
+
+  for (int i = 0; i < 5; i++)
+    {
+      pt_sample_store_clear (in);
+      pt_peak_pyramid_reset (pyramid, FALSE, FALSE);
+      for (int k = 0; k < testsize[i]; k++)
+        {
+          value = g_test_rand_int_range (G_MININT16, G_MAXINT16 + 1);
+          pt_sample_store_append (in, &value, 1);
+          /* update in irregular steps, as during loading */
+          if (k % 1111 == 0)
+            pt_peak_pyramid_update (pyramid, in, pt_sample_store_get_length (in));
+        }
+      pt_peak_pyramid_update (pyramid, in, testsize[i]);
+
+      for (int p = 0; p < 9; p++)
+        {
+          index_in = 0;
+          index_out = 0;
+          out_size = calc_lowres_len (testsize[i], testpps[p]);
+          g_array_set_size (expected, out_size);
+          g_array_set_size (out, out_size);
+
+          while ((uint) testsize[i] > index_in)
+            convert_one_second (in, expected, &index_in, &index_out, testpps[p]);
+
+          g_assert_true (convert_from_pyramid (pyramid, in, testsize[i],
+                                               (float *) out->data, testpps[p],
+                                               0, out_size / 2, NULL));
+          g_assert_cmpmem (out->data, out_size * sizeof (float),
+                           expected->data, out_size * sizeof (float));
+
+          /* Any range of min/max pairs */
+          first = g_test_rand_int_range (0, out_size / 2 + 1);
+          last = g_test_rand_int_range (first, out_size / 2 + 1);
+          g_assert_true (convert_from_pyramid (pyramid, in, testsize[i],
+                                               (float *) out->data, testpps[p],
+                                               first, last, NULL));
+          g_assert_cmpmem (out->data, (last - first) * 2 * sizeof (float),
+                           &g_array_index (expected, float, first * 2),
+                           (last - first) * 2 * sizeof (float));
+        }
+    }
+
+  pt_peak_pyramid_free (pyramid);
+  pt_sample_store_free (in);
+  g_array_unref (expected);
+  g_array_unref (out);
+}
+
+static void
+test_kernels_synthetic (void)
+{
+  /* Random data, extreme values and odd sizes that don't fit into vectors */
+
+  GArray *in = g_array_new (FALSE, TRUE, sizeof (gint16));
+  gint16  value;
+
+  for (int k = 0; k < 24001; k++)
+    {
+      if (k % 997 == 0)
+        value = (k % 2) ? G_MAXINT16 : G_MININT16;
+      else
+        value = g_test_rand_int_range (G_MININT16, G_MAXINT16 + 1);
+      g_array_append_val (in, value);
+    }
+  compare_kernels_with_reference (in);
+
+  /* Only positive and only negative values */
+  for (int k = 0; k < 8111; k++)
+    g_array_index (in, gint16, k) = g_test_rand_int_range (1, G_MAXINT16 + 1);
+  g_array_set_size (in, 8111);
+  compare_kernels_with_reference (in);
+
+  for (int k = 0; k < 8111; k++)
+    g_array_index (in, gint16, k) = -g_array_index (in, gint16, k);
+  compare_kernels_with_reference (in);
+
+  g_array_unref (in);
+}
+
+static void
+test_kernels_file (void)
+{
+  /* Real data from tick-60sec.ogg */
+
+  PtWaveloader        *wl;
+  PtWaveloaderPrivate *priv;
+  GMainLoop           *loop;
+  gchar               *path;
+  gchar               *uri;
+  GFile               *file;
+  GArray              *samples;
+
+  path = g_test_build_filename (G_TEST_DIST, "data", "tick-60sec.ogg", NULL);
+  file = g_file_new_for_path (path);
+  uri = g_file_get_uri (file);
+  wl = pt_waveloader_new (uri);
+  priv = pt_waveloader_get_instance_private (wl);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  pt_waveloader_load_async (wl, 100, NULL, (GAsyncReadyCallback) load_cb, loop);
+  g_main_loop_run (loop);
+
+  samples = array_new_from_store (priv->hires);
+  g_assert_cmpuint (samples->len, >, 8000 * 59);
+  compare_kernels_with_reference (samples);
+
+  g_array_unref (samples);
+  g_main_loop_unref (loop);
+  g_object_unref (wl);
+  g_object_unref (file);
+  g_free (uri);
+  g_free (path);
+}
+
+static void
+test_pcm_file (void)
+{
+  PtWaveloader *wl;
+  PtPcmFile    *file;
+  GMainLoop    *loop;
+  GArray       *array;
+  gint16        frames[4];
+  gchar        *dir;
+  gchar        *uri;
+  gchar        *path;
+  gchar        *ogg_path;
+  gchar        *ogg_uri;
+  gchar        *contents;
+  gsize         length;
+  gfloat        min, max;
+
+  dir = g_dir_make_tmp ("parlatype-XXXXXX", NULL);
+  g_assert_nonnull (dir);
+  uri = write_wav_file (dir);
+
+  /* Reading frames, channels are mixed down */
+  file = pt_pcm_file_new (uri);
+  g_assert_nonnull (file);
+  g_assert_cmpuint (pt_pcm_file_get_rate (file), ==, 48000);
+  g_assert_cmpuint (pt_pcm_file_get_channels (file), ==, 2);
+  g_assert_cmpuint (pt_pcm_file_get_n_frames (file), ==, 48000 * 3);
+  pt_pcm_file_read (file, 48000 - 2, 4, frames);
+  g_assert_cmpint (frames[0], ==, 8000);
+  g_assert_cmpint (frames[1], ==, 8000);
+  g_assert_cmpint (frames[2], ==, 16000);
+  g_assert_cmpint (frames[3], ==, -16000);
+  g_assert_true (pt_pcm_file_check_length (file));
+
+  /* A rate that is not plausible. The file is replaced, @file still maps
+   * the old one. */
+  path = g_filename_from_uri (uri, NULL, NULL);
+  g_assert_true (g_file_get_contents (path, &contents, &length, NULL));
+  contents[24] = contents[25] = contents[26] = contents[27] = (gchar) 0xFF;
+  g_assert_true (g_file_set_contents (path, contents, length, NULL));
+  g_assert_null (pt_pcm_file_new (uri));
+
+  /* The file was truncated */
+  g_assert_true (g_file_set_contents (path, contents, 100, NULL));
+  g_assert_false (pt_pcm_file_check_length (file));
+  pt_pcm_file_free (file);
+  g_free (path);
+  g_free (contents);
+  g_free (uri);
+  uri = write_wav_file (dir);
+
+  /* Not a supported file */
+  ogg_path = g_test_build_filename (G_TEST_DIST, "data", "tick-10sec.ogg", NULL);
+  ogg_uri = g_filename_to_uri (ogg_path, NULL, NULL);
+  g_assert_null (pt_pcm_file_new (ogg_uri));
+  g_free (ogg_uri);
+  g_free (ogg_path);
+
+  /* Peaks are the same as with decoding */
+  wl = pt_waveloader_new (uri);
+  loop = g_main_loop_new (NULL, FALSE);
+  pt_waveloader_load_async (wl, 100, NULL, (GAsyncReadyCallback) load_cb, loop);
+  g_main_loop_run (loop);
+
+  array = pt_waveloader_get_data (wl);
+  g_assert_cmpuint (array->len, ==, 3 * 100 * 2);
+  for (guint i = 0; i < 300; i++)
+    {
+      min = g_array_index (array, float, i * 2);
+      max = g_array_index (array, float, i * 2 + 1);
+      if (i < 100)
+        {
+          g_assert_cmpfloat (min, ==, 0);
+          g_assert_cmpfloat (max, ==, 8000 / 32768.0);
+        }
+      else if (i < 200)
+        {
+          g_assert_cmpfloat (min, ==, -16000 / 32768.0);
+          g_assert_cmpfloat (max, ==, 16000 / 32768.0);
+        }
+      else
+        {
+          g_assert_cmpfloat (min, ==, 0);
+          g_assert_cmpfloat (max, ==, 0);
+        }
+    }
+
+  g_main_loop_unref (loop);
+  g_object_unref (wl);
+  path = g_build_filename (dir, "test.wav", NULL);
+  g_unlink (path);
+  g_rmdir (dir);
+  g_free (path);
+  g_free (uri);
+  g_free (dir);
+}
+
+static void
+test_reuse_pipeline (void)
+{
+  /* Load the same file 100 times: the pipeline should be reused, without
+   * growing, and memory usage should stay the same */
+
+  PtWaveloader        *wl;
+  PtWaveloaderPrivate *priv;
+  GMainLoop           *loop;
+  gchar               *path;
+  gchar               *uri;
+  GstElement          *pipeline = NULL;
+  GstElement          *dec;
+  guint                n_children = 0;
+  guint                n_dec_children = 0;
+  gsize                memory = 0;
+  GArray              *expected = NULL;
+
+  path = g_test_build_filename (G_TEST_DIST, "data", "tick-10sec.ogg", NULL);
+  uri = g_filename_to_uri (path, NULL, NULL);
+  wl = pt_waveloader_new (uri);
+  priv = pt_waveloader_get_instance_private (wl);
+  loop = g_main_loop_new (NULL, FALSE);
+
+  for (int i = 0; i < 100; i++)
+    {
+      pt_waveloader_load_async (wl, 100, NULL, (GAsyncReadyCallback) load_cb, loop);
+      g_main_loop_run (loop);
+
+      dec = gst_bin_get_by_name (GST_BIN (priv->pipeline), "dec");
+      if (i == 0)
+        {
+          pipeline = priv->pipeline;
+          n_children = GST_BIN (pipeline)->numchildren;
+          n_dec_children = GST_BIN (dec)->numchildren;
+          memory = pt_waveloader_get_memory_usage (wl);
+          expected = g_array_copy (priv->lowres);
+        }
+      else
+        {
+          g_assert_true (priv->pipeline == pipeline);
+          g_assert_cmpint (GST_OBJECT_REFCOUNT (pipeline), ==, 1);
+          g_assert_cmpuint (GST_BIN (pipeline)->numchildren, ==, n_children);
+          g_assert_cmpuint (GST_BIN (dec)->numchildren, ==, n_dec_children);
+          g_assert_cmpuint (pt_waveloader_get_memory_usage (wl), ==, memory);
+          g_assert_cmpmem (priv->lowres->data, priv->lowres->len * sizeof (float),
+                           expected->data, expected->len * sizeof (float));
+        }
+      gst_object_unref (dec);
+    }
+
+  g_array_unref (expected);
+  g_main_loop_unref (loop);
+  g_object_unref (wl);
+  g_free (uri);
+  g_free (path);
+}
+
+static void
+test_pool (void)
+{
+  PtWaveloader *first;
+  PtWaveloader *second;
+  GMainLoop    *loop;
+  gchar        *path;
+  gchar        *uri;
+  gchar        *pool_uri;
+  gboolean      cache;
+
+  path = g_test_build_filename (G_TEST_DIST, "data", "tick-10sec.ogg", NULL);
+  uri = g_filename_to_uri (path, NULL, NULL);
+  loop = g_main_loop_new (NULL, FALSE);
+
+  first = _pt_waveloader_pool_acquire ();
+  g_object_set (first, "uri", uri, "cache", TRUE, NULL);
+  pt_waveloader_load_async (first, 100, NULL, (GAsyncReadyCallback) load_cb, loop);
+  g_main_loop_run (loop);
+  g_assert_cmpuint (pt_waveloader_get_data (first)->len, >, 0);
+
+  /* Released loaders are reused, without data and with default properties */
+  _pt_waveloader_pool_release (first);
+  second = _pt_waveloader_pool_acquire ();
+  g_assert_true (second == first);
+  g_assert_cmpuint (pt_waveloader_get_data (second)->len, ==, 0);
+  g_assert_cmpuint (pt_waveloader_get_memory_usage (second), <, 1000);
+  g_object_get (second, "uri", &pool_uri, "cache", &cache, NULL);
+  g_assert_null (pool_uri);
+  g_assert_false (cache);
+
+  /* Loaders that were not acquired are not put into the pool */
+  _pt_waveloader_pool_release (second);
+  first = pt_waveloader_new (NULL);
+  _pt_waveloader_pool_release (first);
+  first = _pt_waveloader_pool_acquire ();
+  g_assert_true (first == second);
+
+  /* Busy loaders are not put into the pool */
+  g_object_set (first, "uri", uri, NULL);
+  pt_waveloader_load_async (first, 100, NULL, (GAsyncReadyCallback) load_cb, loop);
+  g_object_ref (first);
+  _pt_waveloader_pool_release (first);
+  g_main_loop_run (loop);
+  second = _pt_waveloader_pool_acquire ();
+  g_assert_true (second != first);
+
+  g_object_unref (first);
+  _pt_waveloader_pool_release (second);
+  _pt_waveloader_pool_clear ();
+  g_main_loop_unref (loop);
+  g_free (uri);
+  g_free (path);
+}
+
+typedef struct
+{
+  GMainLoop *loop;
+  gint       pending;
+  gint       failed;
+} SharedData;
+
+static void
+count_load_cb (PtWaveloader *wl,
+               GAsyncResult *res,
+               gpointer      user_data)
+{
+  SharedData *data = user_data;
+
+  if (!pt_waveloader_load_finish (wl, res, NULL))
+    data->failed++;
+  if (--data->pending == 0)
+    g_main_loop_quit (data->loop);
+}
+
+static void
+test_shared (void)
+{
+  /* Concurrent loads of the same file share one decode, each loader at its
+   * own resolution */
+
+  PtWaveloader        *first;
+  PtWaveloader        *second;
+  PtWaveloader        *unshared;
+  PtWaveloaderPrivate *priv1;
+  PtWaveloaderPrivate *priv2;
+  PtPeakData          *peak_data;
+  GError              *error;
+  GArray              *a;
+  GArray              *b;
+  SharedData           data;
+  gboolean             owner;
+  guint                len;
+  gchar               *path;
+  gchar               *uri;
+
+  path = g_test_build_filename (G_TEST_DIST, "data", "tick-10sec.ogg", NULL);
+  uri = g_filename_to_uri (path, NULL, NULL);
+  data.loop = g_main_loop_new (NULL, FALSE);
+
+  first = pt_waveloader_new (uri);
+  second = pt_waveloader_new (uri);
+  unshared = pt_waveloader_new (uri);
+  g_object_set (first, "shared", TRUE, NULL);
+  g_object_set (second, "shared", TRUE, NULL);
+  priv1 = pt_waveloader_get_instance_private (first);
+  priv2 = pt_waveloader_get_instance_private (second);
+
+  data.pending = 3;
+  data.failed = 0;
+  pt_waveloader_load_async (first, 100, NULL, (GAsyncReadyCallback) count_load_cb, &data);
+  pt_waveloader_load_async (second, 50, NULL, (GAsyncReadyCallback) count_load_cb, &data);
+  pt_waveloader_load_async (unshared, 50, NULL, (GAsyncReadyCallback) count_load_cb, &data);
+  g_main_loop_run (data.loop);
+  g_assert_cmpint (data.failed, ==, 0);
+
+  g_assert_true (priv1->data == priv2->data);
+  g_assert_true (priv1->data_owner);
+  g_assert_false (priv2->data_owner);
+  g_assert_cmpuint (pt_peak_store_get_size (), ==, 1);
+  g_assert_cmpint (pt_waveloader_get_duration (second), ==, pt_waveloader_get_duration (unshared));
+
+  /* Same peaks as from an own decode */
+  a = pt_waveloader_get_data (second);
+  b = pt_waveloader_get_data (unshared);
+  g_assert_cmpuint (a->len, ==, b->len);
+  for (guint i = 0; i < a->len; i++)
+    g_assert_cmpfloat_with_epsilon (g_array_index (a, float, i), g_array_index (b, float, i), 0.0001);
+
+  /* Freed with the last user */
+  len = pt_waveloader_get_data (first)->len;
+  g_object_unref (first);
+  g_assert_cmpuint (pt_peak_store_get_size (), ==, 1);
+  g_object_unref (second);
+  g_assert_cmpuint (pt_peak_store_get_size (), ==, 0);
+
+  /* If the owner is cancelled, a waiting loader takes over */
+  peak_data = pt_peak_store_attach (uri, &owner);
+  g_assert_true (owner);
+  first = pt_waveloader_new (uri);
+  g_object_set (first, "shared", TRUE, NULL);
+  data.pending = 1;
+  pt_waveloader_load_async (first, 100, NULL, (GAsyncReadyCallback) count_load_cb, &data);
+  pt_peak_data_fail (peak_data, NULL);
+  g_main_loop_run (data.loop);
+  g_assert_cmpint (data.failed, ==, 0);
+  g_assert_cmpuint (pt_waveloader_get_data (first)->len, ==, len);
+  pt_peak_data_unref (peak_data);
+  g_object_unref (first);
+
+  /* The owner’s error is passed on */
+  peak_data = pt_peak_store_attach (uri, &owner);
+  second = pt_waveloader_new (uri);
+  g_object_set (second, "shared", TRUE, NULL);
+  data.pending = 1;
+  pt_waveloader_load_async (second, 100, NULL, (GAsyncReadyCallback) count_load_cb, &data);
+  error = g_error_new_literal (GST_CORE_ERROR, GST_CORE_ERROR_FAILED, "test");
+  pt_peak_data_fail (peak_data, error);
+  g_main_loop_run (data.loop);
+  g_assert_cmpint (data.failed, ==, 1);
+  g_assert_cmpuint (pt_waveloader_get_data (second)->len, ==, 0);
+  pt_peak_data_unref (peak_data);
+  g_error_free (error);
+
+  g_object_unref (second);
+  g_object_unref (unshared);
+  g_assert_cmpuint (pt_peak_store_get_size (), ==, 0);
+  g_main_loop_unref (data.loop);
+  g_free (uri);
+  g_free (path);
+}
+
+static void
+append_frames (const gchar *path,
+               gint16       value,
+               guint        n_frames)
+{
+  FILE  *file;
+  gint16 frame = GINT16_TO_LE (value);
+
+  file = g_fopen (path, "ab");
+  g_assert_nonnull (file);
+  for (guint i = 0; i < n_frames; i++)
+    g_assert_cmpuint (fwrite (&frame, 2, 1, file), ==, 1);
+  fclose (file);
+}
+
+static void
+duration_changed_cb (PtWaveloader *wl,
+                     gint64        duration,
+                     gpointer      user_data)
+{
+  g_main_loop_quit (user_data);
+}
+
+static gboolean
+timeout_cb (gpointer user_data)
+{
+  g_main_loop_quit (user_data);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+test_follow (void)
+{
+  /* A WAV file is being recorded: the header has no size yet, frames are
+   * appended after the file was loaded */
+
+  PtWaveloader *wl;
+  GMainLoop    *loop;
+  GArray       *array;
+  gchar        *dir;
+  gchar        *path;
+  gchar        *uri;
+  guint         timeout;
+  guint8        header[44] = "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0"
+                             "\x80\x3e\0\0\0\x7d\0\0\x02\0\x10\0"
+                             "data\0\0\0\0";
+
+  dir = g_dir_make_tmp ("parlatype-XXXXXX", NULL);
+  g_assert_nonnull (dir);
+  path = g_build_filename (dir, "growing.wav", NULL);
+  uri = g_filename_to_uri (path, NULL, NULL);
+
+  /* 16 kHz mono, 2 seconds */
+  g_assert_true (g_file_set_contents (path, (gchar *) header, sizeof (header), NULL));
+  append_frames (path, 8000, 16000 * 2);
+
+  wl = pt_waveloader_new (uri);
+  g_object_set (wl, "follow", TRUE, NULL);
+  loop = g_main_loop_new (NULL, FALSE);
+  pt_waveloader_load_async (wl, 100, NULL, (GAsyncReadyCallback) load_cb, loop);
+  g_main_loop_run (loop);
+
+  array = pt_waveloader_get_data (wl);
+  g_assert_cmpuint (array->len, ==, 2 * 100 * 2);
+  g_assert_cmpint (pt_waveloader_get_duration (wl), ==, 2 * GST_SECOND);
+
+  /* One more second is added */
+  g_signal_connect (wl, "duration-changed", G_CALLBACK (duration_changed_cb), loop);
+  timeout = g_timeout_add_seconds (10, timeout_cb, loop);
+  append_frames (path, 4000, 16000);
+  g_main_loop_run (loop);
+  g_source_remove (timeout);
+
+  g_assert_cmpint (pt_waveloader_get_duration (wl), ==, 3 * GST_SECOND);
+  g_assert_cmpuint (array->len, ==, 3 * 100 * 2);
+  g_assert_cmpfloat (g_array_index (array, float, 199 * 2 + 1), ==, 8000 / 32768.0);
+  g_assert_cmpfloat (g_array_index (array, float, 250 * 2 + 1), ==, 4000 / 32768.0);
+  g_assert_cmpfloat (g_array_index (array, float, 299 * 2 + 1), ==, 4000 / 32768.0);
+
+  /* Not followed any more */
+  g_object_set (wl, "follow", FALSE, NULL);
+  append_frames (path, 4000, 16000);
+  timeout = g_timeout_add_seconds (2, timeout_cb, loop);
+  g_main_loop_run (loop);
+  g_assert_cmpint (pt_waveloader_get_duration (wl), ==, 3 * GST_SECOND);
+
+  g_main_loop_unref (loop);
+  g_object_unref (wl);
+  g_unlink (path);
+  g_rmdir (dir);
+  g_free (uri);
+  g_free (path);
+  g_free (dir);
+}
+
+static GArray *
+load_variant (gchar       *uri,
+              gboolean     resample,
+              gdouble     *elapsed)
+{
+  /* Loads @uri in a single pipeline, with or without audioresample, and
+   * returns a copy of the peaks */
+
+  PtWaveloader        *wl;
+  PtWaveloaderPrivate *priv;
+  GMainLoop           *loop;
+  GArray              *result;
+
+  wl = pt_waveloader_new (uri);
+  priv = pt_waveloader_get_instance_private (wl);
+  priv->resample = resample;
+  g_object_set (wl, "segments", 1, NULL);
+  loop = g_main_loop_new (NULL, FALSE);
+
+  g_test_timer_start ();
+  pt_waveloader_load_async (wl, 100, NULL, (GAsyncReadyCallback) load_cb, loop);
+  g_main_loop_run (loop);
+  if (elapsed)
+    *elapsed = g_test_timer_elapsed ();
+
+  result = g_array_copy (pt_waveloader_get_data (wl));
+  g_main_loop_unref (loop);
+  g_object_unref (wl);
+  return result;
+}
+
+static void
+test_native_rate (void)
+{
+  /* Peaks at the native rate have the same length as resampled ones and
+   * are not smaller */
+
+  GArray *native;
+  GArray *resampled;
+  gchar  *path;
+  gchar  *uri;
+  gfloat  native_max = 0;
+  gfloat  resampled_max = 0;
+
+  path = g_test_build_filename (G_TEST_DIST, "data", "tick-10sec.ogg", NULL);
+  uri = g_filename_to_uri (path, NULL, NULL);
+
+  native = load_variant (uri, FALSE, NULL);
+  resampled = load_variant (uri, TRUE, NULL);
+  g_assert_cmpint (ABS ((gint) native->len - (gint) resampled->len), <=, 2);
+
+  for (guint i = 0; i < native->len; i++)
+    native_max = MAX (native_max, ABS (g_array_index (native, float, i)));
+  for (guint i = 0; i < resampled->len; i++)
+    resampled_max = MAX (resampled_max, ABS (g_array_index (resampled, float, i)));
+  g_assert_cmpfloat (resampled_max, >, 0);
+  g_assert_cmpfloat (native_max, >=, resampled_max * 0.9);
+
+  g_array_unref (native);
+  g_array_unref (resampled);
+  g_free (uri);
+  g_free (path);
+}
+
+static void
+test_native_rate_benchmark (void)
+{
+  /* Compares loading a 48 kHz stereo file at the native rate with the old
+   * audioresample pipeline. Run with -m perf. */
+
+  GstElement *pipeline;
+  GstBus     *bus;
+  GstMessage *msg;
+  GArray     *peaks;
+  gchar      *dir;
+  gchar      *path;
+  gchar      *uri;
+  gchar      *desc;
+  gdouble     native = 0;
+  gdouble     resampled = 0;
+  gdouble     elapsed;
+  gint        runs = 3;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Only in perf mode");
+      return;
+    }
+
+  /* Five minutes of 48 kHz stereo Vorbis */
+  dir = g_dir_make_tmp ("parlatype-XXXXXX", NULL);
+  g_assert_nonnull (dir);
+  path = g_build_filename (dir, "bench.ogg", NULL);
+  desc = g_strdup_printf ("audiotestsrc wave=pink-noise samplesperbuffer=4800 num-buffers=3000 "
+                          "! audio/x-raw,rate=48000,channels=2 "
+                          "! audioconvert ! vorbisenc ! oggmux ! filesink location=\"%s\"",
+                          path);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_assert_nonnull (pipeline);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  g_assert_cmpint (GST_MESSAGE_TYPE (msg), ==, GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  uri = g_filename_to_uri (path, NULL, NULL);
+
+  for (gint i = 0; i < runs; i++)
+    {
+      peaks = load_variant (uri, TRUE, &elapsed);
+      resampled += elapsed;
+      g_array_unref (peaks);
+      peaks = load_variant (uri, FALSE, &elapsed);
+      native += elapsed;
+      g_array_unref (peaks);
+    }
+
+  g_test_message ("audioresample: %.3f s, native rate: %.3f s, speedup %.2f×",
+                  resampled / runs, native / runs, resampled / native);
+  g_test_minimized_result (native / runs, "native rate load %.3f s", native / runs);
+
+  g_unlink (path);
+  g_rmdir (dir);
+  g_free (uri);
+  g_free (desc);
+  g_free (path);
+  g_free (dir);
+}
+
 int
 main (int argc, char *argv[])
 {
   g_test_init (&argc, &argv, NULL);
 
+  /* Choose min/max kernel */
+  g_type_class_unref (g_type_class_ref (PT_TYPE_WAVELOADER));
+
+  g_test_add_func ("/waveloader-static/sample-store", test_sample_store);
   g_test_add_func ("/waveloader-static/convert", test_convert_one_second);
+  g_test_add_func ("/waveloader-static/convert-pyramid", test_convert_from_pyramid);
+  g_test_add_func ("/waveloader-static/kernels-synthetic", test_kernels_synthetic);
+  g_test_add_func ("/waveloader-static/kernels-file", test_kernels_file);
+  g_test_add_func ("/waveloader-static/pcm-file", test_pcm_file);
+  g_test_add_func ("/waveloader-static/reuse-pipeline", test_reuse_pipeline);
+  g_test_add_func ("/waveloader-static/pool", test_pool);
+  g_test_add_func ("/waveloader-static/native-rate", test_native_rate);
+  g_test_add_func ("/waveloader-static/follow", test_follow);
+  g_test_add_func ("/waveloader-static/shared", test_shared);
+  g_test_add_func ("/waveloader-static/native-rate-benchmark", test_native_rate_benchmark);
 
   return g_test_run ();
 }
@@ -449,10 +449,480 @@ waveloader_compare_load_resize (void)
   g_object_unref (wl);
 }
 
+static void
+count_cb (PtWaveloader *wl,
+          gdouble       progress,
+          gint         *count)
+{
+  *count += 1;
+}
+
+static void
+waveloader_load_cache (void)
+{
+  /* Test loading with cache: the first load saves decoded data to the
+   * cache, the second load with a new waveloader should give the same
+   * result without decoding, i.e. without intermediate progress signals. */
+
+  PtWaveloader *wl;
+  SyncData      data;
+  GError       *error = NULL;
+  gboolean      success;
+  GArray       *array;
+  gchar        *dir;
+  gint64        duration;
+  gint          len;
+  float         value;
+  gint          count = 0;
+
+  data = create_sync_data ();
+  wl = wl_with_test_uri ("tick-10sec.ogg");
+  g_object_set (wl, "cache", TRUE, NULL);
+  array = pt_waveloader_get_data (wl);
+  pt_waveloader_load_async (wl, 100,
+                            NULL,
+                            (GAsyncReadyCallback) quit_loop_cb,
+                            &data);
+  g_main_loop_run (data.loop);
+
+  success = pt_waveloader_load_finish (wl, data.res, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+
+  len = array->len;
+  value = g_array_index (array, float, 42);
+  duration = pt_waveloader_get_duration (wl);
+  g_object_unref (data.res);
+  g_object_unref (wl);
+
+  dir = g_build_filename (g_get_user_cache_dir (), "parlatype", "peaks", NULL);
+  g_assert_true (g_file_test (dir, G_FILE_TEST_IS_DIR));
+
+  wl = wl_with_test_uri ("tick-10sec.ogg");
+  g_object_set (wl, "cache", TRUE, NULL);
+  array = pt_waveloader_get_data (wl);
+  g_signal_connect (wl, "progress", G_CALLBACK (count_cb), &count);
+  pt_waveloader_load_async (wl, 100,
+                            NULL,
+                            (GAsyncReadyCallback) quit_loop_cb,
+                            &data);
+  g_main_loop_run (data.loop);
+
+  success = pt_waveloader_load_finish (wl, data.res, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+
+  /* Only the final progress signal */
+  g_assert_cmpint (count, ==, 1);
+  g_assert_cmpint (array->len, ==, len);
+  g_assert_cmpfloat (g_array_index (array, float, 42), ==, value);
+  g_assert_cmpint (pt_waveloader_get_duration (wl), ==, duration);
+
+  g_free (dir);
+  free_sync_data (data);
+  g_object_unref (wl);
+}
+
+static void
+waveloader_load_parallel (void)
+{
+  /* Test loading in parallel segments: should give the same result as
+   * loading sequentially, apart from slight differences at segment borders. */
+
+  PtWaveloader *wl;
+  SyncData      data;
+  GError       *error = NULL;
+  gboolean      success;
+  GArray       *array;
+  gint          len;
+  float         value;
+  gint          count = 0;
+
+  data = create_sync_data ();
+  wl = wl_with_test_uri ("tick-60sec.ogg");
+  array = pt_waveloader_get_data (wl);
+  pt_waveloader_load_async (wl, 100,
+                            NULL,
+                            (GAsyncReadyCallback) quit_loop_cb,
+                            &data);
+  g_main_loop_run (data.loop);
+
+  success = pt_waveloader_load_finish (wl, data.res, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+
+  len = array->len;
+  value = g_array_index (array, float, 0);
+  g_object_unref (data.res);
+  g_object_unref (wl);
+
+  wl = wl_with_test_uri ("tick-60sec.ogg");
+  g_object_set (wl, "segments", 4, NULL);
+  array = pt_waveloader_get_data (wl);
+  g_signal_connect (wl, "progress", G_CALLBACK (count_cb), &count);
+  pt_waveloader_load_async (wl, 100,
+                            NULL,
+                            (GAsyncReadyCallback) quit_loop_cb,
+                            &data);
+  g_main_loop_run (data.loop);
+
+  success = pt_waveloader_load_finish (wl, data.res, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+
+  g_assert_cmpint (count, >=, 1);
+  g_assert_cmpint (ABS ((gint) array->len - len), <=, 4);
+  g_assert_cmpfloat (g_array_index (array, float, 0), ==, value);
+
+  free_sync_data (data);
+  g_object_unref (wl);
+}
+
+static void
+waveloader_load_bounded (void)
+{
+  /* Test bounded-memory mode: should use less memory. After resizing, peaks
+   * should be at least as high as without bounded-memory mode. */
+
+  PtWaveloader *wl;
+  SyncData      data;
+  GError       *error = NULL;
+  gboolean      success;
+  GArray       *array;
+  GArray       *full;
+  gsize         full_usage;
+
+  data = create_sync_data ();
+  wl = wl_with_test_uri ("tick-60sec.ogg");
+  pt_waveloader_load_async (wl, 100,
+                            NULL,
+                            (GAsyncReadyCallback) quit_loop_cb,
+                            &data);
+  g_main_loop_run (data.loop);
+
+  success = pt_waveloader_load_finish (wl, data.res, &error);
+  g_assert_true (success);
+  g_object_unref (data.res);
+
+  success = pt_waveloader_resize (wl, 200, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+
+  full_usage = pt_waveloader_get_memory_usage (wl);
+  array = pt_waveloader_get_data (wl);
+  full = g_array_copy (array);
+  g_object_unref (wl);
+
+  wl = wl_with_test_uri ("tick-60sec.ogg");
+  g_object_set (wl, "bounded-memory", TRUE, "quantize-peaks", TRUE, NULL);
+  pt_waveloader_load_async (wl, 100,
+                            NULL,
+                            (GAsyncReadyCallback) quit_loop_cb,
+                            &data);
+  g_main_loop_run (data.loop);
+
+  success = pt_waveloader_load_finish (wl, data.res, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+
+  success = pt_waveloader_resize (wl, 200, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+
+  g_assert_cmpuint (pt_waveloader_get_memory_usage (wl), <, full_usage / 4);
+
+  array = pt_waveloader_get_data (wl);
+  g_assert_cmpint (array->len, ==, full->len);
+  for (guint i = 0; i < array->len; i += 2)
+    {
+      g_assert_cmpfloat (g_array_index (array, float, i), <=, g_array_index (full, float, i));
+      g_assert_cmpfloat (g_array_index (array, float, i + 1), >=, g_array_index (full, float, i + 1));
+    }
+
+  g_array_unref (full);
+  free_sync_data (data);
+  g_object_unref (wl);
+}
+
+typedef struct
+{
+  GThread *thread;
+  GArray  *array;
+  guint    end;
+  gint     count;
+} DataAvailable;
+
+static void
+data_available_cb (PtWaveloader  *wl,
+                   guint          start_index,
+                   guint          end_index,
+                   DataAvailable *data)
+{
+  g_assert_true (g_thread_self () == data->thread);
+  g_assert_cmpuint (start_index, ==, data->end);
+  g_assert_cmpuint (start_index, <, end_index);
+  g_assert_cmpuint (end_index, <=, data->array->len);
+  data->end = end_index;
+  data->count++;
+}
+
+static void
+waveloader_data_available (void)
+{
+  /* Test data-available signal: should be emitted in the main thread,
+   * with ranges following each other and covering the whole array */
+
+  PtWaveloader *wl;
+  SyncData      data;
+  GError       *error = NULL;
+  gboolean      success;
+  DataAvailable available = { 0 };
+
+  data = create_sync_data ();
+  wl = wl_with_test_uri ("tick-60sec.ogg");
+  available.thread = g_thread_self ();
+  available.array = pt_waveloader_get_data (wl);
+  g_signal_connect (wl, "data-available", G_CALLBACK (data_available_cb), &available);
+  pt_waveloader_load_async (wl, 100,
+                            NULL,
+                            (GAsyncReadyCallback) quit_loop_cb,
+                            &data);
+  g_main_loop_run (data.loop);
+
+  success = pt_waveloader_load_finish (wl, data.res, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+
+  g_assert_cmpint (available.count, >=, 2);
+  g_assert_cmpuint (available.end, ==, available.array->len);
+
+  free_sync_data (data);
+  g_object_unref (wl);
+}
+
+typedef struct
+{
+  guint    first_start;
+  guint    first_end;
+  gboolean covered[18002 * 2];
+} RangeAvailable;
+
+static void
+range_available_cb (PtWaveloader   *wl,
+                    guint           start_index,
+                    guint           end_index,
+                    RangeAvailable *data)
+{
+  if (data->first_end == 0)
+    {
+      data->first_start = start_index;
+      data->first_end = end_index;
+    }
+
+  g_assert_cmpuint (end_index, <=, G_N_ELEMENTS (data->covered));
+  for (guint i = start_index; i < end_index; i++)
+    data->covered[i] = TRUE;
+}
+
+static void
+waveloader_resize_range (void)
+{
+  /* Test progressive resize: the priority range should be available
+   * immediately, a second resize should supersede the first one and the
+   * result should be the same as with a normal resize */
+
+  PtWaveloader   *wl;
+  SyncData        data;
+  SyncData        superseded;
+  GError         *error = NULL;
+  gboolean        success;
+  GArray         *array;
+  GArray         *expected;
+  RangeAvailable *available;
+
+  data = create_sync_data ();
+  superseded = create_sync_data ();
+  wl = wl_with_test_uri ("tick-60sec.ogg");
+  array = pt_waveloader_get_data (wl);
+  pt_waveloader_load_async (wl, 100,
+                            NULL,
+                            (GAsyncReadyCallback) quit_loop_cb,
+                            &data);
+  g_main_loop_run (data.loop);
+  success = pt_waveloader_load_finish (wl, data.res, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+  g_clear_object (&data.res);
+
+  success = pt_waveloader_resize (wl, 300, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+  expected = g_array_copy (array);
+  g_assert_cmpuint (expected->len, <=, 18002 * 2);
+
+  success = pt_waveloader_resize (wl, 100, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+
+  available = g_new0 (RangeAvailable, 1);
+  g_signal_connect (wl, "data-available", G_CALLBACK (range_available_cb), available);
+
+  pt_waveloader_resize_range_async (wl, 300, 1000, 2000, NULL,
+                                    (GAsyncReadyCallback) quit_loop_cb,
+                                    &superseded);
+  g_assert_cmpuint (array->len, ==, expected->len);
+  g_assert_cmpuint (available->first_start, ==, 2000);
+  g_assert_cmpuint (available->first_end, ==, 4000);
+  g_assert_cmpmem (&g_array_index (array, float, 2000), 2000 * sizeof (float),
+                   &g_array_index (expected, float, 2000), 2000 * sizeof (float));
+
+  /* Out of range, gets clamped */
+  available->first_end = 0;
+  pt_waveloader_resize_range_async (wl, 300, 17000, 19000, NULL,
+                                    (GAsyncReadyCallback) quit_loop_cb,
+                                    &data);
+  g_assert_cmpuint (available->first_start, ==, 34000);
+  g_assert_cmpuint (available->first_end, ==, expected->len);
+  g_main_loop_run (data.loop);
+
+  success = pt_waveloader_resize_finish (wl, data.res, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+
+  g_assert_nonnull (superseded.res);
+  success = pt_waveloader_resize_finish (wl, superseded.res, &error);
+  g_assert_false (success);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_clear_error (&error);
+
+  for (guint i = 0; i < expected->len; i++)
+    g_assert_true (available->covered[i]);
+  g_assert_cmpmem (array->data, array->len * sizeof (float),
+                   expected->data, expected->len * sizeof (float));
+
+  g_free (available);
+  g_array_unref (expected);
+  free_sync_data (superseded);
+  free_sync_data (data);
+  g_object_unref (wl);
+}
+
+static void
+waveloader_get_peaks (void)
+{
+  /* Test peak query: bins at the array's resolution should give the same
+   * values, one bin for the whole file the total minimum and maximum, bins
+   * smaller than samples should repeat samples */
+
+  PtWaveloader *wl;
+  SyncData      data;
+  GError       *error = NULL;
+  gboolean      success;
+  GArray       *array;
+  gfloat        out[1000];
+  gfloat        total_min = 0;
+  gfloat        total_max = 0;
+
+  data = create_sync_data ();
+  wl = wl_with_test_uri ("tick-10sec.ogg");
+  array = pt_waveloader_get_data (wl);
+
+  g_assert_false (pt_waveloader_get_peaks (wl, 0, GST_SECOND, 10, out));
+
+  pt_waveloader_load_async (wl, 100,
+                            NULL,
+                            (GAsyncReadyCallback) quit_loop_cb,
+                            &data);
+  g_main_loop_run (data.loop);
+  success = pt_waveloader_load_finish (wl, data.res, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+
+  /* 100 pixels per second */
+  g_assert_true (pt_waveloader_get_peaks (wl, 0, 5 * GST_SECOND, 500, out));
+  g_assert_cmpmem (out, 1000 * sizeof (float), array->data, 1000 * sizeof (float));
+
+  /* Overview */
+  for (guint i = 0; i < array->len; i += 2)
+    {
+      total_min = MIN (total_min, g_array_index (array, float, i));
+      total_max = MAX (total_max, g_array_index (array, float, i + 1));
+    }
+  g_assert_true (pt_waveloader_get_peaks (wl, 0, pt_waveloader_get_duration (wl), 1, out));
+  g_assert_cmpfloat (out[0], ==, total_min);
+  g_assert_cmpfloat (out[1], ==, total_max);
+
+  /* 8 samples in 32 bins */
+  g_assert_true (pt_waveloader_get_peaks (wl, GST_SECOND, GST_SECOND + GST_MSECOND, 32, out));
+  for (guint i = 0; i < 32; i++)
+    {
+      g_assert_cmpfloat (out[i * 2], ==, out[i / 4 * 8]);
+      g_assert_cmpfloat (out[i * 2 + 1], ==, out[i / 4 * 8 + 1]);
+      g_assert_true (out[i * 2] == 0 || out[i * 2 + 1] == 0);
+    }
+
+  /* After the end */
+  g_assert_true (pt_waveloader_get_peaks (wl, 20 * GST_SECOND, 30 * GST_SECOND, 10, out));
+  for (guint i = 0; i < 20; i++)
+    g_assert_cmpfloat (out[i], ==, 0);
+
+  free_sync_data (data);
+  g_object_unref (wl);
+}
+
+static void
+waveloader_get_bytes (void)
+{
+  /* Test bytes: they are a copy of the array and stay valid after the
+   * loader is gone */
+
+  PtWaveloader *wl;
+  SyncData      data;
+  GError       *error = NULL;
+  gboolean      success;
+  GArray       *array;
+  GBytes       *all;
+  GBytes       *range;
+  GBytes       *empty;
+  gsize         size;
+
+  data = create_sync_data ();
+  wl = wl_with_test_uri ("tick-10sec.ogg");
+  pt_waveloader_load_async (wl, 100,
+                            NULL,
+                            (GAsyncReadyCallback) quit_loop_cb,
+                            &data);
+  g_main_loop_run (data.loop);
+  success = pt_waveloader_load_finish (wl, data.res, &error);
+  g_assert_true (success);
+  g_assert_no_error (error);
+  array = pt_waveloader_get_data (wl);
+
+  all = pt_waveloader_get_bytes (wl, 0, -1);
+  g_assert_cmpmem (g_bytes_get_data (all, &size), size,
+                   array->data, array->len * sizeof (float));
+
+  range = pt_waveloader_get_bytes (wl, 200, 400);
+  g_assert_cmpmem (g_bytes_get_data (range, NULL), g_bytes_get_size (range),
+                   &g_array_index (array, float, 200), 200 * sizeof (float));
+
+  /* Clamped */
+  empty = pt_waveloader_get_bytes (wl, array->len + 10, array->len + 20);
+  g_assert_cmpuint (g_bytes_get_size (empty), ==, 0);
+
+  free_sync_data (data);
+  g_object_unref (wl);
+
+  g_assert_cmpfloat (((const float *) g_bytes_get_data (range, NULL))[1], >=, 0);
+  g_bytes_unref (all);
+  g_bytes_unref (range);
+  g_bytes_unref (empty);
+}
+
 int
 main (int argc, char *argv[])
 {
-  g_test_init (&argc, &argv, NULL);
+  g_test_init (&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
 
   g_test_add_func ("/waveloader/new", waveloader_new);
   g_test_add_func ("/waveloader/load_fail", waveloader_load_fail);
@@ -464,6 +934,13 @@ main (int argc, char *argv[])
   g_test_add_func ("/waveloader/load_success", waveloader_load_success);
   g_test_add_func ("/waveloader/resize_sync", waveloader_resize_sync);
   g_test_add_func ("/waveloader/compare_load_resize", waveloader_compare_load_resize);
+  g_test_add_func ("/waveloader/load_cache", waveloader_load_cache);
+  g_test_add_func ("/waveloader/load_parallel", waveloader_load_parallel);
+  g_test_add_func ("/waveloader/load_bounded", waveloader_load_bounded);
+  g_test_add_func ("/waveloader/data_available", waveloader_data_available);
+  g_test_add_func ("/waveloader/resize_range", waveloader_resize_range);
+  g_test_add_func ("/waveloader/get_peaks", waveloader_get_peaks);
+  g_test_add_func ("/waveloader/get_bytes", waveloader_get_bytes);
 
   return g_test_run ();
 }
@@ -137,7 +137,7 @@ waveviewer_loaded (void)
 int
 main (int argc, char *argv[])
 {
-  g_test_init (&argc, &argv, NULL);
+  g_test_init (&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
 
   g_test_add_func ("/waveviewer/empty", waveviewer_empty);
   g_test_add_func ("/waveviewer/loaded", waveviewer_loaded);
@@ -44,6 +44,7 @@ struct _PtPreferencesDialog
   GtkWidget *pps_scale;
   GtkWidget *ruler_row;
   GtkWidget *cursor_row;
+  GtkWidget *parallel_row;
 
   /* Controls page */
   GtkWidget *pause_row;
@@ -572,6 +573,11 @@ pt_preferences_dialog_init (PtPreferencesDialog *self)
       set_cursor_mapping,
       NULL, NULL);
 
+  g_settings_bind (
+      self->editor, "parallel-decoding",
+      self->parallel_row, "active",
+      G_SETTINGS_BIND_DEFAULT);
+
   GtkAdjustment *pps_adj;
   pps_adj = gtk_range_get_adjustment (GTK_RANGE (self->pps_scale));
   g_settings_bind (
@@ -728,6 +734,7 @@ pt_preferences_dialog_class_init (PtPreferencesDialogClass *klass)
   gtk_widget_class_bind_template_child (widget_class, PtPreferencesDialog, pps_scale);
   gtk_widget_class_bind_template_child (widget_class, PtPreferencesDialog, ruler_row);
   gtk_widget_class_bind_template_child (widget_class, PtPreferencesDialog, cursor_row);
+  gtk_widget_class_bind_template_child (widget_class, PtPreferencesDialog, parallel_row);
   gtk_widget_class_bind_template_child (widget_class, PtPreferencesDialog, pause_row);
   gtk_widget_class_bind_template_child (widget_class, PtPreferencesDialog, back_row);
   gtk_widget_class_bind_template_child (widget_class, PtPreferencesDialog, forward_row);
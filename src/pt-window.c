@@ -69,6 +69,8 @@ struct _PtWindow
 
   gint64 last_time; // last time to compare if it changed
 
+  GCancellable *open_cancel; /* pending open of a file */
+
   guint   timer;
   gdouble speed;
 };
@@ -636,6 +638,12 @@ open_cb (PtWaveviewer *viewer,
 
   if (!pt_waveviewer_load_wave_finish (viewer, res, &error))
     {
+      /* Another file was opened */
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_error_free (error);
+          return;
+        }
       pt_error_message (self, error->message);
       g_error_free (error);
       /* Very unlikely situation: Stream is open and playable,
@@ -643,6 +651,38 @@ open_cb (PtWaveviewer *viewer,
     }
 }
 
+static void
+player_open_cb (PtPlayer     *player,
+                GAsyncResult *res,
+                PtWindow     *self)
+{
+  GError *error = NULL;
+  gchar  *uri;
+
+  if (!pt_player_open_uri_finish (player, res, &error))
+    {
+      /* Another file was opened or the window is closed */
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_error_free (error);
+          return;
+        }
+      pt_window_ready_to_play (self, FALSE);
+      pt_error_message (self, error->message);
+      g_error_free (error);
+      return;
+    }
+
+  pt_window_ready_to_play (self, TRUE);
+  uri = pt_player_get_uri (player);
+  pt_waveviewer_load_wave_async (PT_WAVEVIEWER (self->waveviewer),
+                                 uri,
+                                 self->open_cancel,
+                                 (GAsyncReadyCallback) open_cb,
+                                 self);
+  g_free (uri);
+}
+
 gchar *
 pt_window_get_uri (PtWindow *self)
 {
@@ -668,15 +708,17 @@ pt_window_open_file (PtWindow *self,
   if (cmp == 0)
     return;
 
+  /* Dropping another file cancels a pending one */
+  g_cancellable_cancel (self->open_cancel);
+  g_clear_object (&self->open_cancel);
+  self->open_cancel = g_cancellable_new ();
+
   pt_window_ready_to_play (self, FALSE);
-  if (!pt_player_open_uri (self->player, uri))
-    return;
-  pt_window_ready_to_play (self, TRUE);
-  pt_waveviewer_load_wave_async (PT_WAVEVIEWER (self->waveviewer),
-                                 uri,
-                                 NULL,
-                                 (GAsyncReadyCallback) open_cb,
-                                 self);
+  pt_player_open_uri_async (self->player,
+                            uri,
+                            self->open_cancel,
+                            (GAsyncReadyCallback) player_open_cb,
+                            self);
 }
 
 static void
@@ -870,6 +912,16 @@ map_milliseconds_to_seconds (const GValue       *value,
   return g_variant_new_int32 (new);
 }
 
+static gboolean
+map_parallel_to_segments (GValue   *value,
+                          GVariant *variant,
+                          gpointer  data)
+{
+  /* Parallel decoding uses one segment per processor */
+  g_value_set_int (value, g_variant_get_boolean (variant) ? 0 : 1);
+  return TRUE;
+}
+
 static void
 setup_settings (PtWindow *self)
 {
@@ -922,6 +974,14 @@ setup_settings (PtWindow *self)
       self->waveviewer, "fixed-cursor",
       G_SETTINGS_BIND_GET);
 
+  g_settings_bind_with_mapping (
+      self->editor, "parallel-decoding",
+      self->waveviewer, "decode-segments",
+      G_SETTINGS_BIND_GET,
+      map_parallel_to_segments,
+      NULL,
+      NULL, NULL);
+
   g_settings_bind (
       self->editor, "timestamp-precision",
       self->player, "timestamp-precision",
@@ -1174,9 +1234,9 @@ setup_accels_actions_menus (PtWindow *self)
 }
 
 static void
-progressbar_cb (PtWaveviewer *viewer,
-                double        fraction,
-                gpointer      user_data)
+progressbar_cb (GObject *object,
+                double   fraction,
+                gpointer user_data)
 {
   GtkProgressBar *progressbar = GTK_PROGRESS_BAR (user_data);
 
@@ -1274,6 +1334,7 @@ pt_window_init (PtWindow *self)
   self->recent = gtk_recent_manager_get_default ();
   self->timer = 0;
   self->last_time = 0;
+  self->open_cancel = NULL;
   self->clip = gtk_widget_get_clipboard (GTK_WIDGET (self));
 
   /* Used e.g. by Xfce */
@@ -1285,6 +1346,9 @@ pt_window_init (PtWindow *self)
 
   pt_window_ready_to_play (self, FALSE);
 
+  /* Cache waveforms, parallel decoding is a preference */
+  g_object_set (self->waveviewer, "cache-peaks", TRUE, NULL);
+
   self->clip_handler_id = g_signal_connect (self->clip,
                                             "changed",
                                             G_CALLBACK (update_insert_action_sensitivity),
@@ -1298,6 +1362,11 @@ pt_window_init (PtWindow *self)
                     "load-progress",
                     G_CALLBACK (progressbar_cb),
                     GTK_PROGRESS_BAR (self->progress));
+
+  g_signal_connect (self->player,
+                    "open-progress",
+                    G_CALLBACK (progressbar_cb),
+                    GTK_PROGRESS_BAR (self->progress));
 }
 
 static void
@@ -1316,6 +1385,8 @@ pt_window_dispose (GObject *object)
 
   g_clear_signal_handler (&self->clip_handler_id, self->clip);
   remove_timer (self);
+  g_cancellable_cancel (self->open_cancel);
+  g_clear_object (&self->open_cancel);
   g_clear_object (&self->editor);
   g_clear_object (&self->player);
   g_clear_object (&self->asr_config);
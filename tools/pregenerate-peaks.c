@@ -0,0 +1,270 @@
+/* Copyright 2026 Gabor Karsay <gabor.karsay@gmx.at>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Decodes audio files in the background and writes the peak cache, so that
+ * waveforms are shown at once when the files are opened in Parlatype.
+ * Directories are walked recursively. Each file is loaded by a PtWaveloader
+ * in a thread pool, no display is needed. Old cache files are evicted once
+ * at the end, not after every file. */
+
+#include <locale.h> /* setlocale */
+#include <parlatype.h>
+#include <pt-peak-cache.h>
+
+/* Peaks per second, the cache keeps all samples and doesn’t depend on it */
+#define PPS 10
+
+typedef struct
+{
+  gint    n_files;
+  gint    n_failed;
+  gdouble audio_seconds;
+} Totals;
+
+static gint     arg_jobs = 0;
+static gint     arg_cache_size = 1024;
+static gboolean arg_no_evict = FALSE;
+static gboolean arg_quiet = FALSE;
+
+static GMutex lock;
+static Totals totals;
+
+static const GOptionEntry options[] = {
+  { "jobs", 'j',
+    G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_INT, &arg_jobs,
+    "Number of files decoded at the same time (default: number of processors)", "N" },
+  { "cache-size", 's',
+    G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_INT, &arg_cache_size,
+    "Maximum size of the cache in MB (default: 1024)", "MB" },
+  { "no-evict", 0,
+    G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_NONE, &arg_no_evict,
+    "Don’t remove old cache files", NULL },
+  { "quiet", 'q',
+    G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_NONE, &arg_quiet,
+    "Print only errors and the summary", NULL },
+  { NULL }
+};
+
+typedef struct
+{
+  gboolean done;
+  GError  *error;
+} Result;
+
+static void
+load_cb (PtWaveloader *wl,
+         GAsyncResult *res,
+         gpointer      user_data)
+{
+  Result *result = user_data;
+
+  pt_waveloader_load_finish (wl, res, &result->error);
+  result->done = TRUE;
+}
+
+static void
+process_file (gpointer data,
+              gpointer user_data)
+{
+  /* Runs in a pool thread, with its own main context for the loader’s
+   * callbacks */
+
+  GFile        *file = data;
+  GMainContext *context;
+  PtWaveloader *wl;
+  Result        result = { FALSE, NULL };
+  gchar        *uri;
+  gchar        *name;
+  gint64        start;
+  gdouble       elapsed;
+  gdouble       seconds = 0;
+
+  context = g_main_context_new ();
+  g_main_context_push_thread_default (context);
+
+  uri = g_file_get_uri (file);
+  name = g_file_get_parse_name (file);
+  wl = pt_waveloader_new (uri);
+  /* No eviction by each loader, that’s done once in main() */
+  g_object_set (wl, "cache", TRUE, "cache-max-size", G_GUINT64_CONSTANT (0), "segments", 1, NULL);
+
+  start = g_get_monotonic_time ();
+  pt_waveloader_load_async (wl, PPS, NULL, (GAsyncReadyCallback) load_cb, &result);
+  while (!result.done)
+    g_main_context_iteration (context, TRUE);
+  elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  /* Duration is in nanoseconds */
+  if (!result.error)
+    seconds = pt_waveloader_get_duration (wl) / 1000000000.0;
+
+  g_mutex_lock (&lock);
+  totals.n_files++;
+  if (result.error)
+    {
+      totals.n_failed++;
+      g_printerr ("%s: %s\n", name, result.error->message);
+    }
+  else
+    {
+      totals.audio_seconds += seconds;
+      if (!arg_quiet)
+        g_print ("%8.1f s %8.1f×  %s\n", seconds, seconds / MAX (elapsed, 0.001), name);
+    }
+  g_mutex_unlock (&lock);
+
+  g_clear_error (&result.error);
+  g_object_unref (wl);
+  g_free (name);
+  g_free (uri);
+  g_object_unref (file);
+
+  g_main_context_pop_thread_default (context);
+  g_main_context_unref (context);
+}
+
+static gboolean
+is_media_file (GFileInfo *info)
+{
+  const gchar *type;
+
+  type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+
+  return type && (g_content_type_is_a (type, "audio/*") ||
+                  g_content_type_is_a (type, "video/*"));
+}
+
+static void
+walk (GFile       *file,
+      GThreadPool *pool)
+{
+  GFileEnumerator *enumerator;
+  GFileInfo       *info;
+  GError          *error = NULL;
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_STANDARD_TYPE "," G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE,
+                            G_FILE_QUERY_INFO_NONE, NULL, &error);
+  if (!info)
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  if (g_file_info_get_file_type (info) != G_FILE_TYPE_DIRECTORY)
+    {
+      if (is_media_file (info))
+        g_thread_pool_push (pool, g_object_ref (file), NULL);
+      g_object_unref (info);
+      return;
+    }
+  g_object_unref (info);
+
+  enumerator = g_file_enumerate_children (file,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_TYPE "," G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE,
+                                          G_FILE_QUERY_INFO_NONE, NULL, &error);
+  if (!enumerator)
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+    {
+      GFile *child = g_file_enumerator_get_child (enumerator, info);
+      if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        walk (child, pool);
+      else if (is_media_file (info))
+        g_thread_pool_push (pool, g_object_ref (child), NULL);
+      g_object_unref (child);
+      g_object_unref (info);
+    }
+
+  g_object_unref (enumerator);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *context;
+  GThreadPool    *pool;
+  PtPeakCache    *cache;
+  GError         *error = NULL;
+  GFile          *file;
+  gint64          start;
+  gdouble         elapsed;
+
+  setlocale (LC_ALL, "");
+
+  context = g_option_context_new ("FILE|DIRECTORY… - write Parlatype’s peak cache");
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("option parsing failed: %s\n", error->message);
+      g_option_context_free (context);
+      g_error_free (error);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  if (argc < 2)
+    {
+      g_printerr ("no files or directories given\n");
+      return 1;
+    }
+
+  if (arg_jobs <= 0)
+    arg_jobs = g_get_num_processors ();
+
+  if (arg_cache_size <= 0)
+    {
+      g_printerr ("cache size must be at least 1 MB\n");
+      return 1;
+    }
+
+  pool = g_thread_pool_new (process_file, NULL, arg_jobs, TRUE, NULL);
+  start = g_get_monotonic_time ();
+
+  for (int i = 1; i < argc; i++)
+    {
+      file = g_file_new_for_commandline_arg (argv[i]);
+      walk (file, pool);
+      g_object_unref (file);
+    }
+
+  /* Wait for all files and their cache files, saves run in threads of
+   * their own */
+  g_thread_pool_free (pool, FALSE, TRUE);
+  cache = pt_peak_cache_new ();
+  pt_peak_cache_flush (cache);
+  elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  if (!arg_no_evict)
+    pt_peak_cache_evict (cache, (guint64) arg_cache_size << 20);
+  g_object_unref (cache);
+
+  g_print ("%d files, %d failed, %.1f s audio in %.1f s with %d threads: %.1f×\n",
+           totals.n_files, totals.n_failed, totals.audio_seconds, elapsed, arg_jobs,
+           totals.audio_seconds / MAX (elapsed, 0.001));
+
+  return totals.n_failed > 0 ? 1 : 0;
+}